@@ -0,0 +1,111 @@
+/*
+ * LEDC PWM backlight for the Guition ESP32-S3-4848S040.
+ *
+ * 20 kHz (inaudible, flicker-free) at 10-bit resolution on PIN_BL.
+ * Brightness requests are in perceptual percent and mapped through a
+ * square law to duty, so low levels stay usable in a dark shop.
+ *
+ * Fades use the LEDC hardware fade engine: once programmed, the duty
+ * ramps without any CPU involvement.  An instant change first stops a
+ * running fade so a QR boost never waits behind a slow dim.
+ *
+ * QEMU builds (CONFIG_APP_QEMU) only record the requested level.
+ */
+
+#include "backlight.h"
+
+#include "esp_log.h"
+#include "esp_check.h"
+#include "driver/ledc.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "backlight";
+
+/* Backlight (PWM-capable, active-high) – board-specific */
+#define PIN_BL          GPIO_NUM_38
+
+#define BL_MODE         LEDC_LOW_SPEED_MODE
+#define BL_TIMER        LEDC_TIMER_0
+#define BL_CHANNEL      LEDC_CHANNEL_0
+#define BL_FREQ_HZ      20000
+#define BL_RES          LEDC_TIMER_10_BIT
+#define BL_DUTY_MAX     ((1u << 10) - 1)
+
+static uint8_t s_percent;
+
+static uint32_t percent_to_duty(uint8_t percent)
+{
+    if (percent > 100) percent = 100;
+    return (BL_DUTY_MAX * percent * percent) / (100u * 100u);
+}
+
+/* ── Public API ──────────────────────────────────────────────────────── */
+
+esp_err_t backlight_init(void)
+{
+#if CONFIG_APP_QEMU
+    s_percent = 0;
+    ESP_LOGW(TAG, "QEMU: no backlight, levels recorded only");
+    return ESP_OK;
+#endif
+    const ledc_timer_config_t timer = {
+        .speed_mode      = BL_MODE,
+        .timer_num       = BL_TIMER,
+        .duty_resolution = BL_RES,
+        .freq_hz         = BL_FREQ_HZ,
+        .clk_cfg         = LEDC_AUTO_CLK,
+    };
+    ESP_RETURN_ON_ERROR(ledc_timer_config(&timer), TAG, "timer config failed");
+
+    const ledc_channel_config_t ch = {
+        .gpio_num   = PIN_BL,
+        .speed_mode = BL_MODE,
+        .channel    = BL_CHANNEL,
+        .timer_sel  = BL_TIMER,
+        .duty       = 0,
+        .hpoint     = 0,
+    };
+    ESP_RETURN_ON_ERROR(ledc_channel_config(&ch), TAG, "channel config failed");
+
+    ESP_RETURN_ON_ERROR(ledc_fade_func_install(0), TAG,
+                        "fade service install failed");
+
+    s_percent = 0;
+    ESP_LOGI(TAG, "LEDC backlight on GPIO %d (%d Hz)", PIN_BL, BL_FREQ_HZ);
+    return ESP_OK;
+}
+
+esp_err_t backlight_set(uint8_t percent, uint32_t fade_ms)
+{
+#if CONFIG_APP_QEMU
+    (void)fade_ms;
+    s_percent = percent > 100 ? 100 : percent;
+    return ESP_OK;
+#endif
+    uint32_t duty = percent_to_duty(percent);
+
+    /* Never queue behind a running fade – stop it first. */
+    ledc_fade_stop(BL_MODE, BL_CHANNEL);
+
+    if (fade_ms == 0) {
+        ESP_RETURN_ON_ERROR(ledc_set_duty(BL_MODE, BL_CHANNEL, duty),
+                            TAG, "set duty failed");
+        ESP_RETURN_ON_ERROR(ledc_update_duty(BL_MODE, BL_CHANNEL),
+                            TAG, "update duty failed");
+    } else {
+        ESP_RETURN_ON_ERROR(
+            ledc_set_fade_with_time(BL_MODE, BL_CHANNEL, duty, fade_ms),
+            TAG, "set fade failed");
+        ESP_RETURN_ON_ERROR(
+            ledc_fade_start(BL_MODE, BL_CHANNEL, LEDC_FADE_NO_WAIT),
+            TAG, "fade start failed");
+    }
+
+    s_percent = percent > 100 ? 100 : percent;
+    return ESP_OK;
+}
+
+uint8_t backlight_get(void)
+{
+    return s_percent;
+}
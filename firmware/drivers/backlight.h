@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * Configure the LEDC PWM channel on the backlight pin and install the
+ * hardware fade service.  The backlight starts off (duty 0).
+ */
+esp_err_t backlight_init(void);
+
+/**
+ * Set brightness to @p percent (0–100, perceptual).
+ *
+ * @p fade_ms > 0 programs a hardware fade and returns immediately –
+ * the LEDC peripheral ramps the duty with no CPU involvement.
+ * @p fade_ms == 0 cancels any running fade and jumps instantly.
+ */
+esp_err_t backlight_set(uint8_t percent, uint32_t fade_ms);
+
+/**
+ * Return the last requested brightness (fade target), in percent.
+ */
+uint8_t backlight_get(void);
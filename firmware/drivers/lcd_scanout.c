@@ -0,0 +1,472 @@
+/*
+ * LCD scan-out – PSRAM framebuffers fed to the RGB panel through our own
+ * bounce-buffer refill.
+ *
+ * The RGB panel is created with flags.no_fb, so the esp_lcd driver never
+ * touches a framebuffer: every time GDMA drains a bounce buffer it calls
+ * on_bounce_empty() and we copy the next BOUNCE_BUF_LINES rows from the
+ * current front buffer.  Owning the refill gives us two things the stock
+ * pointer-swap path cannot:
+ *
+ *   - Front-buffer switches are applied exactly at the frame boundary
+ *     (pos_px == 0), which also replaces the old VSYNC semaphore.
+ *   - The line mapping can be offset by a few pixels for burn-in
+ *     protection, moving the whole image with zero rasterisation cost.
+ *
+ * The per-line copy costs the same PSRAM bandwidth as the driver's own
+ * memcpy; the shifted case adds one short edge fill per line.  While the
+ * panel sleeps the output is blanked and the refill stops reading PSRAM.
+ *
+ * Indexed mode (APP_LCD_FB_INDEXED, partial render only): the framebuffer
+ * holds one 8-bit palette index per pixel and each line is expanded to
+ * RGB565 through a 256-entry LUT in internal SRAM while filling the bounce
+ * buffer – half the PSRAM bandwidth and framebuffer size of RGB565.  The
+ * palette is RGB332; the flush quantizes LVGL's RGB565 strips with a 4×4
+ * ordered dither so the dark gradients do not band.
+ *
+ * Layouts: a band of lines can be sourced from a 1-bpp tile (e.g. the QR
+ * modules) instead of the framebuffer.  The refill expands the tile bits
+ * to two colours on the fly, so a 280-line QR costs ~10 KB of internal
+ * SRAM and no PSRAM reads at all while it is on screen.  esp_lcd gives
+ * no access to the RGB DMA descriptor chain, so the per-line "descriptor"
+ * is this band lookup in the refill.  Layout changes are double-buffered
+ * and adopted at the frame boundary like a front-buffer switch.
+ */
+
+#include "lcd_scanout.h"
+#include "app_config.h"
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_lcd_panel_rgb.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "scanout";
+
+#if APP_LCD_FB_INDEXED && !APP_LCD_RENDER_PARTIAL
+#error "APP_LCD_FB_INDEXED requires APP_LCD_RENDER_PARTIAL (LVGL draws RGB565)"
+#endif
+
+#define FB_PX       (APP_LCD_H_RES * APP_LCD_V_RES)
+#define FB_BPP      (APP_LCD_FB_INDEXED ? 1 : 2)
+#define FB_BYTES    (FB_PX * FB_BPP)
+
+/* Partial render mode writes one framebuffer in place (GDMA strips). */
+#define FB_COUNT    (APP_LCD_RENDER_PARTIAL ? 1 : 2)
+
+/* ── Module state ────────────────────────────────────────────────────── */
+
+static uint8_t           *s_fb[2];
+static SemaphoreHandle_t  s_present_sem;
+
+/* Written by tasks, consumed by the refill ISR at the frame boundary. */
+static const uint8_t * volatile s_pending;
+/* Shift as one word (dx low, dy high half): the ISR never reads a torn pair. */
+static volatile uint32_t s_next_shift;
+
+/* Owned by the refill ISR. */
+static const uint8_t    *s_front;
+static int16_t           s_dx, s_dy;
+
+/* RGB332 → RGB565 expansion table, in internal SRAM for the ISR. */
+static DRAM_ATTR uint16_t s_lut[256];
+
+static const uint8_t BAYER4[4][4] = {
+    {  0,  8,  2, 10 },
+    { 12,  4, 14,  6 },
+    {  3, 11,  1,  9 },
+    { 15,  7, 13,  5 },
+};
+
+/* Layout slots: tasks fill the inactive one, the refill adopts it. */
+typedef struct {
+    int                n;
+    lcd_scanout_band_t band[LCD_SCANOUT_MAX_BANDS];
+} layout_t;
+
+static layout_t                  s_layout[2];
+static const layout_t           *s_lay;            /* ISR-owned          */
+static const layout_t * volatile s_lay_pending;
+static int64_t                   s_lay_queued_us;
+
+static volatile bool     s_blank;
+static uint8_t           s_blank_fills;     /* bounce buffers zeroed    */
+static lcd_scanout_stats_t s_stats;
+
+static esp_timer_handle_t s_orbit_timer;
+static uint32_t           s_orbit_step;
+
+/* ── Refill (ISR context) ─────────────────────────────────────────────── */
+
+static inline void IRAM_ATTR fill_px(uint16_t *dst, uint16_t c, int n)
+{
+    while (n-- > 0) *dst++ = c;
+}
+
+static inline void IRAM_ATTR copy_line(uint16_t *dst, const uint16_t *src,
+                                       int dx)
+{
+    if (dx == 0) {
+        memcpy(dst, src, APP_LCD_H_RES * sizeof(uint16_t));
+    } else if (dx > 0) {
+        memcpy(dst + dx, src, (APP_LCD_H_RES - dx) * sizeof(uint16_t));
+        fill_px(dst, src[0], dx);
+    } else {
+        memcpy(dst, src - dx, (APP_LCD_H_RES + dx) * sizeof(uint16_t));
+        fill_px(dst + APP_LCD_H_RES + dx, src[APP_LCD_H_RES - 1], -dx);
+    }
+}
+
+static inline void IRAM_ATTR expand_line(uint16_t *dst, const uint8_t *src,
+                                         int dx)
+{
+    int n = APP_LCD_H_RES - (dx < 0 ? -dx : dx);
+    uint16_t *d = dst + (dx > 0 ? dx : 0);
+    const uint8_t *s = src - (dx < 0 ? dx : 0);
+
+    for (int x = 0; x < n; x++) d[x] = s_lut[s[x]];
+
+    if (dx > 0)      fill_px(dst, s_lut[src[0]], dx);
+    else if (dx < 0) fill_px(dst + n, s_lut[src[APP_LCD_H_RES - 1]], -dx);
+}
+
+/* One tile row: bits MSB first, 0 → c0, 1 → c1; c1 also fills the
+   margins left and right of the tile. */
+static inline void IRAM_ATTR band_line(uint16_t *dst,
+                                       const lcd_scanout_band_t *b,
+                                       int row, int dx)
+{
+    int x = b->x + dx;
+    if (x < 0)                         x = 0;
+    if (x > APP_LCD_H_RES - b->w)      x = APP_LCD_H_RES - b->w;
+
+    const uint8_t *bits = b->bits + row * b->stride;
+    uint16_t      *d    = dst + x;
+
+    fill_px(dst, b->c1, x);
+    for (int i = 0; i < b->w; i++) {
+        d[i] = (bits[i >> 3] & (0x80 >> (i & 7))) ? b->c1 : b->c0;
+    }
+    fill_px(d + b->w, b->c1, APP_LCD_H_RES - x - b->w);
+}
+
+static inline const lcd_scanout_band_t * IRAM_ATTR band_at(int sy)
+{
+    const layout_t *l = s_lay;
+    if (!l) return NULL;
+    for (int i = 0; i < l->n; i++) {
+        const lcd_scanout_band_t *b = &l->band[i];
+        if (sy >= b->y && sy < b->y + b->h) return b;
+    }
+    return NULL;
+}
+
+/* Frame boundary: adopt the queued front buffer, layout and shift
+   together so a frame is never assembled from two different states.
+   True if a present() took effect. */
+static bool IRAM_ATTR frame_boundary(void)
+{
+    bool presented = false;
+    const uint8_t *pending = s_pending;
+    if (pending) {
+        s_front   = pending;
+        s_pending = NULL;
+        presented = true;
+    }
+    const layout_t *lay = s_lay_pending;
+    if (lay) {
+        s_lay         = lay->n ? lay : NULL;
+        s_lay_pending = NULL;
+        uint32_t us   = esp_timer_get_time() - s_lay_queued_us;
+        s_stats.layout_switches++;
+        s_stats.switch_us_last = us;
+        if (us > s_stats.switch_us_max) s_stats.switch_us_max = us;
+    }
+    uint32_t shift = s_next_shift;
+    s_dx = (int16_t)(shift & 0xFFFF);
+    s_dy = (int16_t)(shift >> 16);
+    s_stats.frames++;
+    return presented;
+}
+
+static bool IRAM_ATTR on_bounce_empty(esp_lcd_panel_handle_t panel,
+                                      void *bounce_buf, int pos_px,
+                                      int len_bytes, void *user_ctx)
+{
+    BaseType_t yield = pdFALSE;
+
+    if (pos_px == 0 && frame_boundary()) {
+        xSemaphoreGiveFromISR(s_present_sem, &yield);
+    }
+    s_stats.fills++;
+
+    /* Blanked: both bounce buffers hold zeros after two fills. */
+    if (s_blank) {
+        if (s_blank_fills < 2) {
+            memset(bounce_buf, 0, len_bytes);
+            s_blank_fills++;
+        }
+        return (yield == pdTRUE);
+    }
+    s_blank_fills = 0;
+
+    uint16_t *dst   = bounce_buf;
+    int       y     = pos_px / APP_LCD_H_RES;
+    int       lines = len_bytes / (APP_LCD_H_RES * sizeof(uint16_t));
+
+    for (int i = 0; i < lines; i++, y++) {
+        int sy = y - s_dy;
+        if (sy < 0)                  sy = 0;
+        if (sy >= APP_LCD_V_RES)     sy = APP_LCD_V_RES - 1;
+
+        const lcd_scanout_band_t *b = band_at(sy);
+        if (b) {
+            band_line(dst, b, sy - b->y, s_dx);
+            s_stats.band_bytes += b->stride;
+            dst += APP_LCD_H_RES;
+            continue;
+        }
+
+        s_stats.psram_bytes += APP_LCD_H_RES * FB_BPP;
+        const uint8_t *src = s_front + sy * APP_LCD_H_RES * FB_BPP;
+#if APP_LCD_FB_INDEXED
+        expand_line(dst, src, s_dx);
+#else
+        copy_line(dst, (const uint16_t *)src, s_dx);
+#endif
+        dst += APP_LCD_H_RES;
+    }
+
+    return (yield == pdTRUE);
+}
+
+/* ── Burn-in orbit ────────────────────────────────────────────────────── *
+ * Serpentine walk over the (2R+1)² offset grid, then back along the     *
+ * same path: one pixel per step, including the turn at either end.      */
+
+static void orbit_cb(void *arg)
+{
+    (void)arg;
+
+    const int r = APP_BURNIN_SHIFT_MAX_PX;
+    const int n = 2 * r + 1;
+
+    const uint32_t last = (uint32_t)(n * n - 1);
+    uint32_t k   = s_orbit_step++ % (2 * last);
+    if (k > last) k = 2 * last - k;
+    int      row = k / n;
+    int      col = k % n;
+    if (row & 1) col = n - 1 - col;
+
+    lcd_scanout_set_shift(col - r, row - r);
+}
+
+/* ── Palette ─────────────────────────────────────────────────────────── */
+
+static void build_rgb332_lut(void)
+{
+    for (int i = 0; i < 256; i++) {
+        uint16_t r3 = (i >> 5) & 7, g3 = (i >> 2) & 7, b2 = i & 3;
+        uint16_t r5 = (r3 << 2) | (r3 >> 1);
+        uint16_t g6 = (g3 << 3) | g3;
+        uint16_t b5 = (b2 << 3) | (b2 << 1) | (b2 >> 1);
+        s_lut[i] = (r5 << 11) | (g6 << 5) | b5;
+    }
+}
+
+/* ── Public API ──────────────────────────────────────────────────────── */
+
+esp_err_t lcd_scanout_init(void)
+{
+    build_rgb332_lut();
+
+    for (int i = 0; i < FB_COUNT; i++) {
+        s_fb[i] = heap_caps_aligned_calloc(64, 1, FB_BYTES,
+                                           MALLOC_CAP_SPIRAM);
+        ESP_RETURN_ON_FALSE(s_fb[i], ESP_ERR_NO_MEM, TAG,
+                            "framebuffer %d alloc failed", i);
+    }
+
+    s_present_sem = xSemaphoreCreateBinary();
+    ESP_RETURN_ON_FALSE(s_present_sem, ESP_ERR_NO_MEM, TAG,
+                        "present semaphore alloc failed");
+
+    s_front = s_fb[0];
+
+    ESP_LOGI(TAG, "%d× %u KB PSRAM framebuffer (%s)", FB_COUNT,
+             (unsigned)(FB_BYTES / 1024),
+             APP_LCD_FB_INDEXED ? "RGB332 indexed" : "RGB565");
+    return ESP_OK;
+}
+
+esp_err_t lcd_scanout_attach(esp_lcd_panel_handle_t panel)
+{
+    ESP_RETURN_ON_FALSE(panel && s_front, ESP_ERR_INVALID_STATE, TAG,
+                        "scan-out not initialised");
+
+    esp_lcd_rgb_panel_event_callbacks_t cbs = {
+        .on_bounce_empty = on_bounce_empty,
+    };
+    return esp_lcd_rgb_panel_register_event_callbacks(panel, &cbs, NULL);
+}
+
+#if CONFIG_APP_QEMU
+static void virtual_frame_cb(void *arg)
+{
+    (void)arg;
+    if (frame_boundary()) xSemaphoreGive(s_present_sem);
+}
+
+esp_err_t lcd_scanout_start_virtual(void)
+{
+    ESP_RETURN_ON_FALSE(s_front, ESP_ERR_INVALID_STATE, TAG,
+                        "scan-out not initialised");
+
+    const esp_timer_create_args_t args = {
+        .callback = virtual_frame_cb,
+        .name     = "virtual_frame",
+    };
+    esp_timer_handle_t timer;
+    ESP_RETURN_ON_ERROR(esp_timer_create(&args, &timer),
+                        TAG, "frame timer create failed");
+    ESP_LOGW(TAG, "No panel: frames clocked every %d us", APP_QEMU_FRAME_US);
+    return esp_timer_start_periodic(timer, APP_QEMU_FRAME_US);
+}
+#endif
+
+int lcd_scanout_get_fb_count(void)
+{
+    return FB_COUNT;
+}
+
+void *lcd_scanout_get_fb(int index)
+{
+    return (index >= 0 && index < FB_COUNT) ? s_fb[index] : NULL;
+}
+
+const void *lcd_scanout_get_front(void)
+{
+    return s_front;
+}
+
+uint16_t lcd_scanout_index_color(uint8_t i)
+{
+    return s_lut[i];
+}
+
+int lcd_scanout_get_fb_bytes(void)
+{
+    return FB_BYTES;
+}
+
+void lcd_scanout_present(const void *fb)
+{
+    xSemaphoreTake(s_present_sem, 0);      /* drop a stale give */
+    s_pending = fb;
+}
+
+bool lcd_scanout_wait_presented(uint32_t timeout_ms)
+{
+    return xSemaphoreTake(s_present_sem, pdMS_TO_TICKS(timeout_ms)) == pdTRUE;
+}
+
+void lcd_scanout_set_shift(int dx, int dy)
+{
+    s_next_shift = (uint16_t)dx | ((uint32_t)(uint16_t)dy << 16);
+}
+
+esp_err_t lcd_scanout_start_orbit(void)
+{
+    if (APP_BURNIN_SHIFT_MAX_PX <= 0 || s_orbit_timer) {
+        return ESP_OK;
+    }
+
+    const esp_timer_create_args_t args = {
+        .callback = orbit_cb,
+        .name     = "burnin_orbit",
+    };
+    ESP_RETURN_ON_ERROR(esp_timer_create(&args, &s_orbit_timer),
+                        TAG, "orbit timer create failed");
+    ESP_RETURN_ON_ERROR(
+        esp_timer_start_periodic(s_orbit_timer,
+                                 APP_BURNIN_SHIFT_PERIOD_S * 1000000ULL),
+        TAG, "orbit timer start failed");
+
+    ESP_LOGI(TAG, "Burn-in orbit ±%d px, step every %d s",
+             APP_BURNIN_SHIFT_MAX_PX, APP_BURNIN_SHIFT_PERIOD_S);
+    return ESP_OK;
+}
+
+esp_err_t lcd_scanout_set_layout(const lcd_scanout_band_t *bands, int n)
+{
+    ESP_RETURN_ON_FALSE(n >= 0 && n <= LCD_SCANOUT_MAX_BANDS && (bands || !n),
+                        ESP_ERR_INVALID_ARG, TAG, "bad band count %d", n);
+    ESP_RETURN_ON_FALSE(!s_lay_pending, ESP_ERR_INVALID_STATE, TAG,
+                        "layout switch already pending");
+
+    for (int i = 0; i < n; i++) {
+        const lcd_scanout_band_t *b = &bands[i];
+        ESP_RETURN_ON_FALSE(b->bits && b->w > 0 && b->w <= APP_LCD_H_RES
+                            && b->stride >= (b->w + 7) / 8
+                            && b->y >= 0 && b->h > 0
+                            && b->y + b->h <= APP_LCD_V_RES,
+                            ESP_ERR_INVALID_ARG, TAG, "bad band %d", i);
+    }
+
+    /* The slot the refill is not reading (it only reads s_lay). */
+    layout_t *slot = (s_lay == &s_layout[0]) ? &s_layout[1] : &s_layout[0];
+    slot->n = n;
+    if (n) memcpy(slot->band, bands, n * sizeof(*bands));
+
+    s_lay_queued_us = esp_timer_get_time();
+    s_lay_pending   = slot;
+    return ESP_OK;
+}
+
+bool lcd_scanout_layout_pending(void)
+{
+    return s_lay_pending != NULL;
+}
+
+void lcd_scanout_set_blank(bool blank)
+{
+    s_blank = blank;
+}
+
+void lcd_scanout_get_stats(lcd_scanout_stats_t *out)
+{
+    /* 64-bit counters are written by the refill ISR – a torn read is
+       harmless for statistics. */
+    *out = s_stats;
+}
+
+void lcd_scanout_quantize_line(uint8_t *dst, const uint16_t *src, int n,
+                               int x0, int y)
+{
+    const uint8_t *bayer = BAYER4[y & 3];
+
+    for (int i = 0; i < n; i++) {
+        uint16_t c = src[i];
+        int      t = bayer[(x0 + i) & 3];           /* 0..15 */
+        int r = ((c >> 11)        + (t >> 2)) >> 2; /* 5 → 3 bits */
+        int g = (((c >> 5) & 63)  + (t >> 1)) >> 3; /* 6 → 3 bits */
+        int b = ((c & 31)         + (t >> 1)) >> 3; /* 5 → 2 bits */
+        if (r > 7) r = 7;
+        if (g > 7) g = 7;
+        if (b > 3) b = 3;
+        dst[i] = (uint8_t)((r << 5) | (g << 2) | b);
+    }
+}
+
+void lcd_scanout_expand_line(uint16_t *dst, const uint8_t *src, int dx)
+{
+    expand_line(dst, src, dx);
+}
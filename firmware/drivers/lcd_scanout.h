@@ -0,0 +1,149 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_lcd_panel_ops.h"
+
+/** Cumulative refill counters (monotonic since boot). */
+typedef struct {
+    uint64_t fills;         /* bounce-buffer refills                     */
+    uint64_t psram_bytes;   /* framebuffer bytes read from PSRAM         */
+    uint32_t frames;        /* frame boundaries seen by the refill       */
+    uint64_t band_bytes;    /* tile bytes read for band lines (SRAM)     */
+    uint32_t layout_switches;
+    uint32_t switch_us_last;    /* set_layout() → adopted by the refill  */
+    uint32_t switch_us_max;
+} lcd_scanout_stats_t;
+
+#define LCD_SCANOUT_MAX_BANDS   2
+
+/**
+ * A band of screen lines sourced from a 1-bpp tile instead of the
+ * framebuffer.  Bits are MSB first (LVGL INDEXED_1BIT order); a clear bit
+ * shows @c c0, a set bit and the margins beside the tile show @c c1.
+ * The tile memory must stay valid and unchanged while the band is in use.
+ */
+typedef struct {
+    int16_t        x, y;        /* screen position of the tile's top-left */
+    int16_t        w, h;
+    int16_t        stride;      /* bytes per tile row                     */
+    uint16_t       c0, c1;      /* RGB565                                 */
+    const uint8_t *bits;
+} lcd_scanout_band_t;
+
+/**
+ * Allocate the PSRAM scan-out framebuffers (zero-filled → black): two in
+ * direct render mode, one in partial mode (APP_LCD_RENDER_PARTIAL).
+ * Must be called before lcd_scanout_attach().
+ */
+esp_err_t lcd_scanout_init(void);
+
+/**
+ * Number of framebuffers allocated by lcd_scanout_init().
+ */
+int lcd_scanout_get_fb_count(void);
+
+/**
+ * Install the bounce-buffer refill on an RGB panel created with
+ * flags.no_fb.  Must be called before esp_lcd_panel_init(), which
+ * pre-fills the first bounce buffers through this callback.
+ */
+esp_err_t lcd_scanout_attach(esp_lcd_panel_handle_t panel);
+
+/**
+ * QEMU builds (CONFIG_APP_QEMU): there is no RGB peripheral, so clock
+ * the frame boundaries from an esp_timer every APP_QEMU_FRAME_US instead.
+ * Front-buffer and layout switches, present waits and the frame counter
+ * then behave as with a panel; nothing is ever read out.
+ */
+esp_err_t lcd_scanout_start_virtual(void);
+
+/**
+ * Size of one framebuffer in bytes (RGB565, or 8-bit indexed).
+ */
+int lcd_scanout_get_fb_bytes(void);
+
+/**
+ * Return scan-out framebuffer @p index, or NULL if not allocated.
+ */
+void *lcd_scanout_get_fb(int index);
+
+/**
+ * Framebuffer being scanned out now – the one adopted at the last frame
+ * boundary.  In direct mode the other one is LVGL's back buffer.
+ */
+const void *lcd_scanout_get_front(void);
+
+/**
+ * RGB565 colour of palette index @p i, as the refill expands it
+ * (APP_LCD_FB_INDEXED).
+ */
+uint16_t lcd_scanout_index_color(uint8_t i);
+
+/**
+ * Queue @p fb as the front buffer.  The switch happens at the next frame
+ * boundary inside the refill, never mid-frame.
+ */
+void lcd_scanout_present(const void *fb);
+
+/**
+ * Block until the last lcd_scanout_present() has taken effect.
+ * Returns false on timeout.
+ */
+bool lcd_scanout_wait_presented(uint32_t timeout_ms);
+
+/**
+ * Offset the whole image by (@p dx, @p dy) pixels at the next frame.
+ * Applied purely in the refill line mapping – nothing is redrawn.
+ * Uncovered edge pixels repeat the nearest edge row / column.
+ */
+void lcd_scanout_set_shift(int dx, int dy);
+
+/**
+ * Start the burn-in protection orbit: every APP_BURNIN_SHIFT_PERIOD_S the
+ * image moves one pixel along a serpentine path that covers every offset
+ * within ±APP_BURNIN_SHIFT_MAX_PX, walked forth and back so the image
+ * never jumps.  No-op when the maximum is 0.
+ */
+esp_err_t lcd_scanout_start_orbit(void);
+
+/**
+ * Replace the layout with @p n bands (0 = whole screen from the
+ * framebuffer).  Bands are in framebuffer coordinates, so the burn-in
+ * shift moves them with the rest of the image.  Takes effect at the next
+ * frame boundary; returns ESP_ERR_INVALID_STATE while the previous
+ * switch is still pending.
+ */
+esp_err_t lcd_scanout_set_layout(const lcd_scanout_band_t *bands, int n);
+
+/**
+ * True until the last lcd_scanout_set_layout() has been adopted.
+ */
+bool lcd_scanout_layout_pending(void);
+
+/**
+ * Blank the output.  While blanked the refill zeroes each bounce buffer
+ * once and then stops touching PSRAM entirely.
+ */
+void lcd_scanout_set_blank(bool blank);
+
+/**
+ * Copy the refill counters into @p out.
+ */
+void lcd_scanout_get_stats(lcd_scanout_stats_t *out);
+
+/**
+ * Quantize @p n RGB565 pixels starting at screen position (@p x0, @p y)
+ * to RGB332 palette indices with a 4×4 ordered dither.  Used by the
+ * partial-mode flush when APP_LCD_FB_INDEXED is set.
+ */
+void lcd_scanout_quantize_line(uint8_t *dst, const uint16_t *src, int n,
+                               int x0, int y);
+
+/**
+ * Expand one line of palette indices to RGB565 with horizontal shift
+ * @p dx – the refill's own routine, exposed for benchmarking.
+ */
+void lcd_scanout_expand_line(uint16_t *dst, const uint8_t *src, int dx);
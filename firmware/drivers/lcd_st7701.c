@@ -2,31 +2,44 @@
  * ST7701S RGB LCD Driver – Guition ESP32-S3-4848S040
  *
  * 480×480 IPS RGB565 panel, driven via ESP-IDF LCD_CAM peripheral.
- * Controller configured over 3-wire SPI (9-bit, GPIO bit-bang),
- * pixel data streamed over 16-bit RGB parallel interface with
- * double PSRAM framebuffers and SRAM bounce buffers.
+ * Controller configured over 3-wire SPI (9-bit, SPI2 peripheral),
+ * pixel data streamed over 16-bit RGB parallel interface from SRAM
+ * bounce buffers, refilled from the PSRAM framebuffers in lcd_scanout.c.
  *
  * Init sequence: software reset, Command2 BK0 (timing + gamma),
  * Command2 BK1 (voltage), gate/source EQ, BK3 VCOM cal, INVOFF,
  * COLMOD RGB565, Sleep Out, Display ON.
  *
  * Pin assignments are board-specific — edit the PIN_* defines below.
+ *
+ * QEMU builds (CONFIG_APP_QEMU) skip the controller and the RGB panel:
+ * the framebuffers and LVGL paths run unchanged on a timer frame clock
+ * (lcd_scanout_start_virtual) and the handle is a placeholder.
  */
 
 #include "lcd_st7701.h"
+#include "lcd_st7701_seq.h"
+#include "lcd_scanout.h"
+#include "backlight.h"
 #include "app_config.h"
 
 #include <string.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/semphr.h"
 
 #include "esp_log.h"
 #include "esp_check.h"
+#include "esp_timer.h"
 #include "esp_lcd_panel_rgb.h"
-#include "esp_rom_sys.h"
+#include "esp_heap_caps.h"
+#include "esp_attr.h"
+#include "esp_cache.h"
+#include "esp_async_memcpy.h"
 #include "driver/gpio.h"
+#include "driver/spi_master.h"
+#include "esp_lcd_panel_interface.h"
+#include "sdkconfig.h"
 
 static const char *TAG = "st7701";
 
@@ -34,9 +47,6 @@ static const char *TAG = "st7701";
  *  Pin definitions – CHANGE THESE to match your board                    *
  * ═══════════════════════════════════════════════════════════════════════ */
 
-/* Backlight (PWM-capable, active-high) */
-#define PIN_BL          GPIO_NUM_38
-
 /* 3-wire SPI for ST7701S command interface */
 #define PIN_SPI_CS      GPIO_NUM_39
 #define PIN_SPI_SCK     GPIO_NUM_48
@@ -72,6 +82,7 @@ static const char *TAG = "st7701";
  * ═══════════════════════════════════════════════════════════════════════ */
 
 #define PCLK_HZ             (12 * 1000 * 1000)
+#define SLEEP_PCLK_HZ       (1 * 1000 * 1000)   /* ~3 Hz while asleep */
 #define HSYNC_BACK_PORCH    50
 #define HSYNC_FRONT_PORCH   50
 #define HSYNC_PULSE_WIDTH   10
@@ -81,7 +92,8 @@ static const char *TAG = "st7701";
 
 /*
  * Bounce buffer: small SRAM staging area between PSRAM and GDMA.
- * The CPU copies PSRAM→bounce while GDMA reads bounce→LCD_CAM.
+ * The CPU copies PSRAM→bounce (lcd_scanout refill) while GDMA reads
+ * bounce→LCD_CAM.  Must be a whole number of lines.
  * Larger values reduce refill interrupt overhead but consume more SRAM.
  * 20 lines × 480 px × 2 bytes = 19 200 bytes of internal SRAM.
  *
@@ -92,235 +104,165 @@ static const char *TAG = "st7701";
  */
 #define BOUNCE_BUF_LINES    20
 
+/* Framebuffer layout for the ready log (allocated by lcd_scanout.c) */
+#if APP_LCD_FB_INDEXED
+#define LCD_FB_MODE "1× PSRAM RGB332 framebuffer, partial render"
+#elif APP_LCD_RENDER_PARTIAL
+#define LCD_FB_MODE "1× PSRAM RGB565 framebuffer, partial render"
+#else
+#define LCD_FB_MODE "2× PSRAM RGB565 framebuffer, direct render"
+#endif
+
+#if !CONFIG_APP_QEMU   /* QEMU: no controller to talk to */
+
 /* ═══════════════════════════════════════════════════════════════════════ *
- *  3-wire SPI (bit-bang) – used only once during ST7701S register init   *
+ *  3-wire SPI (SPI2 peripheral, 9-bit) – ST7701S command interface       *
+ *                                                                        *
+ *  Each 9-bit frame is one half-duplex transaction: a 1-bit command      *
+ *  phase carries DC (0→cmd, 1→data), followed by 8 data bits MSB first,  *
+ *  with CS toggled per frame exactly as the old bit-bang path did.       *
+ *  Transactions are queued and the caller blocks on the results, so the  *
+ *  CPU is free while the peripheral shifts bits out.                     *
+ *                                                                        *
+ *  Clock stays at the conservative ~50 kHz of the old bit-bang timing    *
+ *  (10 µs per edge).  The XTAL source is needed to divide down that far. *
+ *  Do not "optimise" the clock; the margin is for long SPI traces.       *
  * ═══════════════════════════════════════════════════════════════════════ */
 
-static void spi_gpio_init(void)
+#define ST7701_SPI_HOST     SPI2_HOST
+#define ST7701_SPI_CLK_HZ   50000
+#define ST7701_SPI_QUEUE    16
+
+static spi_device_handle_t s_spi;
+static spi_transaction_t   s_trans[ST7701_SPI_QUEUE];
+static int                 s_trans_slot;
+static int                 s_trans_inflight;
+
+static esp_err_t spi_3wire_init(void)
 {
-    const gpio_config_t spi_io = {
-        .pin_bit_mask = (1ULL << PIN_SPI_CS)
-                      | (1ULL << PIN_SPI_SCK)
-                      | (1ULL << PIN_SPI_SDA),
-        .mode         = GPIO_MODE_OUTPUT,
-        .pull_up_en   = GPIO_PULLUP_DISABLE,
-        .pull_down_en = GPIO_PULLDOWN_DISABLE,
-        .intr_type    = GPIO_INTR_DISABLE,
+    const spi_bus_config_t bus = {
+        .mosi_io_num     = PIN_SPI_SDA,
+        .miso_io_num     = -1,
+        .sclk_io_num     = PIN_SPI_SCK,
+        .quadwp_io_num   = -1,
+        .quadhd_io_num   = -1,
+        .max_transfer_sz = 4,
     };
-    gpio_config(&spi_io);
-
-    gpio_set_level(PIN_SPI_CS,  1);    /* CS idle HIGH  */
-    gpio_set_level(PIN_SPI_SCK, 0);    /* CPOL=0: SCK idle LOW */
-    gpio_set_level(PIN_SPI_SDA, 0);
+    ESP_RETURN_ON_ERROR(
+        spi_bus_initialize(ST7701_SPI_HOST, &bus, SPI_DMA_DISABLED),
+        TAG, "SPI bus init failed");
+
+    const spi_device_interface_config_t dev = {
+        .command_bits     = 1,              /* DC bit              */
+        .mode             = 0,              /* CPOL=0, CPHA=0      */
+        .clock_source     = SPI_CLK_SRC_XTAL,
+        .clock_speed_hz   = ST7701_SPI_CLK_HZ,
+        .cs_ena_pretrans  = 1,
+        .cs_ena_posttrans = 1,
+        .spics_io_num     = PIN_SPI_CS,
+        .queue_size       = ST7701_SPI_QUEUE,
+        .flags            = SPI_DEVICE_3WIRE | SPI_DEVICE_HALFDUPLEX,
+    };
+    return spi_bus_add_device(ST7701_SPI_HOST, &dev, &s_spi);
 }
 
-/*
- * SPI MODE 0 bit-bang: CPOL=0 (idle LOW), CPHA=0 (latch on RISING edge).
- * Transmit one 9-bit frame: bit 8 = DC (0→cmd, 1→data), bits 7…0 = MSB first.
- *
- * 10 µs per clock edge (~50 kHz effective).  Conservative but irrelevant —
- * the entire init takes ~30 ms of SPI time plus the 120 ms sleep-out delay.
- * Do not "optimise" this to faster timing; the margin buys nothing and risks
- * setup/hold violations on boards with long SPI traces.
- */
-static void spi_write_9bit(bool dc, uint8_t val)
+static esp_err_t spi_drain(void)
 {
-    gpio_set_level(PIN_SPI_SCK, 0);       /* 1. ensure SCK LOW         */
-    esp_rom_delay_us(10);
-    gpio_set_level(PIN_SPI_CS, 0);        /* 2. CS assert              */
-    esp_rom_delay_us(10);
-
-    /* ── DC bit (bit 8) ─────────────────────────── */
-    gpio_set_level(PIN_SPI_SDA, dc);      /* 3. set data while SCK LOW */
-    esp_rom_delay_us(10);
-    gpio_set_level(PIN_SPI_SCK, 1);       /* 4. rising edge → latch    */
-    esp_rom_delay_us(10);
-    gpio_set_level(PIN_SPI_SCK, 0);       /* 5. SCK back LOW           */
-    esp_rom_delay_us(10);
-
-    /* ── D7…D0 (bits 7 → 0) ────────────────────── */
-    for (int i = 7; i >= 0; i--) {
-        gpio_set_level(PIN_SPI_SDA, (val >> i) & 1);
-        esp_rom_delay_us(10);
-        gpio_set_level(PIN_SPI_SCK, 1);   /* rising edge → latch       */
-        esp_rom_delay_us(10);
-        gpio_set_level(PIN_SPI_SCK, 0);   /* SCK back LOW              */
-        esp_rom_delay_us(10);
+    spi_transaction_t *done;
+    while (s_trans_inflight > 0) {
+        ESP_RETURN_ON_ERROR(
+            spi_device_get_trans_result(s_spi, &done, portMAX_DELAY),
+            TAG, "SPI transaction failed");
+        s_trans_inflight--;
     }
-
-    esp_rom_delay_us(10);
-    gpio_set_level(PIN_SPI_CS, 1);        /* CS de-assert              */
-    esp_rom_delay_us(10);
+    return ESP_OK;
 }
 
-static inline void st7701_cmd(uint8_t cmd)   { spi_write_9bit(false, cmd); }
-static inline void st7701_data(uint8_t d)    { spi_write_9bit(true,  d);   }
-
-/* ═══════════════════════════════════════════════════════════════════════ *
- *  ST7701S register initialisation                                       *
- *                                                                        *
- *  Original working init sequence restored.  Inline sequential calls,   *
- *  no table-driven architecture.                                        *
- * ═══════════════════════════════════════════════════════════════════════ */
-
-static void st7701_panel_init(void)
+/* Results complete in order, so the oldest slot is free once reaped. */
+static esp_err_t spi_queue_9bit(bool dc, uint8_t val)
 {
-    /* Software reset */
-    st7701_cmd(0x01);
-    vTaskDelay(pdMS_TO_TICKS(120));
+    if (s_trans_inflight == ST7701_SPI_QUEUE) {
+        spi_transaction_t *done;
+        ESP_RETURN_ON_ERROR(
+            spi_device_get_trans_result(s_spi, &done, portMAX_DELAY),
+            TAG, "SPI transaction failed");
+        s_trans_inflight--;
+    }
 
-    /* ---- Command2 BK0 (timing + gamma) ---- */
-    st7701_cmd(0xFF);
-    st7701_data(0x77); st7701_data(0x01); st7701_data(0x00);
-    st7701_data(0x00); st7701_data(0x10);
-
-    st7701_cmd(0xC0);
-    st7701_data(0x3B); st7701_data(0x00);
-
-    st7701_cmd(0xC1);
-    st7701_data(0x0D); st7701_data(0x02);
-
-    st7701_cmd(0xC2);
-    st7701_data(0x31); st7701_data(0x05);
-
-    st7701_cmd(0xCD);
-    st7701_data(0x00);
-
-    /* Positive gamma (16 bytes) */
-    st7701_cmd(0xB0);
-    st7701_data(0x00); st7701_data(0x11); st7701_data(0x18); st7701_data(0x0E);
-    st7701_data(0x11); st7701_data(0x06); st7701_data(0x07); st7701_data(0x08);
-    st7701_data(0x07); st7701_data(0x22); st7701_data(0x04); st7701_data(0x12);
-    st7701_data(0x0F); st7701_data(0xAA); st7701_data(0x31); st7701_data(0x18);
-
-    /* Negative gamma (16 bytes) */
-    st7701_cmd(0xB1);
-    st7701_data(0x00); st7701_data(0x11); st7701_data(0x19); st7701_data(0x0E);
-    st7701_data(0x12); st7701_data(0x07); st7701_data(0x08); st7701_data(0x08);
-    st7701_data(0x08); st7701_data(0x22); st7701_data(0x04); st7701_data(0x11);
-    st7701_data(0x11); st7701_data(0xA9); st7701_data(0x32); st7701_data(0x18);
-
-    /* ---- Command2 BK1 (voltage) ---- */
-    st7701_cmd(0xFF);
-    st7701_data(0x77); st7701_data(0x01); st7701_data(0x00);
-    st7701_data(0x00); st7701_data(0x11);
-
-    st7701_cmd(0xB0); st7701_data(0x60);
-    st7701_cmd(0xB1); st7701_data(0x32);
-    st7701_cmd(0xB2); st7701_data(0x07);
-    st7701_cmd(0xB3); st7701_data(0x80);
-    st7701_cmd(0xB5); st7701_data(0x49);
-    st7701_cmd(0xB7); st7701_data(0x85);
-    st7701_cmd(0xB8); st7701_data(0x21);
-    st7701_cmd(0xC1); st7701_data(0x78);
-    st7701_cmd(0xC2); st7701_data(0x78);
-    st7701_cmd(0xD0); st7701_data(0x88);
-    vTaskDelay(pdMS_TO_TICKS(100));
-
-    /* ---- Gate EQ / Source EQ ---- */
-    st7701_cmd(0xE0);
-    st7701_data(0x00); st7701_data(0x1B); st7701_data(0x02);
-
-    st7701_cmd(0xE1);
-    st7701_data(0x08); st7701_data(0xA0); st7701_data(0x00); st7701_data(0x00);
-    st7701_data(0x07); st7701_data(0xA0); st7701_data(0x00); st7701_data(0x00);
-    st7701_data(0x00); st7701_data(0x44); st7701_data(0x44);
-
-    st7701_cmd(0xE2);
-    st7701_data(0x11); st7701_data(0x11); st7701_data(0x44); st7701_data(0x44);
-    st7701_data(0xED); st7701_data(0xA0); st7701_data(0x00); st7701_data(0x00);
-    st7701_data(0xEC); st7701_data(0xA0); st7701_data(0x00); st7701_data(0x00);
-
-    st7701_cmd(0xE3);
-    st7701_data(0x00); st7701_data(0x00); st7701_data(0x11); st7701_data(0x11);
-
-    st7701_cmd(0xE4);
-    st7701_data(0x44); st7701_data(0x44);
-
-    st7701_cmd(0xE5);
-    st7701_data(0x0A); st7701_data(0xE9); st7701_data(0xD8); st7701_data(0xA0);
-    st7701_data(0x0C); st7701_data(0xEB); st7701_data(0xD8); st7701_data(0xA0);
-    st7701_data(0x0E); st7701_data(0xED); st7701_data(0xD8); st7701_data(0xA0);
-    st7701_data(0x10); st7701_data(0xEF); st7701_data(0xD8); st7701_data(0xA0);
-
-    st7701_cmd(0xE6);
-    st7701_data(0x00); st7701_data(0x00); st7701_data(0x11); st7701_data(0x11);
-
-    st7701_cmd(0xE7);
-    st7701_data(0x44); st7701_data(0x44);
-
-    st7701_cmd(0xE8);
-    st7701_data(0x09); st7701_data(0xE8); st7701_data(0xD8); st7701_data(0xA0);
-    st7701_data(0x0B); st7701_data(0xEA); st7701_data(0xD8); st7701_data(0xA0);
-    st7701_data(0x0D); st7701_data(0xEC); st7701_data(0xD8); st7701_data(0xA0);
-    st7701_data(0x0F); st7701_data(0xEE); st7701_data(0xD8); st7701_data(0xA0);
-
-    st7701_cmd(0xEB);
-    st7701_data(0x02); st7701_data(0x00); st7701_data(0xE4); st7701_data(0xE4);
-    st7701_data(0x88); st7701_data(0x00); st7701_data(0x40);
-
-    st7701_cmd(0xEC);
-    st7701_data(0x3C); st7701_data(0x00);
-
-    st7701_cmd(0xED);
-    st7701_data(0xAB); st7701_data(0x89); st7701_data(0x76); st7701_data(0x54);
-    st7701_data(0x02); st7701_data(0xFF); st7701_data(0xFF); st7701_data(0xFF);
-    st7701_data(0xFF); st7701_data(0xFF); st7701_data(0xFF); st7701_data(0x20);
-    st7701_data(0x45); st7701_data(0x67); st7701_data(0x98); st7701_data(0xBA);
-
-    /* ---- Command2 BK3 – VCOM calibration ---- */
-    st7701_cmd(0xFF);
-    st7701_data(0x77); st7701_data(0x01); st7701_data(0x00);
-    st7701_data(0x00); st7701_data(0x13);
-
-    st7701_cmd(0xE5); st7701_data(0xE4);
-
-    /* ---- Exit Command2 ---- */
-    st7701_cmd(0xFF);
-    st7701_data(0x77); st7701_data(0x01); st7701_data(0x00);
-    st7701_data(0x00); st7701_data(0x00);
-
-    /* ---- Standard commands ---- */
-    st7701_cmd(0x20);                           /* INVOFF */
-    st7701_cmd(0x3A); st7701_data(0x50);        /* COLMOD: 16-bit RGB interface */
-    st7701_cmd(0x11);                           /* Sleep Out */
-    vTaskDelay(pdMS_TO_TICKS(120));
-    st7701_cmd(0x29);                           /* Display ON */
-    vTaskDelay(pdMS_TO_TICKS(20));
-}
+    spi_transaction_t *t = &s_trans[s_trans_slot];
+    s_trans_slot = (s_trans_slot + 1) % ST7701_SPI_QUEUE;
 
-/* ═══════════════════════════════════════════════════════════════════════ *
- *  Backlight                                                             *
- * ═══════════════════════════════════════════════════════════════════════ */
+    *t = (spi_transaction_t) {
+        .cmd     = dc,
+        .length  = 8,
+        .flags   = SPI_TRANS_USE_TXDATA,
+        .tx_data = { val },
+    };
+    ESP_RETURN_ON_ERROR(spi_device_queue_trans(s_spi, t, portMAX_DELAY),
+                        TAG, "SPI queue failed");
+    s_trans_inflight++;
+    return ESP_OK;
+}
 
-static void backlight_set(bool on)
+/*
+ * Send a command table.  Frames are queued back-to-back; the queue is
+ * drained only before a delay, so the inter-command gap is unchanged.
+ */
+static esp_err_t st7701_send(const st7701_cmd_t *seq, size_t n)
 {
-    gpio_config_t cfg = {
-        .pin_bit_mask = 1ULL << PIN_BL,
-        .mode         = GPIO_MODE_OUTPUT,
-    };
-    gpio_config(&cfg);
-    gpio_set_level(PIN_BL, on);
+    for (size_t i = 0; i < n; i++) {
+        ESP_RETURN_ON_ERROR(spi_queue_9bit(false, seq[i].cmd), TAG, "cmd");
+        for (int j = 0; j < seq[i].len; j++) {
+            ESP_RETURN_ON_ERROR(spi_queue_9bit(true, seq[i].data[j]),
+                                TAG, "data");
+        }
+        if (seq[i].delay_ms) {
+            ESP_RETURN_ON_ERROR(spi_drain(), TAG, "drain");
+            vTaskDelay(pdMS_TO_TICKS(seq[i].delay_ms));
+        }
+    }
+    return spi_drain();
 }
 
+#endif /* !CONFIG_APP_QEMU */
+
 /* ═══════════════════════════════════════════════════════════════════════ *
  *  lcd_st7701_init                                                       *
  * ═══════════════════════════════════════════════════════════════════════ */
 
+#if CONFIG_APP_QEMU
+/* Non-NULL for the callers' checks; no esp_lcd call ever receives it. */
+static esp_lcd_panel_t s_qemu_panel;
+#endif
+
 esp_err_t lcd_st7701_init(esp_lcd_panel_handle_t *out_panel)
 {
     ESP_RETURN_ON_FALSE(out_panel, ESP_ERR_INVALID_ARG, TAG,
                         "out_panel is NULL");
 
+#if CONFIG_APP_QEMU
+    ESP_RETURN_ON_ERROR(backlight_init(), TAG, "backlight init failed");
+    ESP_RETURN_ON_ERROR(lcd_scanout_init(), TAG, "scan-out init failed");
+    ESP_RETURN_ON_ERROR(lcd_scanout_start_virtual(), TAG,
+                        "virtual frame clock failed");
+    ESP_LOGW(TAG, "QEMU: no ST7701S / RGB panel");
+    *out_panel = &s_qemu_panel;
+    return ESP_OK;
+#else
     /* Backlight off while configuring */
-    backlight_set(false);
+    ESP_RETURN_ON_ERROR(backlight_init(), TAG, "backlight init failed");
 
     /* ST7701S register init over 3-wire SPI */
-    spi_gpio_init();
-    st7701_panel_init();
+    ESP_RETURN_ON_ERROR(spi_3wire_init(), TAG, "3-wire SPI init failed");
+    ESP_RETURN_ON_ERROR(st7701_send(ST7701_INIT,
+                                    sizeof(ST7701_INIT) / sizeof(ST7701_INIT[0])),
+                        TAG, "ST7701S command init failed");
     ESP_LOGI(TAG, "ST7701S command init done");
 
-    /* Create the ESP-IDF RGB panel with double PSRAM framebuffers */
+    /* Framebuffers are owned by the scan-out module, not the driver */
+    ESP_RETURN_ON_ERROR(lcd_scanout_init(), TAG, "scan-out init failed");
+
+    /* Create the ESP-IDF RGB panel (bounce buffers only, no driver FB) */
     esp_lcd_rgb_panel_config_t rgb_cfg = {
         .clk_src = LCD_CLK_SRC_DEFAULT,
         .timings = {
@@ -337,9 +279,8 @@ esp_err_t lcd_st7701_init(esp_lcd_panel_handle_t *out_panel)
         },
         .data_width = 16,        /* RGB565 */
         .bits_per_pixel = 16,   /* must match COLMOD 0x50 */
-        .num_fbs    = 2,        /* double framebuffer in PSRAM */
+        .num_fbs    = 0,        /* framebuffers live in lcd_scanout */
         .bounce_buffer_size_px = APP_LCD_H_RES * BOUNCE_BUF_LINES,
-        .psram_trans_align     = 64,
         .hsync_gpio_num  = PIN_HSYNC,
         .vsync_gpio_num  = PIN_VSYNC,
         .de_gpio_num     = PIN_DE,
@@ -351,13 +292,17 @@ esp_err_t lcd_st7701_init(esp_lcd_panel_handle_t *out_panel)
             PIN_D10, PIN_D11, PIN_D12, PIN_D13, PIN_D14, PIN_D15,
         },
         .flags = {
-            .fb_in_psram = true,
+            .no_fb = true,      /* refill via on_bounce_empty */
         },
     };
 
     esp_lcd_panel_handle_t panel = NULL;
     ESP_RETURN_ON_ERROR(esp_lcd_new_rgb_panel(&rgb_cfg, &panel),
                         TAG, "RGB panel creation failed");
+
+    /* Refill must be installed before init pre-fills the bounce buffers */
+    ESP_RETURN_ON_ERROR(lcd_scanout_attach(panel),
+                        TAG, "scan-out attach failed");
     ESP_RETURN_ON_ERROR(esp_lcd_panel_init(panel),
                         TAG, "RGB panel init failed");
 
@@ -365,7 +310,7 @@ esp_err_t lcd_st7701_init(esp_lcd_panel_handle_t *out_panel)
      *  PHASE 5 — Backlight ON after valid frames                       *
      *                                                                   *
      *  esp_lcd_panel_init() started the PCLK and GDMA.  The PSRAM      *
-     *  framebuffers were zero-filled by the allocator, so the panel     *
+     *  framebuffers were zero-filled by lcd_scanout, so the panel       *
      *  is now receiving valid black frames.  We wait for 5 full frames  *
      *  (~120 ms at 12 MHz / ~42 Hz) to ensure:                         *
      *    - Source drivers have latched known-good pixel data             *
@@ -376,79 +321,251 @@ esp_err_t lcd_st7701_init(esp_lcd_panel_handle_t *out_panel)
      *  source driver state (random pixels or white) on cold boot.       *
      * ================================================================ */
     vTaskDelay(pdMS_TO_TICKS(120));
-    backlight_set(true);
+    backlight_set(APP_BL_BOOT_PCT, APP_BL_FADE_MS);
+
+    ESP_RETURN_ON_ERROR(lcd_scanout_start_orbit(), TAG,
+                        "burn-in orbit start failed");
 
-    ESP_LOGI(TAG, "LCD ready (%dx%d RGB565, 2× PSRAM framebuffer)",
-             APP_LCD_H_RES, APP_LCD_V_RES);
+    ESP_LOGI(TAG, "LCD ready (%dx%d, %s)", APP_LCD_H_RES, APP_LCD_V_RES,
+             LCD_FB_MODE);
 
     *out_panel = panel;
     return ESP_OK;
+#endif
+}
+
+/* ═══════════════════════════════════════════════════════════════════════ *
+ *  Sleep / wake                                                          *
+ *                                                                        *
+ *  esp_lcd cannot stop the RGB DMA without deleting the panel, so sleep  *
+ *  blanks the scan-out (no PSRAM reads) and drops PCLK until the refill  *
+ *  interrupt rate is negligible.  The controller ignores RGB input while *
+ *  in sleep-in.                                                          *
+ * ═══════════════════════════════════════════════════════════════════════ */
+
+esp_err_t lcd_st7701_sleep(esp_lcd_panel_handle_t panel)
+{
+    ESP_RETURN_ON_FALSE(panel, ESP_ERR_INVALID_ARG, TAG, "panel is NULL");
+
+    backlight_set(0, 0);
+#if CONFIG_APP_QEMU
+    lcd_scanout_set_blank(true);
+#else
+    ESP_RETURN_ON_ERROR(st7701_send(ST7701_SLEEP_IN,
+                                    sizeof(ST7701_SLEEP_IN) / sizeof(ST7701_SLEEP_IN[0])),
+                        TAG, "sleep-in failed");
+
+    lcd_scanout_set_blank(true);
+    ESP_RETURN_ON_ERROR(esp_lcd_rgb_panel_set_pclk(panel, SLEEP_PCLK_HZ),
+                        TAG, "set sleep PCLK failed");
+
+    ESP_LOGI(TAG, "Panel asleep (PCLK %d Hz)", SLEEP_PCLK_HZ);
+#endif
+    return ESP_OK;
+}
+
+esp_err_t lcd_st7701_wake(esp_lcd_panel_handle_t panel)
+{
+    ESP_RETURN_ON_FALSE(panel, ESP_ERR_INVALID_ARG, TAG, "panel is NULL");
+
+#if CONFIG_APP_QEMU
+    lcd_scanout_set_blank(false);
+#else
+    /* Restore real frames first so the controller wakes onto valid data */
+    ESP_RETURN_ON_ERROR(esp_lcd_rgb_panel_set_pclk(panel, PCLK_HZ),
+                        TAG, "restore PCLK failed");
+    lcd_scanout_set_blank(false);
+
+    ESP_RETURN_ON_ERROR(st7701_send(ST7701_SLEEP_OUT,
+                                    sizeof(ST7701_SLEEP_OUT) / sizeof(ST7701_SLEEP_OUT[0])),
+                        TAG, "sleep-out failed");
+
+    ESP_LOGI(TAG, "Panel awake");
+#endif
+    return ESP_OK;
 }
 
 /* ═══════════════════════════════════════════════════════════════════════ *
- *  LVGL registration – direct-mode, VSYNC-synchronised flush             *
+ *  LVGL registration                                                     *
+ *                                                                        *
+ *  APP_LCD_RENDER_PARTIAL = 0  Direct mode: both LVGL buffers ARE the    *
+ *      two PSRAM framebuffers; blends read-modify-write PSRAM.           *
+ *  APP_LCD_RENDER_PARTIAL = 1  Partial mode: LVGL renders dirty areas    *
+ *      (rounded to full lines) into two internal-SRAM strips; GDMA       *
+ *      async memcpy pushes each strip into the single scan-out           *
+ *      framebuffer while LVGL renders the next one.                      *
+ *  APP_LCD_FB_INDEXED = 8      Partial mode only: the CPU quantizes each  *
+ *      strip to RGB332 indices on its way into the 8-bit framebuffer.    *
  * ═══════════════════════════════════════════════════════════════════════ */
 
-static SemaphoreHandle_t s_vsync_sem;
+static lcd_render_stats_t s_render;
 
-static bool IRAM_ATTR on_vsync(esp_lcd_panel_handle_t panel,
-                               const esp_lcd_rgb_panel_event_data_t *edata,
-                               void *user_ctx)
+/* Per-refresh render time and pixel count, reported by LVGL. */
+static void lvgl_monitor_cb(lv_disp_drv_t *drv, uint32_t time_ms, uint32_t px)
 {
-    BaseType_t yield = pdFALSE;
-    xSemaphoreGiveFromISR(s_vsync_sem, &yield);
-    return (yield == pdTRUE);
+    (void)drv;
+    s_render.refreshes++;
+    s_render.render_ms += time_ms;
+    s_render.render_px += px;
+    s_render.last_render_ms    = time_ms;
+    s_render.last_render_at_us = esp_timer_get_time();
 }
 
+#if APP_LCD_RENDER_PARTIAL
+
+/*
+ * Widen every dirty area to full lines: each strip is then one
+ * contiguous, 64-byte-aligned block in the framebuffer (960 B per line),
+ * which GDMA can copy in one transaction and the cache can invalidate.
+ */
+static void lvgl_rounder_cb(lv_disp_drv_t *drv, lv_area_t *area)
+{
+    (void)drv;
+    area->x1 = 0;
+    area->x2 = APP_LCD_H_RES - 1;
+}
+
+#if APP_LCD_FB_INDEXED
+
+/*
+ * Indexed framebuffer: the strip must be converted anyway, so the CPU
+ * quantizes it straight into PSRAM (1 B/px) instead of a GDMA copy.
+ */
+static void lvgl_flush_cb(lv_disp_drv_t *drv, const lv_area_t *area,
+                          lv_color_t *color_map)
+{
+    uint8_t        *fb  = lcd_scanout_get_fb(0);
+    const uint16_t *src = (const uint16_t *)color_map;
+
+    for (int y = area->y1; y <= area->y2; y++) {
+        lcd_scanout_quantize_line(fb + y * APP_LCD_H_RES, src,
+                                  APP_LCD_H_RES, 0, y);
+        src += APP_LCD_H_RES;
+    }
+    s_render.flush_bytes += (size_t)lv_area_get_height(area) * APP_LCD_H_RES;
+
+    lv_disp_flush_ready(drv);
+}
+
+#else
+
+static async_memcpy_handle_t s_mcp;
+
+/* Framebuffer target of the strip in flight (LVGL flushes one at a time) */
+static void  *s_strip_dst;
+static size_t s_strip_len;
+
+static bool IRAM_ATTR on_strip_copied(async_memcpy_handle_t mcp,
+                                      async_memcpy_event_t *event,
+                                      void *cb_args)
+{
+    (void)mcp;
+    (void)event;
+    lv_disp_drv_t *drv = cb_args;
+
+    /* The refill reads the framebuffer through the cache – drop any
+       stale lines before LVGL may reuse this strip. */
+    esp_cache_msync(s_strip_dst, s_strip_len, ESP_CACHE_MSYNC_FLAG_DIR_M2C);
+    lv_disp_flush_ready(drv);
+    return false;
+}
+
+static void lvgl_flush_cb(lv_disp_drv_t *drv, const lv_area_t *area,
+                          lv_color_t *color_map)
+{
+    uint16_t *fb  = lcd_scanout_get_fb(0);
+    size_t    len = (size_t)lv_area_get_height(area) * APP_LCD_H_RES
+                    * sizeof(lv_color_t);
+
+    s_strip_dst           = fb + area->y1 * APP_LCD_H_RES;
+    s_strip_len           = len;
+    s_render.flush_bytes += len;
+
+    if (esp_async_memcpy(s_mcp, s_strip_dst, color_map, len,
+                         on_strip_copied, drv) != ESP_OK) {
+        /* DMA backlog full – fall back to a CPU copy */
+        memcpy(s_strip_dst, color_map, len);
+        lv_disp_flush_ready(drv);
+    }
+}
+
+#endif /* APP_LCD_FB_INDEXED */
+
+static esp_err_t init_draw_buf(lv_disp_draw_buf_t *draw_buf)
+{
+    const size_t strip_px    = APP_LCD_H_RES * APP_LCD_PARTIAL_LINES;
+    const size_t strip_bytes = strip_px * sizeof(lv_color_t);
+
+    void *buf0 = heap_caps_aligned_alloc(64, strip_bytes,
+                                         MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA);
+    void *buf1 = heap_caps_aligned_alloc(64, strip_bytes,
+                                         MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA);
+    ESP_RETURN_ON_FALSE(buf0 && buf1, ESP_ERR_NO_MEM, TAG,
+                        "SRAM strip alloc failed");
+
+#if !APP_LCD_FB_INDEXED
+    async_memcpy_config_t mcp_cfg = ASYNC_MEMCPY_DEFAULT_CONFIG();
+    mcp_cfg.backlog        = 4;
+    mcp_cfg.dma_burst_size = 64;
+    ESP_RETURN_ON_ERROR(esp_async_memcpy_install(&mcp_cfg, &s_mcp),
+                        TAG, "async memcpy install failed");
+#endif
+
+    lv_disp_draw_buf_init(draw_buf, buf0, buf1, strip_px);
+    s_render.sram_bytes = 2 * strip_bytes;
+    return ESP_OK;
+}
+
+#else  /* direct mode */
+
 /*
  * Flush callback for LVGL.
  *
  * In direct mode the colour buffer IS one of the two PSRAM framebuffers.
- * Calling draw_bitmap with that pointer triggers a fast pointer swap
- * inside the RGB panel driver (no pixel copy).  We then wait for VSYNC
- * so the swap takes effect before LVGL starts drawing into the now-
- * inactive back-buffer.
+ * Presenting it queues a pointer swap that the scan-out refill applies
+ * at the next frame boundary (no pixel copy).  We wait for that swap
+ * before LVGL starts drawing into the now-inactive back-buffer.
  */
 static void lvgl_flush_cb(lv_disp_drv_t *drv, const lv_area_t *area,
                           lv_color_t *color_map)
 {
-    esp_lcd_panel_handle_t panel = drv->user_data;
-
-    esp_lcd_panel_draw_bitmap(panel, 0, 0,
-                              APP_LCD_H_RES, APP_LCD_V_RES, color_map);
+    (void)area;
 
-    xSemaphoreTake(s_vsync_sem, pdMS_TO_TICKS(100));
+    lcd_scanout_present(color_map);
+    lcd_scanout_wait_presented(100);
 
     lv_disp_flush_ready(drv);
 }
 
+static esp_err_t init_draw_buf(lv_disp_draw_buf_t *draw_buf)
+{
+    /* Obtain the two PSRAM framebuffer addresses (zero-copy) */
+    void *fb0 = lcd_scanout_get_fb(0);
+    void *fb1 = lcd_scanout_get_fb(1);
+    ESP_RETURN_ON_FALSE(fb0 && fb1, ESP_ERR_INVALID_STATE, TAG,
+                        "scan-out framebuffers missing");
+
+    /* LVGL draw buffer pair — points straight at the PSRAM framebuffers */
+    lv_disp_draw_buf_init(draw_buf, fb0, fb1,
+                          APP_LCD_H_RES * APP_LCD_V_RES);
+    s_render.sram_bytes = 0;
+    return ESP_OK;
+}
+
+#endif /* APP_LCD_RENDER_PARTIAL */
+
 esp_err_t lcd_st7701_register_lvgl(esp_lcd_panel_handle_t panel,
                                    lv_disp_t **out_disp)
 {
     ESP_RETURN_ON_FALSE(panel && out_disp, ESP_ERR_INVALID_ARG, TAG,
                         "NULL argument");
 
-    /* Binary semaphore for VSYNC synchronisation */
-    s_vsync_sem = xSemaphoreCreateBinary();
-    ESP_RETURN_ON_FALSE(s_vsync_sem, ESP_ERR_NO_MEM, TAG,
-                        "vsync semaphore alloc failed");
-
-    esp_lcd_rgb_panel_event_callbacks_t cbs = { .on_vsync = on_vsync };
-    ESP_RETURN_ON_ERROR(
-        esp_lcd_rgb_panel_register_event_callbacks(panel, &cbs, NULL),
-        TAG, "register vsync callback failed");
-
-    /* Obtain the two PSRAM framebuffer addresses (zero-copy) */
-    void *fb0 = NULL;
-    void *fb1 = NULL;
-    ESP_RETURN_ON_ERROR(
-        esp_lcd_rgb_panel_get_frame_buffer(panel, 2, &fb0, &fb1),
-        TAG, "get frame buffer failed");
-
-    /* LVGL draw buffer pair — points straight at the PSRAM framebuffers */
     static lv_disp_draw_buf_t draw_buf;
-    lv_disp_draw_buf_init(&draw_buf, fb0, fb1,
-                          APP_LCD_H_RES * APP_LCD_V_RES);
+    ESP_RETURN_ON_ERROR(init_draw_buf(&draw_buf), TAG, "draw buffer init failed");
+
+    s_render.partial  = APP_LCD_RENDER_PARTIAL;
+    s_render.fb_bytes = lcd_scanout_get_fb_count()
+                        * lcd_scanout_get_fb_bytes();
 
     /* LVGL display driver */
     static lv_disp_drv_t disp_drv;
@@ -456,15 +573,30 @@ esp_err_t lcd_st7701_register_lvgl(esp_lcd_panel_handle_t panel,
     disp_drv.hor_res     = APP_LCD_H_RES;
     disp_drv.ver_res     = APP_LCD_V_RES;
     disp_drv.flush_cb    = lvgl_flush_cb;
+    disp_drv.monitor_cb  = lvgl_monitor_cb;
     disp_drv.draw_buf    = &draw_buf;
     disp_drv.user_data   = panel;
+#if APP_LCD_RENDER_PARTIAL
+    disp_drv.rounder_cb  = lvgl_rounder_cb;
+#else
     disp_drv.direct_mode = true;
+#endif
 
     lv_disp_t *disp = lv_disp_drv_register(&disp_drv);
     ESP_RETURN_ON_FALSE(disp, ESP_FAIL, TAG, "lv_disp_drv_register failed");
 
-    ESP_LOGI(TAG, "LVGL display registered (direct mode, double-buffered)");
+    ESP_LOGI(TAG, "LVGL display registered (%s, SRAM %u B, PSRAM FB %u KB)",
+             APP_LCD_FB_INDEXED     ? "partial mode, RGB332 indexed FB"
+             : APP_LCD_RENDER_PARTIAL ? "partial mode, SRAM strips → GDMA"
+                                    : "direct mode, double-buffered",
+             (unsigned)s_render.sram_bytes,
+             (unsigned)(s_render.fb_bytes / 1024));
 
     *out_disp = disp;
     return ESP_OK;
 }
+
+void lcd_st7701_get_render_stats(lcd_render_stats_t *out)
+{
+    *out = s_render;
+}
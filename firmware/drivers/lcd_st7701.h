@@ -4,19 +4,54 @@
 #include "esp_lcd_panel_ops.h"
 #include "lvgl.h"
 
+/** Render-path counters (monotonic since registration). */
+typedef struct {
+    bool     partial;       /* APP_LCD_RENDER_PARTIAL build              */
+    uint32_t refreshes;     /* LVGL refresh cycles that drew something   */
+    uint64_t render_ms;     /* summed LVGL render time                   */
+    uint32_t last_render_ms;    /* duration of the latest refresh        */
+    int64_t  last_render_at_us; /* esp_timer time of the latest refresh  */
+    uint64_t render_px;     /* summed rendered pixels                    */
+    uint64_t flush_bytes;   /* partial: bytes DMA-copied SRAM → PSRAM    */
+    size_t   sram_bytes;    /* internal SRAM held by LVGL draw buffers   */
+    size_t   fb_bytes;      /* PSRAM held by scan-out framebuffers       */
+} lcd_render_stats_t;
+
 /**
  * Initialise the ST7701 RGB LCD panel.
  *
  * Sends the ST7701S register init sequence over 3-wire SPI, then
- * creates an ESP-IDF RGB panel with double PSRAM-backed framebuffers.
+ * creates an ESP-IDF RGB panel fed from the lcd_scanout framebuffers
+ * and starts the burn-in protection orbit.
  */
 esp_err_t lcd_st7701_init(esp_lcd_panel_handle_t *out_panel);
 
 /**
  * Register the panel with LVGL.
  *
- * Uses the panel's PSRAM framebuffers directly (zero-copy, direct mode)
- * and synchronises flushes to VSYNC for tear-free output.
+ * Direct mode (default): uses the PSRAM framebuffers directly (zero-copy)
+ * and synchronises flushes to the scan-out frame boundary for tear-free
+ * output.  Partial mode (APP_LCD_RENDER_PARTIAL): renders into two small
+ * internal-SRAM strips, pushed into a single framebuffer by GDMA.
  */
 esp_err_t lcd_st7701_register_lvgl(esp_lcd_panel_handle_t panel,
                                    lv_disp_t **out_disp);
+
+/**
+ * Put the panel into its deepest idle state: backlight off, display off,
+ * ST7701S sleep-in, scan-out blanked (no PSRAM reads) and PCLK dropped
+ * to SLEEP_PCLK_HZ (lcd_st7701.c).  Blocks ~140 ms for the controller delays.
+ */
+esp_err_t lcd_st7701_sleep(esp_lcd_panel_handle_t panel);
+
+/**
+ * Undo lcd_st7701_sleep(): restore PCLK and scan-out, sleep-out and
+ * display on.  The backlight is left to the caller (brightness policy).
+ * Blocks ~140 ms, dominated by the ST7701S sleep-out time.
+ */
+esp_err_t lcd_st7701_wake(esp_lcd_panel_handle_t panel);
+
+/**
+ * Copy the render-path counters into @p out (for benchmarks / diagnostics).
+ */
+void lcd_st7701_get_render_stats(lcd_render_stats_t *out);
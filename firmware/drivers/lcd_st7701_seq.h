@@ -0,0 +1,95 @@
+#pragma once
+
+/*
+ * ST7701S command tables for lcd_st7701.c.
+ *
+ * Same byte stream as the original hardware-verified inline sequence,
+ * expressed as tables: command, data bytes, delay after (ms).  Data only,
+ * no ESP-IDF headers, so test/host/test_st7701_seq.c checks it against
+ * the golden stream in test/host/st7701_init.golden.
+ */
+
+#include <stdint.h>
+
+typedef struct {
+    uint8_t  cmd;
+    uint8_t  len;
+    uint16_t delay_ms;
+    uint8_t  data[16];
+} st7701_cmd_t;
+
+static const st7701_cmd_t ST7701_INIT[] = {
+    /* Software reset */
+    { 0x01, 0, 120, { 0 } },
+
+    /* ---- Command2 BK0 (timing + gamma) ---- */
+    { 0xFF, 5, 0, { 0x77, 0x01, 0x00, 0x00, 0x10 } },
+    { 0xC0, 2, 0, { 0x3B, 0x00 } },
+    { 0xC1, 2, 0, { 0x0D, 0x02 } },
+    { 0xC2, 2, 0, { 0x31, 0x05 } },
+    { 0xCD, 1, 0, { 0x00 } },
+
+    /* Positive gamma (16 bytes) */
+    { 0xB0, 16, 0, { 0x00, 0x11, 0x18, 0x0E, 0x11, 0x06, 0x07, 0x08,
+                     0x07, 0x22, 0x04, 0x12, 0x0F, 0xAA, 0x31, 0x18 } },
+
+    /* Negative gamma (16 bytes) */
+    { 0xB1, 16, 0, { 0x00, 0x11, 0x19, 0x0E, 0x12, 0x07, 0x08, 0x08,
+                     0x08, 0x22, 0x04, 0x11, 0x11, 0xA9, 0x32, 0x18 } },
+
+    /* ---- Command2 BK1 (voltage) ---- */
+    { 0xFF, 5, 0, { 0x77, 0x01, 0x00, 0x00, 0x11 } },
+    { 0xB0, 1, 0, { 0x60 } },
+    { 0xB1, 1, 0, { 0x32 } },
+    { 0xB2, 1, 0, { 0x07 } },
+    { 0xB3, 1, 0, { 0x80 } },
+    { 0xB5, 1, 0, { 0x49 } },
+    { 0xB7, 1, 0, { 0x85 } },
+    { 0xB8, 1, 0, { 0x21 } },
+    { 0xC1, 1, 0, { 0x78 } },
+    { 0xC2, 1, 0, { 0x78 } },
+    { 0xD0, 1, 100, { 0x88 } },
+
+    /* ---- Gate EQ / Source EQ ---- */
+    { 0xE0, 3, 0, { 0x00, 0x1B, 0x02 } },
+    { 0xE1, 11, 0, { 0x08, 0xA0, 0x00, 0x00, 0x07, 0xA0, 0x00, 0x00,
+                     0x00, 0x44, 0x44 } },
+    { 0xE2, 12, 0, { 0x11, 0x11, 0x44, 0x44, 0xED, 0xA0, 0x00, 0x00,
+                     0xEC, 0xA0, 0x00, 0x00 } },
+    { 0xE3, 4, 0, { 0x00, 0x00, 0x11, 0x11 } },
+    { 0xE4, 2, 0, { 0x44, 0x44 } },
+    { 0xE5, 16, 0, { 0x0A, 0xE9, 0xD8, 0xA0, 0x0C, 0xEB, 0xD8, 0xA0,
+                     0x0E, 0xED, 0xD8, 0xA0, 0x10, 0xEF, 0xD8, 0xA0 } },
+    { 0xE6, 4, 0, { 0x00, 0x00, 0x11, 0x11 } },
+    { 0xE7, 2, 0, { 0x44, 0x44 } },
+    { 0xE8, 16, 0, { 0x09, 0xE8, 0xD8, 0xA0, 0x0B, 0xEA, 0xD8, 0xA0,
+                     0x0D, 0xEC, 0xD8, 0xA0, 0x0F, 0xEE, 0xD8, 0xA0 } },
+    { 0xEB, 7, 0, { 0x02, 0x00, 0xE4, 0xE4, 0x88, 0x00, 0x40 } },
+    { 0xEC, 2, 0, { 0x3C, 0x00 } },
+    { 0xED, 16, 0, { 0xAB, 0x89, 0x76, 0x54, 0x02, 0xFF, 0xFF, 0xFF,
+                     0xFF, 0xFF, 0xFF, 0x20, 0x45, 0x67, 0x98, 0xBA } },
+
+    /* ---- Command2 BK3 – VCOM calibration ---- */
+    { 0xFF, 5, 0, { 0x77, 0x01, 0x00, 0x00, 0x13 } },
+    { 0xE5, 1, 0, { 0xE4 } },
+
+    /* ---- Exit Command2 ---- */
+    { 0xFF, 5, 0, { 0x77, 0x01, 0x00, 0x00, 0x00 } },
+
+    /* ---- Standard commands ---- */
+    { 0x20, 0, 0,   { 0 } },                    /* INVOFF */
+    { 0x3A, 1, 0,   { 0x50 } },                 /* COLMOD: 16-bit RGB interface */
+    { 0x11, 0, 120, { 0 } },                    /* Sleep Out */
+    { 0x29, 0, 20,  { 0 } },                    /* Display ON */
+};
+
+/* Panel sleep / wake – the controller needs 120 ms after SLPIN / SLPOUT. */
+static const st7701_cmd_t ST7701_SLEEP_IN[] = {
+    { 0x28, 0, 20,  { 0 } },                    /* Display OFF */
+    { 0x10, 0, 120, { 0 } },                    /* Sleep In */
+};
+
+static const st7701_cmd_t ST7701_SLEEP_OUT[] = {
+    { 0x11, 0, 120, { 0 } },                    /* Sleep Out */
+    { 0x29, 0, 20,  { 0 } },                    /* Display ON */
+};
@@ -8,6 +8,9 @@
  * Diagnostic layers:
  *   Layer A – raw I2C touch data (logged on every touch event)
  *   Layer B – LVGL indev read_cb state (logged on every touch event)
+ *
+ * QEMU builds (CONFIG_APP_QEMU) have no controller: init only logs, the
+ * indev always reads "released" and nothing is ever touched.
  */
 
 #include "touch_gt911.h"
@@ -15,6 +18,7 @@
 
 #include "driver/i2c_master.h"
 #include "esp_log.h"
+#include "sdkconfig.h"
 
 #include <string.h>
 
@@ -36,6 +40,7 @@ static lv_indev_t             *s_indev;
 
 static esp_err_t gt911_read_reg(uint16_t reg, uint8_t *buf, size_t len)
 {
+    if (!s_dev) return ESP_ERR_INVALID_STATE;
     uint8_t addr[2] = { (uint8_t)(reg >> 8), (uint8_t)(reg & 0xFF) };
     return i2c_master_transmit_receive(s_dev, addr, sizeof(addr),
                                        buf, len, 50);
@@ -45,6 +50,7 @@ static esp_err_t gt911_write_reg(uint16_t reg, const uint8_t *data, size_t len)
 {
     uint8_t buf[2 + 8];   /* max write: 2-byte addr + up to 8 data bytes */
     if (len > 8) return ESP_ERR_INVALID_SIZE;
+    if (!s_dev)  return ESP_ERR_INVALID_STATE;
     buf[0] = (uint8_t)(reg >> 8);
     buf[1] = (uint8_t)(reg & 0xFF);
     memcpy(&buf[2], data, len);
@@ -114,6 +120,10 @@ static void gt911_lvgl_read_cb(lv_indev_drv_t *drv, lv_indev_data_t *data)
 
 esp_err_t touch_gt911_init(void)
 {
+#if CONFIG_APP_QEMU
+    ESP_LOGW(TAG, "QEMU: no GT911, touch always released");
+    return ESP_OK;
+#endif
     ESP_LOGI(TAG, "Initialising GT911 (SDA=%d SCL=%d addr=0x%02X)",
              APP_TOUCH_I2C_SDA, APP_TOUCH_I2C_SCL, APP_TOUCH_GT911_ADDR);
 
@@ -194,3 +204,22 @@ esp_err_t touch_gt911_register_lvgl(void)
     ESP_LOGI(TAG, "LVGL pointer indev registered");
     return ESP_OK;
 }
+
+bool touch_gt911_is_touched(void)
+{
+    uint8_t status = 0;
+    if (gt911_read_reg(GT911_REG_STATUS, &status, 1) != ESP_OK) {
+        return false;
+    }
+    if (status & 0x80) {
+        gt911_clear_status();
+    }
+    return (status & 0x80) && (status & 0x0F) > 0;
+}
+
+void touch_gt911_set_lvgl_enabled(bool enabled)
+{
+    if (s_indev) {
+        lv_indev_enable(s_indev, enabled);
+    }
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stdbool.h>
 #include "esp_err.h"
 #include "lvgl.h"
 
@@ -14,3 +15,15 @@ esp_err_t touch_gt911_init(void);
  * Must be called after lv_init() and after touch_gt911_init().
  */
 esp_err_t touch_gt911_register_lvgl(void);
+
+/**
+ * Poll the controller directly (bypassing LVGL) and return true if a
+ * finger is down.  Clears the GT911 status register.
+ */
+bool touch_gt911_is_touched(void);
+
+/**
+ * Enable / disable the LVGL input device.  While disabled LVGL stops
+ * polling I2C entirely and no touch reaches the UI.
+ */
+void touch_gt911_set_lvgl_enabled(bool enabled);
@@ -5,9 +5,121 @@
 #define APP_WIFI_MAX_RETRY      10
 
 /* ── MQTT topics ──────────────────────────── */
-#define APP_MQTT_TOPIC_QR_SHOW  "pos/qr/show"
-#define APP_MQTT_TOPIC_QR_HIDE  "pos/qr/hide"
-#define APP_MQTT_TOPIC_RESULT   "pos/qr/result"
+/* QR command topics are <prefix><suffix>; the prefix can be changed at
+   runtime ("topic_prefix", services/config_service.h) */
+#define APP_MQTT_TOPIC_PREFIX   "pos"
+#define APP_MQTT_CMD_QR_SHOW    "/qr/show"
+#define APP_MQTT_CMD_QR_HIDE    "/qr/hide"
+#define APP_MQTT_CMD_RESULT     "/qr/result"
+/* Same commands, compact TLV body (services/pos_bin.h) */
+#define APP_MQTT_CMD_QR_SHOW_BIN    "/qr/show/bin"
+#define APP_MQTT_CMD_QR_HIDE_BIN    "/qr/hide/bin"
+#define APP_MQTT_CMD_RESULT_BIN     "/qr/result/bin"
+#define APP_MQTT_TOPIC_BENCH_RUN    "pos/bench/run"
+#define APP_MQTT_TOPIC_BENCH_RESULT "pos/bench/result"
+#define APP_MQTT_TOPIC_SLEEP    "pos/display/sleep"   /* {"sleep":bool} */
+#define APP_MQTT_TOPIC_DIAG     "pos/display/diag"    /* {"on":bool}    */
+/* LVGL object / style inventory (ui/lv_inventory.c): any message on GET */
+#define APP_MQTT_TOPIC_LVGL_GET     "pos/display/lvgl/get"
+#define APP_MQTT_TOPIC_LVGL_DATA    "pos/display/lvgl/data"
+#define APP_LVGL_INV_BYTES          2048    /* JSON report buffer        */
+#define APP_LVGL_POOL_WARN_PCT      85      /* LV_MEM_SIZE budget        */
+
+/* Extra command topics other services may register */
+#define APP_MQTT_MAX_HANDLERS   8
+
+/* RX/TX buffer: a version-40 QR string (2953 B) plus JSON fits unfragmented */
+#define APP_MQTT_BUFFER_SIZE    4096
+
+/* MQTT 5 (CONFIG_MQTT_PROTOCOL_5): topic aliases accepted from / used
+   towards the broker */
+#define APP_MQTT_TOPIC_ALIAS_MAX    8
+
+/* Broker failover: APP_MQTT_URI, optional APP_MQTT_URI_BACKUP and
+   APP_MQTT_URI_LAN in secrets/secrets.h, tried in that order */
+#define APP_MQTT_TOPIC_PROBE        "pos/display/probe"   /* QoS 1 RTT probe */
+#define APP_MQTT_TOPIC_BROKER       "pos/display/broker"  /* switch events  */
+#define APP_MQTT_FAILOVER_ATTEMPTS  3       /* failed connects → next broker */
+#define APP_MQTT_PROBE_PERIOD_S     15
+#define APP_MQTT_RTT_DEGRADED_MS    1000    /* smoothed, 3 probes in a row */
+#define APP_MQTT_FAILBACK_S         600     /* on a fallback: probe primary */
+#define APP_MQTT_RECONNECT_MS       2000
+
+/* Presence: retained "online"/"offline" (last will) + QoS 0 heartbeat */
+#define APP_MQTT_TOPIC_STATUS       "pos/display/status"
+#define APP_MQTT_TOPIC_HEARTBEAT    "pos/display/heartbeat"
+#define APP_MQTT_KEEPALIVE_S        10      /* will fires ~15 s after loss */
+#define APP_HEARTBEAT_PERIOD_S      5
+#define APP_PRESENCE_TASK_STACK     (4 * 1024)
+#define APP_PRESENCE_TASK_PRIO      1
+
+/* HMAC command envelope (services/cmd_auth.h): with APP_CMD_HMAC_KEY in
+   secrets/secrets.h every command must be signed, unsigned ones are
+   dropped */
+
+/* A show command whose "ts" is older than this is dropped (needs SNTP) */
+#define APP_QR_SHOW_MAX_AGE_S       120
+
+/* After a reboot with a restored QR: time allowed after the subscriptions
+   are acknowledged for the broker's retained show / hide to arrive */
+#define APP_QR_RECONCILE_MS         3000
+
+/* ── Runtime configuration (services/config_service.c) ── */
+/* JSON change sets on TOPIC_CONFIG, acknowledged on TOPIC_CONFIG_ACK;
+   the values below are the defaults until one has been applied */
+#define APP_MQTT_TOPIC_CONFIG       "pos/display/config"
+#define APP_MQTT_TOPIC_CONFIG_ACK   "pos/display/config/ack"
+#define APP_TZ                      "ICT-7"     /* POSIX TZ, UTC+7 no DST */
+#define APP_QUOTE_ROTATE_S          10
+#define APP_VIETQR_BIN              "970422"    /* MB Bank               */
+#define APP_VIETQR_ACCOUNT          "0973202625"
+#define APP_VIETQR_NOTE             "Thanh toan tai quay"
+#define APP_VIETQR_NAME             "NGUYEN THI NHI - MB Bank"
+
+/* ── Outbox (services/outbox_service.c) ──── */
+#define APP_OUTBOX_RAM_BYTES        (16 * 1024) /* PSRAM ring            */
+#define APP_OUTBOX_SPILL_PCT        75      /* ring fill → spill to flash */
+#define APP_OUTBOX_BATCH_BYTES      2048    /* coalesced publish body    */
+#define APP_OUTBOX_MQTT_HIGH_BYTES  (8 * 1024)  /* client outbox ceiling */
+#define APP_OUTBOX_POLL_MS          500
+#define APP_OUTBOX_TASK_STACK       (4 * 1024)
+#define APP_OUTBOX_TASK_PRIO        1
+
+/* ── Journal (services/journal_service.c) ── */
+#define APP_MQTT_TOPIC_JOURNAL_GET  "pos/display/journal/get"   /* range */
+#define APP_MQTT_TOPIC_JOURNAL_DATA "pos/display/journal/data"
+#define APP_JOURNAL_FLUSH_MS        2000    /* partial page written after */
+#define APP_JOURNAL_QUERY_MAX       1000    /* records per query default  */
+#define APP_JOURNAL_STREAM_BYTES    2048    /* per publish                */
+#define APP_JOURNAL_TASK_STACK      (4 * 1024)
+#define APP_JOURNAL_TASK_PRIO       1
+
+/* ── Event bus (services/event_bus.c) ────── */
+#define APP_EVENT_SUB_MAX           6
+#define APP_EVENT_QUEUE_LEN         16      /* per subscriber, power of 2 */
+
+/* ── Flash writes (services/flash_sched.c) ── */
+#define APP_FLASH_QUIET_MS          1500    /* no writes after QR show/hide */
+#define APP_FLASH_DEFER_MAX_MS      10000   /* QR up: held at most, then  */
+                                            /* run on a frame boundary    */
+#define APP_FLASH_POLL_MS           50
+#define APP_FLASH_STALL_WARN_US     20000   /* logged above this          */
+#define APP_FLASH_TASK_STACK        (4 * 1024)
+#define APP_FLASH_TASK_PRIO         1
+
+/* ── Screen mirror (services/screen_mirror.c) ── */
+#define APP_MQTT_TOPIC_MIRROR       "pos/display/mirror"  /* {"on":bool,"fps":n} */
+#define APP_MQTT_TOPIC_MIRROR_DATA  "pos/display/mirror/data"
+#define APP_MQTT_TOPIC_MIRROR_STATE "pos/display/mirror/state"
+#define APP_MIRROR_FPS_DEFAULT      2
+#define APP_MIRROR_FPS_MAX          5
+#define APP_MIRROR_CPU_US           8000    /* scan + encode per frame    */
+#define APP_MIRROR_BYTES_PER_S      (48 * 1024) /* airtime, token bucket  */
+#define APP_MIRROR_MSG_BYTES        4096    /* per publish                */
+#define APP_MIRROR_MAX_S            600     /* session ends by itself     */
+#define APP_MIRROR_STOP_ON_QR       1       /* never stream a payment QR  */
+#define APP_MIRROR_TASK_STACK       (4 * 1024)
+#define APP_MIRROR_TASK_PRIO        1
 
 /* ── Touch (GT911 over I2C) ──────────────── */
 #define APP_TOUCH_I2C_SDA       19
@@ -19,6 +131,55 @@
 #define APP_LCD_H_RES           480
 #define APP_LCD_V_RES           480
 
+/* Render mode: 0 = direct (LVGL draws into 2× PSRAM framebuffers),
+   1 = partial (2× internal-SRAM strips, GDMA copy into 1× PSRAM FB). */
+#define APP_LCD_RENDER_PARTIAL  0
+#define APP_LCD_PARTIAL_LINES   16      /* 15 KB SRAM per strip          */
+/* 8 = one 8-bit RGB332 framebuffer (230 KB) expanded to RGB565 in the
+   bounce refill, halving PSRAM scan-out traffic; needs partial mode.
+   0 = RGB565 framebuffer(s). */
+#define APP_LCD_FB_INDEXED      0
+/* 1 = while a QR is shown, its rows are scanned out from a 1-bpp tile in
+   SRAM (2× ~10 KB) instead of the framebuffer. */
+#define APP_LCD_COMPOSE_QR      1
+
+/* ── QR rendering ─────────────────────────── */
+/* 1 = keep the on-screen mask pattern while the QR version is unchanged,
+   so a new amount repaints only the modules that really differ. */
+#define APP_QR_PIN_MASK         1
+
+/* ── Backlight (LEDC PWM, perceptual %) ────── */
+#define APP_BL_BOOT_PCT         70
+#define APP_BL_QR_PCT           100     /* QR / result: instant jump     */
+#define APP_BL_IDLE_DAY_PCT     70
+#define APP_BL_IDLE_NIGHT_PCT   30
+#define APP_BL_IDLE_DIM_PCT     15      /* screensaver after inactivity  */
+#define APP_BL_IDLE_DIM_AFTER_S 300
+#define APP_BL_NIGHT_START_H    20      /* local hour, inclusive         */
+#define APP_BL_NIGHT_END_H      7       /* local hour, exclusive         */
+#define APP_BL_FADE_MS          800
+
+/* ── Deep idle (panel sleep) ──────────────── */
+#define APP_SHOP_OPEN_H             7       /* local hour, inclusive     */
+#define APP_SHOP_CLOSE_H            22      /* local hour, exclusive     */
+#define APP_DEEP_IDLE_AFTER_S       120     /* no touch before sleeping  */
+#define APP_DEEP_IDLE_CPU_MHZ       80
+#define APP_DEEP_IDLE_TOUCH_POLL_MS 200
+#define APP_DEEP_IDLE_LOOP_MS       20      /* wake poll while asleep;   */
+                                            /* EV_QR_SHOW cuts it short  */
+#define APP_DEEP_IDLE_WAKE_BUDGET_MS 250    /* trigger → first QR frame  */
+
+/* ── Burn-in protection (scan-out pixel shift) ─ */
+/* Whole image orbits within ±MAX px, one pixel per period. 0 = off. */
+#define APP_BURNIN_SHIFT_MAX_PX     3
+#define APP_BURNIN_SHIFT_PERIOD_S   60
+
+/* ── QEMU target (sdkconfig.qemu, CONFIG_APP_QEMU) ── */
+/* Panel, backlight and touch stubbed; network through QEMU's open-eth
+   with user-mode NAT, where the host is 10.0.2.2. */
+#define APP_QEMU_MQTT_URI           "mqtt://10.0.2.2:1883"
+#define APP_QEMU_FRAME_US           16667   /* virtual panel frame clock  */
+
 /* ── LVGL task ────────────────────────────── */
 #define APP_LVGL_TICK_MS        1
 #define APP_LVGL_TASK_STACK     (6 * 1024)
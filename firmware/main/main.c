@@ -1,7 +1,7 @@
 /*
  * POS QR Display – main
  *
- * Initialises LCD + LVGL, starts MQTT, and polls for QR data.
+ * Initialises LCD + LVGL, starts MQTT, and follows its QR events.
  * WiFi must be initialised before mqtt_service_init() – add when ready.
  */
 
@@ -11,21 +11,78 @@
 #include "esp_log.h"
 #include "esp_err.h"
 #include "esp_timer.h"
+#include "esp_heap_caps.h"
 #include "esp_lcd_panel_ops.h"
 #include "esp_lcd_panel_rgb.h"
 #include "lvgl.h"
 
+#include <stdio.h>
+
 #include "app_config.h"
+#include "config_service.h"
+#include "event_bus.h"
+#include "flash_sched.h"
+#include "journal_service.h"
 #include "lcd_st7701.h"
 #include "touch_gt911.h"
 #include "wifi_service.h"
 #include "time_service.h"
 #include "mqtt_service.h"
+#include "outbox_service.h"
+#include "presence_service.h"
+#include "screen_mirror.h"
+#include "bench_service.h"
+#include "brightness_service.h"
+#include "power_service.h"
+#include "compose_service.h"
 #include "ui.h"
 #include "qr_screen.h"
+#include "diag_overlay.h"
 
 static const char *TAG = "main";
 
+/* ── Boot timing ──────────────────────────────────────────────────────── */
+
+/* One console line once app_main is done, per stage in ms, e.g.
+     Boot ms: config 35, lcd 140, lvgl 6, ui 210, net 12, services 9 –
+     app_main 412, entered at 298
+   and the heap left afterwards; tools/qemu_run.py reads both. */
+#define BOOT_MARKS_MAX  8
+
+static struct {
+    const char *stage;
+    int64_t     us;
+} s_boot[BOOT_MARKS_MAX];
+static int s_boot_n;
+
+static void boot_mark(const char *stage)
+{
+    if (s_boot_n == BOOT_MARKS_MAX) return;
+    s_boot[s_boot_n].stage = stage;
+    s_boot[s_boot_n].us    = esp_timer_get_time();
+    s_boot_n++;
+}
+
+static void boot_report(void)
+{
+    char line[160];
+    int  n = 0;
+    for (int i = 1; i < s_boot_n && n < (int)sizeof(line); i++) {
+        n += snprintf(line + n, sizeof(line) - n, "%s%s %lu", i > 1 ? ", " : "",
+                      s_boot[i].stage,
+                      (unsigned long)((s_boot[i].us - s_boot[i - 1].us)
+                                      / 1000));
+    }
+    ESP_LOGI(TAG, "Boot ms: %s – app_main %lu, entered at %lu", line,
+             (unsigned long)((s_boot[s_boot_n - 1].us - s_boot[0].us) / 1000),
+             (unsigned long)(s_boot[0].us / 1000));
+    ESP_LOGI(TAG, "Boot heap: internal %u K free (min %u K), PSRAM %u K free",
+             (unsigned)(heap_caps_get_free_size(MALLOC_CAP_INTERNAL) / 1024),
+             (unsigned)(heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL)
+                        / 1024),
+             (unsigned)(heap_caps_get_free_size(MALLOC_CAP_SPIRAM) / 1024));
+}
+
 /* ── LVGL tick source (1 ms periodic timer) ───────────────────────────── */
 
 static void lvgl_tick_cb(void *arg)
@@ -34,19 +91,48 @@ static void lvgl_tick_cb(void *arg)
     lv_tick_inc(APP_LVGL_TICK_MS);
 }
 
-/* ── LVGL handler task + MQTT→UI polling ──────────────────────────────── */
+/* ── LVGL handler task + MQTT→UI events ───────────────────────────────── */
 
 static void lvgl_task(void *arg)
 {
     (void)arg;
     ESP_LOGI(TAG, "LVGL task running");
 
+    /* QR state follows EV_QR_SHOW / EV_QR_HIDE, which also wake the
+       loop; seeded after subscribing, so a QR restored at boot counts */
+    event_sub_t sub = event_bus_subscribe(EV_BIT(EV_QR_SHOW) |
+                                          EV_BIT(EV_QR_HIDE),
+                                          xTaskGetCurrentTaskHandle());
+    bool     has_qr      = mqtt_service_has_qr_data();
+    uint32_t qr_gen      = mqtt_service_get_qr_gen();
     bool     showing_qr  = false;
+    bool     was_visible = false;
     uint32_t last_qr_gen = 0;
+    int64_t  show_t_us   = 0;       /* EV_QR_SHOW awaiting its first frame */
 
     for (;;) {
-        bool     has_qr = mqtt_service_has_qr_data();
-        uint32_t qr_gen = mqtt_service_get_qr_gen();
+        event_t ev;
+        while (event_bus_get(sub, &ev)) {
+            if (ev.type == EV_QR_SHOW) {
+                has_qr    = true;
+                qr_gen    = ev.arg;
+                show_t_us = ev.t_us;
+            } else if (ev.type == EV_QR_HIDE) {
+                has_qr = false;
+            } else {                            /* EV_OVERFLOW */
+                has_qr = mqtt_service_has_qr_data();
+                qr_gen = mqtt_service_get_qr_gen();
+            }
+        }
+
+        /* Deep idle: panel asleep, only wake triggers are checked */
+        bool qr_wanted = has_qr &&
+                         (qr_gen != last_qr_gen || !qr_screen_is_dismissed());
+        if (power_service_poll(qr_wanted)) {
+            flash_sched_set_qr_visible(false);
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(APP_DEEP_IDLE_LOOP_MS));
+            continue;
+        }
 
         if (!has_qr) {
             /* MQTT says no QR data → ensure idle screen, reset dismiss */
@@ -70,8 +156,28 @@ static void lvgl_task(void *arg)
             }
         }
 
+        /* Dismiss taps and wake-ups switch screens too: no flash writes
+           while that animates */
+        bool qr_visible = qr_screen_is_visible();
+        if (qr_visible != was_visible) flash_sched_note_transition();
+        was_visible = qr_visible;
+        flash_sched_set_qr_visible(qr_visible);
+
+        compose_service_update();
+        brightness_service_update(qr_visible
+                                  ? UI_STATE_QR_DISPLAY : UI_STATE_IDLE);
+        bench_service_poll();
+
         lv_timer_handler();
-        vTaskDelay(pdMS_TO_TICKS(10));
+        if (show_t_us) {
+            lcd_render_stats_t r;
+            lcd_st7701_get_render_stats(&r);
+            if (r.last_render_at_us > show_t_us) {
+                diag_overlay_set_show_latency(r.last_render_at_us - show_t_us);
+                show_t_us = 0;
+            }
+        }
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10));
     }
 }
 
@@ -80,6 +186,14 @@ static void lvgl_task(void *arg)
 void app_main(void)
 {
     ESP_LOGI(TAG, "=== POS QR Display ===");
+    boot_mark("start");
+
+    /* 0. Load the runtime configuration (NVS) – read by UI and services;
+          start the flash-write scheduler, open the transaction journal */
+    ESP_ERROR_CHECK(config_service_init());
+    ESP_ERROR_CHECK(flash_sched_init());
+    ESP_ERROR_CHECK(journal_service_init());
+    boot_mark("config");
 
     /* 1. Initialise LVGL library */
     lv_init();
@@ -98,8 +212,10 @@ void app_main(void)
     esp_lcd_panel_handle_t panel = NULL;
     ESP_ERROR_CHECK(lcd_st7701_init(&panel));
     ESP_LOGI(TAG, "LCD panel initialised");
+    boot_mark("lcd");
 
-    /* 4. Register panel with LVGL (direct mode, PSRAM double buffer) */
+    /* 4. Register panel with LVGL (render mode per APP_LCD_RENDER_PARTIAL /
+          APP_LCD_FB_INDEXED in app_config.h) */
     lv_disp_t *disp = NULL;
     ESP_ERROR_CHECK(lcd_st7701_register_lvgl(panel, &disp));
     ESP_LOGI(TAG, "LVGL display registered");
@@ -108,6 +224,7 @@ void app_main(void)
     ESP_ERROR_CHECK(touch_gt911_init());
     ESP_ERROR_CHECK(touch_gt911_register_lvgl());
     ESP_LOGI(TAG, "Touch initialised");
+    boot_mark("lvgl");
 
     /* 6. Create glassmorphism idle screen and make it active */
     ui_init(disp);
@@ -115,18 +232,36 @@ void app_main(void)
     /* 7. Create QR screen (captures the active screen as its idle target) */
     qr_screen_init(disp);
 
+    /* 7a. Staff diagnostics strip on the top layer (hidden) */
+    ESP_ERROR_CHECK(diag_overlay_init(disp));
+
+    /* 7b. Bring back a QR that was up before a reset / brown-out; the UI
+           loop shows it before WiFi or MQTT are up */
+    mqtt_service_restore_qr();
+    boot_mark("ui");
+
     /* 8. Initialise WiFi (NVS + STA, non-blocking) */
     wifi_service_init();
 
     /* 9. Start SNTP (retries in background until WiFi connects) */
     time_service_init();
+    boot_mark("net");
 
-    /* 10. Start MQTT service */
+    /* 10. Register extra MQTT command topics, then start MQTT service */
+    ESP_ERROR_CHECK(config_service_register());
+    ESP_ERROR_CHECK(journal_service_register());
+    ESP_ERROR_CHECK(bench_service_init());
+    ESP_ERROR_CHECK(power_service_init(panel));
+    ESP_ERROR_CHECK(outbox_service_init());
+    ESP_ERROR_CHECK(presence_service_init());
+    ESP_ERROR_CHECK(screen_mirror_init());
     ESP_ERROR_CHECK(mqtt_service_init());
 
-    /* 11. Start LVGL handler task (includes MQTT→UI polling) */
+    /* 11. Start LVGL handler task (includes MQTT→UI events) */
     xTaskCreate(lvgl_task, "lvgl", APP_LVGL_TASK_STACK, NULL,
                 APP_LVGL_TASK_PRIO, NULL);
 
+    boot_mark("services");
     ESP_LOGI(TAG, "System running");
+    boot_report();
 }
@@ -0,0 +1,509 @@
+/*
+ * On-device benchmark suite – triggered over MQTT, run in the LVGL task.
+ *
+ * Measures what actually limits this board in production:
+ *   - PSRAM read / write / copy bandwidth (octal, CONFIG_SPIRAM_SPEED)
+ *   - pos/qr/show decode: JSON vs binary TLV, bytes and time, and the
+ *     HMAC check of a maximum-size payload
+ *   - RGB565 fill and 50 % blend rates into PSRAM and internal SRAM
+ *   - Scan-out line cost: RGB565 copy vs RGB332 LUT expansion (+ dither)
+ *   - LVGL draw primitives on an off-screen canvas
+ *   - QR encode + render time for a typical dynamic VietQR: lv_qrcode
+ *     vs the incremental renderer on an amount edit (changed-module %),
+ *     and 1000 / 2000 / 2953-byte payloads up to version 40
+ *   - Full redraw of the current (idle) scene through the configured
+ *     render path (direct vs partial mode), plus the live render counters
+ *   - QR layer composition: tile SRAM, framebuffer bytes saved per frame
+ *     and layout switch cost, from the live counters
+ *
+ * The RGB panel keeps scanning out the whole time, so every number
+ * includes contention with the LCD DMA and the bounce-buffer refill.
+ * Buffers are allocated for the run and freed afterwards.
+ *
+ * Request:  pos/bench/run     (payload ignored)
+ * Report:   pos/bench/result  { "status": "ok", ..., "results": { … } }
+ */
+
+#include "bench_service.h"
+#include "mqtt_service.h"
+#include "outbox_service.h"
+#include "pos_bin.h"
+#include "cmd_auth.h"
+#include "qr_screen.h"
+#include "qr_render.h"
+#include "lcd_st7701.h"
+#include "lcd_scanout.h"
+#include "compose_service.h"
+#include "app_config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_attr.h"
+#include "sdkconfig.h"
+#include "lvgl.h"
+
+static const char *TAG = "bench";
+
+#define PSRAM_BUF_BYTES     (1024 * 1024)
+#define SRAM_BUF_BYTES      (APP_LCD_H_RES * 20 * sizeof(lv_color_t))
+#define CANVAS_W            240
+#define CANVAS_H            240
+#define DRAW_ITERS          50
+#define QR_ITERS            10
+#define SCENE_ITERS         5
+#define CODEC_ITERS         200
+#define MAX_RESULTS         48
+
+/* Representative dynamic VietQR (amount + order reference). */
+static const char SAMPLE_QR[] =
+    "00020101021238540010A00000072701240006970422011009732026250208QRIBFTTA"
+    "53037045406150000" "5802VN" "62150811ORDER123456" "6304ABCD";
+
+/* Same order after the cashier edited the amount (same QR version). */
+static const char SAMPLE_QR_EDIT[] =
+    "00020101021238540010A00000072701240006970422011009732026250208QRIBFTTA"
+    "53037045406175000" "5802VN" "62150811ORDER123457" "63041F2E";
+
+/* ── Result table ────────────────────────────────────────────────────── */
+
+typedef struct {
+    const char *name;
+    float       value;
+} bench_result_t;
+
+static bench_result_t s_res[MAX_RESULTS];
+static int            s_res_cnt;
+static char           s_report[2560];
+
+static volatile bool  s_requested;
+static uint32_t       s_start_gen;
+
+static void add_result(const char *name, float value)
+{
+    if (s_res_cnt < MAX_RESULTS) {
+        s_res[s_res_cnt].name  = name;
+        s_res[s_res_cnt].value = value;
+        s_res_cnt++;
+    }
+    ESP_LOGI(TAG, "%-24s %10.2f", name, value);
+}
+
+/* bytes per µs == MB/s, pixels per µs == Mpx/s */
+static float per_us(size_t n, int64_t us)
+{
+    return (us > 0) ? (float)n / (float)us : 0.0f;
+}
+
+/* A QR that arrives mid-run must win: abort between cases. */
+static bool qr_pending(void)
+{
+    if (qr_screen_is_visible()) return true;
+    if (!mqtt_service_has_qr_data()) return false;
+    return !qr_screen_is_dismissed() ||
+           mqtt_service_get_qr_gen() != s_start_gen;
+}
+
+/* ── Memory cases ────────────────────────────────────────────────────── */
+
+static void bench_memory(uint8_t *psram, uint8_t *sram)
+{
+    int64_t t;
+
+    t = esp_timer_get_time();
+    memset(psram, 0x5A, PSRAM_BUF_BYTES);
+    add_result("psram_write_MBps",
+               per_us(PSRAM_BUF_BYTES, esp_timer_get_time() - t));
+
+    volatile uint32_t sink = 0;
+    const uint32_t *w = (const uint32_t *)psram;
+    uint32_t acc = 0;
+    t = esp_timer_get_time();
+    for (size_t i = 0; i < PSRAM_BUF_BYTES / 4; i++) acc += w[i];
+    add_result("psram_read_MBps",
+               per_us(PSRAM_BUF_BYTES, esp_timer_get_time() - t));
+    sink = acc;
+    (void)sink;
+
+    t = esp_timer_get_time();
+    memcpy(psram, psram + PSRAM_BUF_BYTES / 2, PSRAM_BUF_BYTES / 2);
+    add_result("psram_copy_MBps",
+               per_us(PSRAM_BUF_BYTES / 2, esp_timer_get_time() - t));
+
+    t = esp_timer_get_time();
+    for (size_t off = 0; off + SRAM_BUF_BYTES <= PSRAM_BUF_BYTES;
+         off += SRAM_BUF_BYTES) {
+        memcpy(psram + off, sram, SRAM_BUF_BYTES);
+    }
+    add_result("sram_to_psram_MBps",
+               per_us(PSRAM_BUF_BYTES / SRAM_BUF_BYTES * SRAM_BUF_BYTES,
+                      esp_timer_get_time() - t));
+}
+
+/* ── Command decode: JSON vs binary TLV ──────────────────────────────── */
+
+static void bench_codec(void)
+{
+    static EXT_RAM_BSS_ATTR qr_payload_t in, out;
+    static char    json[QR_DATA_MAX + 128];
+    static uint8_t bin[QR_DATA_MAX + 16];
+    uint32_t       ts;
+
+    memset(&in, 0, sizeof(in));
+    strcpy(in.data,   SAMPLE_QR);
+    strcpy(in.amount, "150.000");
+    strcpy(in.desc,   "Order 123456");
+
+    int    jlen = snprintf(json, sizeof(json),
+                           "{\"qr_data\":\"%s\",\"amount\":\"%s\","
+                           "\"desc\":\"%s\"}", in.data, in.amount, in.desc);
+    size_t blen = pos_bin_encode_show(&in, bin, sizeof(bin));
+    add_result("show_json_B", (float)jlen);
+    add_result("show_bin_B",  (float)blen);
+
+    int64_t t = esp_timer_get_time();
+    for (int i = 0; i < CODEC_ITERS; i++) {
+        mqtt_service_decode_show_json(json, jlen, &out, &ts);
+    }
+    add_result("decode_json_us",
+               (float)(esp_timer_get_time() - t) / CODEC_ITERS);
+
+    t = esp_timer_get_time();
+    for (int i = 0; i < CODEC_ITERS; i++) {
+        pos_bin_decode_show(bin, blen, &out, &ts);
+    }
+    add_result("decode_bin_us",
+               (float)(esp_timer_get_time() - t) / CODEC_ITERS);
+
+    /* HMAC-SHA256 over a maximum-size QR (hardware SHA) */
+    uint8_t mac[32];
+    memset(in.data, 'A', QR_DATA_MAX - 1);
+    in.data[QR_DATA_MAX - 1] = '\0';
+    if (cmd_auth_mac(1, in.data, QR_DATA_MAX - 1, mac) == ESP_OK) {
+        t = esp_timer_get_time();
+        for (int i = 0; i < CODEC_ITERS; i++) {
+            cmd_auth_mac(i, in.data, QR_DATA_MAX - 1, mac);
+        }
+        add_result("hmac_2953B_us",
+                   (float)(esp_timer_get_time() - t) / CODEC_ITERS);
+    }
+}
+
+/* ── RGB565 pixel cases ──────────────────────────────────────────────── */
+
+static void bench_pixels(lv_color_t *psram, lv_color_t *sram)
+{
+    const uint32_t fb_px   = APP_LCD_H_RES * APP_LCD_V_RES;
+    const uint32_t sram_px = SRAM_BUF_BYTES / sizeof(lv_color_t);
+    const lv_color_t c     = lv_color_make(0x20, 0x80, 0xC0);
+    int64_t t;
+
+    t = esp_timer_get_time();
+    lv_color_fill(psram, c, fb_px);
+    add_result("fill_psram_Mpxps", per_us(fb_px, esp_timer_get_time() - t));
+
+    t = esp_timer_get_time();
+    for (int i = 0; i < 10; i++) lv_color_fill(sram, c, sram_px);
+    add_result("fill_sram_Mpxps",
+               per_us(sram_px * 10, esp_timer_get_time() - t));
+
+    t = esp_timer_get_time();
+    for (uint32_t i = 0; i < fb_px; i++) {
+        psram[i] = lv_color_mix(c, psram[i], LV_OPA_50);
+    }
+    add_result("blend_psram_Mpxps", per_us(fb_px, esp_timer_get_time() - t));
+
+    t = esp_timer_get_time();
+    for (int n = 0; n < 10; n++) {
+        for (uint32_t i = 0; i < sram_px; i++) {
+            sram[i] = lv_color_mix(c, sram[i], LV_OPA_50);
+        }
+    }
+    add_result("blend_sram_Mpxps",
+               per_us(sram_px * 10, esp_timer_get_time() - t));
+
+    /* One frame's worth of scan-out lines, PSRAM → SRAM as in the refill:
+       RGB565 line copy (960 B read) vs indexed expansion (480 B read). */
+    const uint8_t *src = (const uint8_t *)psram;
+    const int      line = APP_LCD_H_RES;
+
+    t = esp_timer_get_time();
+    for (int y = 0; y < APP_LCD_V_RES; y++) {
+        memcpy(sram, src + y * line * 2, line * 2);
+    }
+    add_result("line_copy565_us",
+               (float)(esp_timer_get_time() - t) / APP_LCD_V_RES);
+
+    t = esp_timer_get_time();
+    for (int y = 0; y < APP_LCD_V_RES; y++) {
+        lcd_scanout_expand_line((uint16_t *)sram, src + y * line, 0);
+    }
+    add_result("line_expand332_us",
+               (float)(esp_timer_get_time() - t) / APP_LCD_V_RES);
+
+    t = esp_timer_get_time();
+    for (int y = 0; y < APP_LCD_V_RES; y++) {
+        lcd_scanout_quantize_line((uint8_t *)psram + y * line,
+                                  (const uint16_t *)sram, line, 0, y);
+    }
+    add_result("line_quantize_us",
+               (float)(esp_timer_get_time() - t) / APP_LCD_V_RES);
+}
+
+/* ── LVGL draw primitives + QR ───────────────────────────────────────── */
+
+static void bench_lvgl(lv_color_t *canvas_buf)
+{
+    lv_obj_t *scr = lv_obj_create(NULL);       /* never loaded */
+    lv_obj_t *cv  = lv_canvas_create(scr);
+    lv_canvas_set_buffer(cv, canvas_buf, CANVAS_W, CANVAS_H,
+                         LV_IMG_CF_TRUE_COLOR);
+    lv_canvas_fill_bg(cv, lv_color_black(), LV_OPA_COVER);
+
+    lv_draw_rect_dsc_t rect;
+    lv_draw_rect_dsc_init(&rect);
+    rect.bg_color = lv_color_make(0x30, 0x30, 0x30);
+    rect.bg_opa   = LV_OPA_COVER;
+
+    int64_t t = esp_timer_get_time();
+    for (int i = 0; i < DRAW_ITERS; i++) {
+        lv_canvas_draw_rect(cv, 10, 10, 200, 200, &rect);
+    }
+    add_result("lv_rect_us",
+               (float)(esp_timer_get_time() - t) / DRAW_ITERS);
+
+    /* Glass card: translucent, rounded, 1 px border */
+    rect.bg_opa       = LV_OPA_40;
+    rect.radius       = 14;
+    rect.border_color = lv_color_white();
+    rect.border_opa   = LV_OPA_20;
+    rect.border_width = 1;
+
+    t = esp_timer_get_time();
+    for (int i = 0; i < DRAW_ITERS; i++) {
+        lv_canvas_draw_rect(cv, 20, 20, 64, 90, &rect);
+    }
+    add_result("lv_glass_card_us",
+               (float)(esp_timer_get_time() - t) / DRAW_ITERS);
+
+    lv_draw_label_dsc_t label;
+    lv_draw_label_dsc_init(&label);
+    label.color = lv_color_white();
+    label.font  = &lv_font_montserrat_48;
+
+    t = esp_timer_get_time();
+    for (int i = 0; i < DRAW_ITERS; i++) {
+        lv_canvas_draw_text(cv, 10, 80, CANVAS_W - 20, &label, "12:34");
+    }
+    add_result("lv_text48_us",
+               (float)(esp_timer_get_time() - t) / DRAW_ITERS);
+
+    lv_obj_t *qr = lv_qrcode_create(scr, 280,
+                                    lv_color_black(), lv_color_white());
+    t = esp_timer_get_time();
+    for (int i = 0; i < QR_ITERS; i++) {
+        lv_qrcode_update(qr, SAMPLE_QR, strlen(SAMPLE_QR));
+    }
+    add_result("qr_update_us",
+               (float)(esp_timer_get_time() - t) / QR_ITERS);
+
+    /* Own renderer: first draw is full, then amount edits diff against
+       the symbol on screen. */
+    lv_obj_t *qr2 = qr_render_create(scr, 280,
+                                     lv_color_black(), lv_color_white());
+    qr_render_stats_t rs;
+    uint64_t incr_us = 0, changed = 0, modules = 0;
+
+    qr_render_update(qr2, SAMPLE_QR, strlen(SAMPLE_QR), &rs);
+    add_result("qr_render_full_us", (float)(rs.encode_us + rs.draw_us));
+
+    for (int i = 0; i < QR_ITERS; i++) {
+        const char *p = (i & 1) ? SAMPLE_QR : SAMPLE_QR_EDIT;
+        qr_render_update(qr2, p, strlen(p), &rs);
+        incr_us += rs.encode_us + rs.draw_us;
+        changed += rs.changed;
+        modules += rs.modules;
+    }
+    add_result("qr_render_edit_us", (float)incr_us / QR_ITERS);
+    add_result("qr_changed_pct",
+               modules ? 100.0f * changed / modules : 0.0f);
+
+    /* Large payloads on the full 480 px canvas (encode + full redraw). */
+    static const struct { const char *name; size_t len; } BIG[] = {
+        { "qr_1000B_us", 1000 },
+        { "qr_2000B_us", 2000 },
+        { "qr_2953B_us", QR_DATA_MAX - 1 },        /* version 40-L */
+    };
+    lv_obj_t *qr3 = qr_render_create(scr, APP_LCD_H_RES,
+                                     lv_color_black(), lv_color_white());
+    char     *big = heap_caps_malloc(QR_DATA_MAX, MALLOC_CAP_SPIRAM);
+    if (qr3 && big) {
+        for (size_t i = 0; i < QR_DATA_MAX; i++) big[i] = 'A' + i % 26;
+        for (size_t i = 0; i < sizeof(BIG) / sizeof(BIG[0]); i++) {
+            qr_render_clear(qr3);
+            bool ok = qr_render_update(qr3, big, BIG[i].len, &rs) == LV_RES_OK;
+            add_result(BIG[i].name,
+                       ok ? (float)(rs.encode_us + rs.draw_us) : -1.0f);
+        }
+        add_result("qr_2953B_version", (float)rs.version);
+        add_result("qr_2953B_scale",   (float)rs.scale);
+    }
+    heap_caps_free(big);
+
+    lv_obj_del(scr);
+}
+
+/* ── Scene redraw through the real render path ──────────────────────── */
+
+static void bench_scene(void)
+{
+    lcd_render_stats_t a, b;
+    lcd_st7701_get_render_stats(&a);
+
+    int64_t t = esp_timer_get_time();
+    for (int i = 0; i < SCENE_ITERS; i++) {
+        lv_obj_invalidate(lv_scr_act());
+        lv_refr_now(NULL);
+    }
+    add_result("scene_redraw_ms",
+               (float)(esp_timer_get_time() - t) / 1000.0f / SCENE_ITERS);
+
+    lcd_st7701_get_render_stats(&b);
+
+    /* Partial: bytes GDMA wrote into PSRAM.  Direct: LVGL wrote every
+       rendered pixel straight into PSRAM (blends also read it back). */
+    uint64_t psram = b.partial ? (b.flush_bytes - a.flush_bytes)
+                               : (b.render_px - a.render_px) * sizeof(lv_color_t);
+    add_result("scene_psram_write_KB", (float)psram / 1024.0f / SCENE_ITERS);
+
+    add_result("render_partial", b.partial ? 1.0f : 0.0f);
+    add_result("lvgl_sram_KB",   (float)b.sram_bytes / 1024.0f);
+    add_result("fb_psram_KB",    (float)b.fb_bytes / 1024.0f);
+
+    /* QR composition, from the live counters (the suite never runs while
+       a QR is up): tile SRAM, framebuffer reads saved per frame, and the
+       cost of the last switches. */
+    compose_stats_t     cs;
+    lcd_scanout_stats_t ss;
+    compose_service_get_stats(&cs);
+    lcd_scanout_get_stats(&ss);
+    add_result("compose_tile_KB",      (float)cs.tile_bytes / 1024.0f);
+    add_result("compose_saved_KB",     (float)cs.fb_bytes_saved / 1024.0f);
+    add_result("compose_copy_us",      (float)cs.copy_us_last);
+    add_result("layout_switch_us_max", (float)ss.switch_us_max);
+    add_result("avg_refresh_ms",
+               b.refreshes ? (float)b.render_ms / b.refreshes : 0.0f);
+}
+
+/* ── Report ──────────────────────────────────────────────────────────── */
+
+static void publish_refusal(const char *reason)
+{
+    int n = snprintf(s_report, sizeof(s_report),
+                     "{\"status\":\"refused\",\"reason\":\"%s\"}", reason);
+    outbox_post(APP_MQTT_TOPIC_BENCH_RESULT, s_report, n, 1, 0);
+    ESP_LOGW(TAG, "Refused: %s", reason);
+}
+
+static void publish_report(int64_t duration_us, bool aborted)
+{
+    size_t n = snprintf(s_report, sizeof(s_report),
+                        "{\"status\":\"%s\",\"cpu_mhz\":%d,\"psram_mhz\":%d,"
+                        "\"duration_ms\":%lld,\"results\":{",
+                        aborted ? "aborted" : "ok",
+                        CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ, CONFIG_SPIRAM_SPEED,
+                        duration_us / 1000);
+
+    for (int i = 0; i < s_res_cnt && n < sizeof(s_report); i++) {
+        n += snprintf(s_report + n, sizeof(s_report) - n, "%s\"%s\":%.2f",
+                      i ? "," : "", s_res[i].name, s_res[i].value);
+    }
+    if (n < sizeof(s_report)) {
+        n += snprintf(s_report + n, sizeof(s_report) - n, "}}");
+    }
+    if (n >= sizeof(s_report)) {
+        ESP_LOGE(TAG, "Report truncated");
+        return;
+    }
+
+    outbox_post(APP_MQTT_TOPIC_BENCH_RESULT, s_report, n, 1, 0);
+}
+
+/* ── MQTT command (MQTT task context) ─────────────────────────────────── */
+
+static void on_bench_cmd(const char *data, int len)
+{
+    (void)data;
+    (void)len;
+    s_requested = true;
+}
+
+/* ── Public API ──────────────────────────────────────────────────────── */
+
+esp_err_t bench_service_init(void)
+{
+    return mqtt_service_register_handler(APP_MQTT_TOPIC_BENCH_RUN,
+                                         on_bench_cmd);
+}
+
+void bench_service_poll(void)
+{
+    if (!s_requested) return;
+    s_requested = false;
+
+    s_start_gen = mqtt_service_get_qr_gen();
+    if (qr_pending()) {
+        publish_refusal("qr_visible");
+        return;
+    }
+
+    uint8_t    *psram  = heap_caps_aligned_alloc(64, PSRAM_BUF_BYTES,
+                                                 MALLOC_CAP_SPIRAM);
+    lv_color_t *sram   = heap_caps_malloc(SRAM_BUF_BYTES,
+                                          MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    lv_color_t *canvas = heap_caps_malloc(
+        LV_CANVAS_BUF_SIZE_TRUE_COLOR(CANVAS_W, CANVAS_H), MALLOC_CAP_SPIRAM);
+
+    if (!psram || !sram || !canvas) {
+        publish_refusal("no_mem");
+        goto out;
+    }
+
+    ESP_LOGI(TAG, "Running suite (panel scanning out)");
+    s_res_cnt = 0;
+    memset(sram, 0, SRAM_BUF_BYTES);
+
+    int64_t t0      = esp_timer_get_time();
+    bool    aborted = false;
+
+    bench_memory(psram, (uint8_t *)sram);
+    aborted = qr_pending();
+    if (!aborted) {
+        bench_codec();
+        aborted = qr_pending();
+    }
+    if (!aborted) {
+        bench_pixels((lv_color_t *)psram, sram);
+        aborted = qr_pending();
+    }
+    if (!aborted) {
+        bench_lvgl(canvas);
+        aborted = qr_pending();
+    }
+    if (!aborted) {
+        bench_scene();
+    }
+
+    publish_report(esp_timer_get_time() - t0, aborted);
+    ESP_LOGI(TAG, "Suite %s in %lld ms", aborted ? "aborted" : "done",
+             (esp_timer_get_time() - t0) / 1000);
+
+out:
+    heap_caps_free(psram);
+    heap_caps_free(sram);
+    heap_caps_free(canvas);
+}
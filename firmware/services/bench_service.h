@@ -0,0 +1,19 @@
+#pragma once
+
+#include "esp_err.h"
+
+/**
+ * Register the pos/bench/run command topic.
+ * Call before mqtt_service_init().  Allocates nothing until a run.
+ */
+esp_err_t bench_service_init(void);
+
+/**
+ * Run a pending benchmark request, if any.
+ *
+ * Must be called from the LVGL task: the draw-primitive and QR cases use
+ * LVGL directly.  The panel keeps scanning out during the run, so the
+ * numbers include LCD DMA / bounce-refill contention.  Refuses (and
+ * reports why) while a QR is visible or about to be shown.
+ */
+void bench_service_poll(void);
@@ -0,0 +1,91 @@
+/*
+ * Brightness policy – maps UI state and time of day to a backlight level.
+ *
+ *   QR_DISPLAY / RESULT → APP_BL_QR_PCT, instantly (max contrast for scanning)
+ *   IDLE, day           → APP_BL_IDLE_DAY_PCT
+ *   IDLE, night         → APP_BL_IDLE_NIGHT_PCT
+ *   IDLE, no touch for APP_BL_IDLE_DIM_AFTER_S → APP_BL_IDLE_DIM_PCT
+ *
+ * The APP_BL_* values are defaults; the levels, dim delay and night hours
+ * in use come from the runtime configuration and apply at the next
+ * evaluation.
+ *
+ * Idle transitions use APP_BL_FADE_MS hardware fades.  Until SNTP has set
+ * the clock, the day level is used.  Time and inactivity are evaluated at
+ * most once per second; a state change is handled immediately.
+ */
+
+#include "brightness_service.h"
+#include "backlight.h"
+#include "time_service.h"
+#include "config_service.h"
+#include "app_config.h"
+
+#include <time.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lvgl.h"
+
+static const char *TAG = "brightness";
+
+static ui_state_t s_state  = UI_STATE_IDLE;
+static int        s_target = -1;
+static int64_t    s_next_eval_us;
+
+static bool is_night(const app_cfg_t *cfg)
+{
+    if (!time_service_is_time_valid()) return false;
+
+    time_t now = time(NULL);
+    struct tm t;
+    localtime_r(&now, &t);
+
+    int start = cfg->bl_night_start_h, end = cfg->bl_night_end_h;
+    if (start > end) {
+        return t.tm_hour >= start || t.tm_hour < end;
+    }
+    return t.tm_hour >= start && t.tm_hour < end;
+}
+
+static int idle_level(const app_cfg_t *cfg)
+{
+    if (lv_disp_get_inactive_time(NULL) >= cfg->bl_dim_after_s * 1000U) {
+        return cfg->bl_dim_pct;
+    }
+    return is_night(cfg) ? cfg->bl_night_pct : cfg->bl_day_pct;
+}
+
+void brightness_service_update(ui_state_t state)
+{
+    int64_t now     = esp_timer_get_time();
+    bool    changed = (state != s_state);
+
+    if (!changed && now < s_next_eval_us) return;
+    s_state        = state;
+    s_next_eval_us = now + 1000000;
+
+    const app_cfg_t *cfg = config_service_get();
+    int      target;
+    uint32_t fade_ms;
+    if (state == UI_STATE_IDLE) {
+        target  = idle_level(cfg);
+        fade_ms = APP_BL_FADE_MS;
+    } else {
+        target  = cfg->bl_qr_pct;
+        fade_ms = 0;
+    }
+
+    if (target == s_target) return;
+    s_target = target;
+
+    backlight_set((uint8_t)target, fade_ms);
+    ESP_LOGI(TAG, "Backlight → %d%% (%s)", target,
+             fade_ms ? "fade" : "instant");
+}
+
+void brightness_service_invalidate(void)
+{
+    s_target       = -1;
+    s_next_eval_us = 0;
+}
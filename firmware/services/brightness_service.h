@@ -0,0 +1,20 @@
+#pragma once
+
+#include "ui_router.h"
+
+/**
+ * Apply the backlight brightness policy for the current UI state.
+ *
+ * Call every LVGL loop iteration; it only reprograms the backlight when
+ * the target changes.  QR / result states jump to full brightness
+ * instantly; idle levels follow time of day and dim further after
+ * APP_BL_IDLE_DIM_AFTER_S without touch, using hardware fades.
+ */
+void brightness_service_update(ui_state_t state);
+
+/**
+ * Forget the level last programmed, so the next update applies the
+ * policy again even if the target is unchanged.  For callers that drove
+ * the backlight directly (panel sleep turns it off).
+ */
+void brightness_service_invalidate(void);
@@ -0,0 +1,253 @@
+/*
+ * Command authentication – HMAC-SHA256 envelope with a replay window.
+ *
+ * The MQTT task calls cmd_auth_check() on every message before any
+ * parsing.  Hashing runs on the ESP32-S3 SHA peripheral through mbedTLS
+ * (CONFIG_MBEDTLS_HARDWARE_SHA); the key's inner and outer pads are
+ * hashed once at init and only the message is hashed per command, so a
+ * maximum-size (2953-byte) QR costs ~50 blocks of SHA-256.
+ *
+ * With a key set, a message without the envelope is dropped: the
+ * config topic can change the payee account, so "unsigned" must never
+ * mean "trusted".
+ *
+ * Replay protection keeps the highest accepted sequence number and a
+ * 64-bit bitmap of the ones just below it (out-of-order delivery within
+ * the window is fine, a repeat is not).  The high-water mark is kept in
+ * RTC memory, written at once, and in NVS ("cmdauth"/"seq_high") through
+ * a flash_sched job, so it also survives a power cycle – hide and result
+ * commands carry no "ts" to age out.  After a restart the bitmap is
+ * unknown, so the whole window below the restored mark counts as seen;
+ * only a command accepted in the last moments before a power cut, whose
+ * job had not run yet, could be replayed once.
+ */
+
+#include "cmd_auth.h"
+#include "flash_sched.h"
+#include "secrets.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "nvs.h"
+#include "mbedtls/md.h"
+
+static const char *TAG = "cmd_auth";
+
+#define MAC_LEN         32
+#define SEQ_DIGITS_MAX  20
+#define RTC_MAGIC       0x41555448u             /* "AUTH" */
+#define NVS_NAMESPACE   "cmdauth"
+#define NVS_KEY         "seq_high"
+
+static cmd_auth_stats_t  s_stats;
+
+#ifdef APP_CMD_HMAC_KEY
+
+static mbedtls_md_context_t s_md;
+static SemaphoreHandle_t    s_md_lock;
+
+static RTC_NOINIT_ATTR uint32_t s_rtc_magic;
+static RTC_NOINIT_ATTR uint64_t s_rtc_high;     /* highest accepted seq   */
+static uint64_t                 s_window;       /* bit i: high - i seen   */
+static uint64_t                 s_nvs_high;     /* last value in NVS      */
+static portMUX_TYPE             s_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static int hex_val(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/* Parse "#<seq>.<hex>\n"; returns the header length, 0 if malformed. */
+static int parse_envelope(const char *p, int len, uint64_t *seq,
+                          uint8_t mac[MAC_LEN])
+{
+    int i = 1, digits = 0;
+    *seq = 0;
+    while (i < len && p[i] >= '0' && p[i] <= '9') {
+        if (++digits > SEQ_DIGITS_MAX) return 0;
+        *seq = *seq * 10 + (p[i++] - '0');
+    }
+    if (!digits || i >= len || p[i++] != '.') return 0;
+    if (len - i < MAC_LEN * 2 + 1) return 0;
+
+    for (int k = 0; k < MAC_LEN; k++, i += 2) {
+        int hi = hex_val(p[i]), lo = hex_val(p[i + 1]);
+        if (hi < 0 || lo < 0) return 0;
+        mac[k] = hi << 4 | lo;
+    }
+    return p[i] == '\n' ? i + 1 : 0;
+}
+
+/* Accept @p seq once.  The window moves only after a valid MAC. */
+static bool replay_ok(uint64_t seq)
+{
+    if (seq > s_rtc_high) return true;
+    uint64_t back = s_rtc_high - seq;
+    return back < 64 && !(s_window >> back & 1);
+}
+
+/* flash_sched job: bring NVS up to the current high-water mark. */
+static void nvs_sync(void)
+{
+    taskENTER_CRITICAL(&s_mux);
+    uint64_t high = s_rtc_high;
+    taskEXIT_CRITICAL(&s_mux);
+    if (high <= s_nvs_high) return;
+
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h);
+    if (err == ESP_OK) {
+        err = nvs_set_u64(h, NVS_KEY, high);
+        if (err == ESP_OK) err = nvs_commit(h);
+        nvs_close(h);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "seq high-water not saved: %s", esp_err_to_name(err));
+        return;
+    }
+    s_nvs_high = high;
+    s_stats.nvs_writes++;
+}
+
+static void replay_mark(uint64_t seq)
+{
+    if (seq > s_rtc_high) {
+        uint64_t shift = seq - s_rtc_high;
+        s_window = shift < 64 ? s_window << shift : 0;
+        taskENTER_CRITICAL(&s_mux);             /* read by nvs_sync() */
+        s_rtc_high = seq;
+        taskEXIT_CRITICAL(&s_mux);
+        flash_sched_post(FLASH_JOB_AUTH_SEQ, nvs_sync);
+    }
+    s_window |= 1ULL << (s_rtc_high - seq);
+}
+
+esp_err_t cmd_auth_init(void)
+{
+    s_md_lock = xSemaphoreCreateMutex();
+    ESP_RETURN_ON_FALSE(s_md_lock, ESP_ERR_NO_MEM, TAG, "mutex alloc failed");
+
+    mbedtls_md_init(&s_md);
+    const mbedtls_md_info_t *info = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
+    ESP_RETURN_ON_FALSE(info && mbedtls_md_setup(&s_md, info, 1) == 0 &&
+                        mbedtls_md_hmac_starts(&s_md,
+                            (const unsigned char *)APP_CMD_HMAC_KEY,
+                            strlen(APP_CMD_HMAC_KEY)) == 0,
+                        ESP_FAIL, TAG, "HMAC setup failed");
+
+    if (s_rtc_magic != RTC_MAGIC) {
+        s_rtc_magic = RTC_MAGIC;
+        s_rtc_high  = 0;                        /* power-on */
+    }
+    nvs_handle_t h;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &h) == ESP_OK) {
+        if (nvs_get_u64(h, NVS_KEY, &s_nvs_high) != ESP_OK) s_nvs_high = 0;
+        nvs_close(h);
+    }
+    if (s_nvs_high > s_rtc_high) s_rtc_high = s_nvs_high;
+
+    /* Which seqs below high were used is lost: treat them all as seen. */
+    s_window = s_rtc_high ? ~0ULL : 0;
+
+    ESP_LOGI(TAG, "HMAC commands required, seq high-water %llu",
+             (unsigned long long)s_rtc_high);
+    return ESP_OK;
+}
+
+esp_err_t cmd_auth_mac(uint64_t seq, const void *body, size_t len,
+                       uint8_t mac[MAC_LEN])
+{
+    char pre[SEQ_DIGITS_MAX + 2];
+    int  n = snprintf(pre, sizeof(pre), "%llu.", (unsigned long long)seq);
+
+    xSemaphoreTake(s_md_lock, portMAX_DELAY);
+    int rc = mbedtls_md_hmac_reset(&s_md);
+    if (!rc) rc = mbedtls_md_hmac_update(&s_md, (const unsigned char *)pre, n);
+    if (!rc) rc = mbedtls_md_hmac_update(&s_md, body, len);
+    if (!rc) rc = mbedtls_md_hmac_finish(&s_md, mac);
+    xSemaphoreGive(s_md_lock);
+    return rc ? ESP_FAIL : ESP_OK;
+}
+
+bool cmd_auth_check(const char **data, int *len)
+{
+    const char *p = *data;
+    int         n = *len;
+
+    if (n < 1 || p[0] != '#') {
+        s_stats.unsigned_dropped++;
+        ESP_LOGW(TAG, "Unsigned command dropped");
+        return false;
+    }
+
+    int64_t  t0 = esp_timer_get_time();
+    uint64_t seq;
+    uint8_t  want[MAC_LEN], got[MAC_LEN];
+    int      hdr = parse_envelope(p, n, &seq, want);
+    if (!hdr || cmd_auth_mac(seq, p + hdr, n - hdr, got) != ESP_OK) {
+        s_stats.bad_mac++;
+        ESP_LOGW(TAG, "Malformed envelope dropped");
+        return false;
+    }
+
+    uint8_t diff = 0;                           /* constant time */
+    for (int i = 0; i < MAC_LEN; i++) diff |= want[i] ^ got[i];
+
+    uint32_t us = esp_timer_get_time() - t0;
+    s_stats.verify_us_last = us;
+    if (us > s_stats.verify_us_max) s_stats.verify_us_max = us;
+
+    if (diff) {
+        s_stats.bad_mac++;
+        ESP_LOGW(TAG, "Bad MAC, seq %llu – dropped", (unsigned long long)seq);
+        return false;
+    }
+    if (!replay_ok(seq)) {
+        s_stats.replays++;
+        ESP_LOGW(TAG, "Replay, seq %llu – dropped", (unsigned long long)seq);
+        return false;
+    }
+    replay_mark(seq);
+    s_stats.verified++;
+
+    *data = p + hdr;
+    *len  = n - hdr;
+    return true;
+}
+
+#else   /* !APP_CMD_HMAC_KEY */
+
+esp_err_t cmd_auth_init(void)
+{
+    ESP_LOGW(TAG, "No APP_CMD_HMAC_KEY – commands are not authenticated");
+    return ESP_OK;
+}
+
+esp_err_t cmd_auth_mac(uint64_t seq, const void *body, size_t len,
+                       uint8_t mac[MAC_LEN])
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+bool cmd_auth_check(const char **data, int *len)
+{
+    return true;
+}
+
+#endif
+
+void cmd_auth_get_stats(cmd_auth_stats_t *out)
+{
+    *out = s_stats;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/**
+ * Authenticated command envelope – a first line in front of any command
+ * body (JSON or binary), mandatory once APP_CMD_HMAC_KEY is set:
+ *
+ *   #<seq>.<64 hex digits>\n<body>
+ *
+ * The MAC is HMAC-SHA256(APP_CMD_HMAC_KEY, "<seq>." || body), so the
+ * sequence number is covered too.  <seq> is a decimal u64 that must grow;
+ * the POS should use unix milliseconds.  tools/pos_bin.py --hmac-key
+ * produces it.
+ */
+
+/** Verification counters (monotonic since boot). */
+typedef struct {
+    uint32_t verified;
+    uint32_t bad_mac;           /* malformed envelope or wrong MAC        */
+    uint32_t replays;           /* seq already seen or below the window   */
+    uint32_t unsigned_dropped;  /* no envelope                            */
+    uint32_t verify_us_last;
+    uint32_t verify_us_max;
+    uint32_t nvs_writes;        /* high-water mark saved to NVS           */
+} cmd_auth_stats_t;
+
+/**
+ * Set up the HMAC context (the key is hashed once) and restore the
+ * sequence high-water mark.  Call after config_service_init() (NVS) and
+ * flash_sched_init().  Without APP_CMD_HMAC_KEY in secrets.h
+ * authentication is off and every command passes unchanged.
+ */
+esp_err_t cmd_auth_init(void);
+
+/**
+ * Check one incoming message before it is parsed.  On success @p data and
+ * @p len are advanced past the envelope and true is returned; false means
+ * drop the message (reason logged and counted).
+ */
+bool cmd_auth_check(const char **data, int *len);
+
+/**
+ * HMAC-SHA256 of "<seq>." || @p body into @p mac – the verifier's own
+ * routine, exposed for the benchmark.
+ */
+esp_err_t cmd_auth_mac(uint64_t seq, const void *body, size_t len,
+                       uint8_t mac[32]);
+
+/**
+ * Copy the verification counters into @p out.
+ */
+void cmd_auth_get_stats(cmd_auth_stats_t *out);
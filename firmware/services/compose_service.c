@@ -0,0 +1,168 @@
+/*
+ * QR layer composition – serves the QR rows of the screen from a small
+ * cached tile instead of the framebuffer.
+ *
+ * The QR widget draws into a 1-bpp canvas.  On every new QR the canvas
+ * bits are copied into one of two tile buffers in internal SRAM and the
+ * scan-out is given a layout with one band covering the QR rows.  Once
+ * the refill has adopted it the widget is hidden, so LVGL no longer
+ * redraws those 280 lines into PSRAM either.  Only the label bands above
+ * and below stay dynamic.
+ *
+ * The two tiles alternate so the one being scanned out is never
+ * rewritten; a new copy waits until the previous layout switch landed.
+ */
+
+#include "compose_service.h"
+#include "lcd_scanout.h"
+#include "lcd_st7701.h"
+#include "qr_screen.h"
+#include "app_config.h"
+
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "lvgl.h"
+
+static compose_stats_t s_stats;
+
+#if APP_LCD_COMPOSE_QR
+
+static const char *TAG = "compose";
+
+static uint8_t        *s_tile[2];
+static size_t          s_tile_cap;
+static int             s_back;
+static uint32_t        s_gen;
+static bool            s_hidden;
+static int64_t         s_unhide_us;     /* widget back, awaiting a render */
+static bool            s_alloc_failed;  /* for s_failed_gen: no retry     */
+static uint32_t        s_failed_gen;
+
+static bool alloc_tiles(size_t bytes)
+{
+    if (bytes <= s_tile_cap) return true;
+
+    heap_caps_free(s_tile[0]);
+    heap_caps_free(s_tile[1]);
+    s_tile[0] = heap_caps_malloc(bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    s_tile[1] = heap_caps_malloc(bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!s_tile[0] || !s_tile[1]) {
+        heap_caps_free(s_tile[0]);
+        heap_caps_free(s_tile[1]);
+        s_tile[0] = s_tile[1] = NULL;
+        s_tile_cap = 0;
+        return false;
+    }
+    s_tile_cap         = bytes;
+    s_stats.tile_bytes = 2 * bytes;
+    return true;
+}
+
+/*
+ * Called every loop until the band is gone.  Widget back first, and the
+ * band is only dropped once LVGL has rendered it into the framebuffer
+ * again – otherwise the QR area would scan out blank for a frame.
+ */
+static void leave(void)
+{
+    if (s_hidden) {
+        qr_screen_set_composed(false);
+        s_hidden    = false;
+        s_unhide_us = esp_timer_get_time();
+        return;
+    }
+    if (s_unhide_us) {
+        lcd_render_stats_t r;
+        lcd_st7701_get_render_stats(&r);
+        if (r.last_render_at_us <= s_unhide_us) return;
+    }
+    if (lcd_scanout_layout_pending()) return;
+
+    if (lcd_scanout_set_layout(NULL, 0) == ESP_OK) {
+        s_unhide_us            = 0;
+        s_stats.active         = false;
+        s_stats.fb_bytes_saved = 0;
+        ESP_LOGI(TAG, "QR band released");
+    }
+}
+
+#endif /* APP_LCD_COMPOSE_QR */
+
+void compose_service_update(void)
+{
+#if APP_LCD_COMPOSE_QR
+    qr_tile_t t;
+
+    if (!qr_screen_get_tile(&t)) {
+        if (s_stats.active) leave();
+        return;
+    }
+
+    if (s_stats.active && t.gen == s_gen) {
+        /* Hide the widget only once the band is actually on screen. */
+        if (!s_hidden && !lcd_scanout_layout_pending()) {
+            qr_screen_set_composed(true);
+            s_hidden    = true;
+            s_unhide_us = 0;
+        }
+        return;
+    }
+    if (lcd_scanout_layout_pending()) return;
+    if (s_alloc_failed && t.gen == s_failed_gen) return;
+
+    int    w     = lv_area_get_width(&t.area);
+    int    h     = lv_area_get_height(&t.area);
+    size_t bytes = (size_t)t.stride * h;
+
+    /* A bigger tile (full-screen QR) means reallocating – release the
+       band that still scans out of the old buffers first. */
+    if (bytes > s_tile_cap && s_stats.active) {
+        leave();
+        return;
+    }
+    if (!alloc_tiles(bytes)) {
+        ESP_LOGW(TAG, "no SRAM for %u B QR tile – not composing",
+                 (unsigned)bytes);
+        s_alloc_failed = true;          /* next QR tries again */
+        s_failed_gen   = t.gen;
+        return;
+    }
+    s_alloc_failed = false;
+
+    int64_t  t0   = esp_timer_get_time();
+    uint8_t *tile = s_tile[s_back];
+    memcpy(tile, t.bits, bytes);
+
+    const lcd_scanout_band_t band = {
+        .x      = t.area.x1,
+        .y      = t.area.y1,
+        .w      = w,
+        .h      = h,
+        .stride = t.stride,
+        .c0     = lv_color_to16(t.dark),
+        .c1     = lv_color_to16(t.light),
+        .bits   = tile,
+    };
+    if (lcd_scanout_set_layout(&band, 1) != ESP_OK) return;
+
+    s_stats.copy_us_last   = esp_timer_get_time() - t0;
+    s_stats.tile_updates++;
+    s_stats.fb_bytes_saved = h * APP_LCD_H_RES
+                             * (APP_LCD_FB_INDEXED ? 1 : sizeof(uint16_t));
+    s_stats.active         = true;
+    s_back ^= 1;
+    s_gen   = t.gen;
+
+    ESP_LOGI(TAG, "QR band y=%d..%d from %u B tile (%u us)",
+             band.y, band.y + h - 1, (unsigned)bytes,
+             (unsigned)s_stats.copy_us_last);
+#endif
+}
+
+void compose_service_get_stats(compose_stats_t *out)
+{
+    *out = s_stats;
+}
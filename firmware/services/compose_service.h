@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/** Composition counters (monotonic since boot, except where noted). */
+typedef struct {
+    bool     active;            /* QR rows currently come from the tile   */
+    uint32_t tile_updates;      /* tile copies handed to the scan-out     */
+    uint32_t copy_us_last;      /* canvas → tile copy + set_layout        */
+    uint32_t tile_bytes;        /* SRAM held by both tile buffers         */
+    uint32_t fb_bytes_saved;    /* framebuffer bytes not read per frame   */
+} compose_stats_t;
+
+/**
+ * Keep the scan-out layout in step with the QR screen.
+ *
+ * Call every LVGL loop iteration, after the QR screen was updated and
+ * before lv_timer_handler().  While a QR is visible its rows are served
+ * from a cached 1-bpp tile in internal SRAM; the labels above and below
+ * still come from the framebuffer.  No-op unless APP_LCD_COMPOSE_QR.
+ */
+void compose_service_update(void);
+
+/**
+ * Copy the composition counters into @p out.
+ */
+void compose_service_get_stats(compose_stats_t *out);
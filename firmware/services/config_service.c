@@ -0,0 +1,424 @@
+/*
+ * Runtime configuration store – settings that used to need a reflash,
+ * pushed as JSON change sets on APP_MQTT_TOPIC_CONFIG:
+ *
+ *   { "version": 7,                         required, > current version
+ *     "tz": "ICT-7",                        POSIX TZ
+ *     "topic_prefix": "pos",                QR command topics <p>/qr/...
+ *     "bl": { "qr": 100, "day": 70, "night": 30, "dim": 15,
+ *             "dim_after_s": 300, "night_start_h": 20, "night_end_h": 7 },
+ *     "screensaver": "rain" | "plain",
+ *     "quote_rotate_s": 10,
+ *     "quotes": [ "...", ... ],             [] = built-in quotes
+ *     "vietqr": { "bin": "970422", "account": "...", "note": "...",
+ *                 "name": "..." } }
+ *
+ * Every key except "version" is optional; absent keys keep their value.
+ * The current version again – the retained change set, redelivered on
+ * every reconnect – is already applied and ignored without an ack.
+ * The whole change set is validated into a scratch copy first, so a bad
+ * field rejects it without touching the live configuration.  The copy
+ * then becomes current with one index flip (two buffers in PSRAM) and is
+ * applied live: timezone and command topics at once, brightness at its
+ * next evaluation, the idle screen through config_service_get_gen().
+ *
+ * Persistence is one nvs_set_blob() plus one nvs_commit() per change set,
+ * whatever the number of keys, run as a flash_sched job – off the MQTT
+ * task and away from QR transitions.  Change sets arriving before it ran
+ * share the write, and its ack (for the newest version) stands for them.
+ * Results go to APP_MQTT_TOPIC_CONFIG_ACK through the outbox:
+ *
+ *   {"version":7,"status":"applied","apply_us":n,"commit_us":n,
+ *    "nvs_writes":n}
+ *   {"version":7,"status":"rejected","error":"<key>"}
+ *
+ * The handler runs in the MQTT task, the only writer; readers in other
+ * tasks see either the old or the new buffer.
+ */
+
+#include "config_service.h"
+#include "mqtt_service.h"
+#include "outbox_service.h"
+#include "flash_sched.h"
+#include "time_service.h"
+#include "app_config.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+#include "cJSON.h"
+
+static const char *TAG = "config";
+
+#define NVS_NAMESPACE   "appcfg"
+#define NVS_KEY         "cfg"
+#define CFG_MAGIC       0x47464343u     /* "CCFG" */
+
+/* NVS image: a layout check in front of the struct, so a blob written by
+   firmware with a different app_cfg_t falls back to defaults. */
+typedef struct {
+    uint32_t  magic;
+    uint32_t  size;
+    app_cfg_t cfg;
+} cfg_blob_t;
+
+static EXT_RAM_BSS_ATTR app_cfg_t  s_cfg[2];
+static EXT_RAM_BSS_ATTR cfg_blob_t s_blob;
+static volatile int      s_cur;
+static volatile uint32_t s_gen;
+static config_stats_t    s_stats;
+static const char       *s_err;     /* key that rejected the change set */
+static SemaphoreHandle_t s_cfg_lock;    /* buffer writes vs persist() copy */
+
+/* ── Defaults and persistence ─────────────────────────────────────────── */
+
+static void set_defaults(app_cfg_t *c)
+{
+    memset(c, 0, sizeof(*c));
+    strcpy(c->tz, APP_TZ);
+    strcpy(c->topic_prefix, APP_MQTT_TOPIC_PREFIX);
+    c->bl_qr_pct        = APP_BL_QR_PCT;
+    c->bl_day_pct       = APP_BL_IDLE_DAY_PCT;
+    c->bl_night_pct     = APP_BL_IDLE_NIGHT_PCT;
+    c->bl_dim_pct       = APP_BL_IDLE_DIM_PCT;
+    c->bl_dim_after_s   = APP_BL_IDLE_DIM_AFTER_S;
+    c->bl_night_start_h = APP_BL_NIGHT_START_H;
+    c->bl_night_end_h   = APP_BL_NIGHT_END_H;
+    c->screensaver      = CFG_SCREENSAVER_RAIN;
+    c->quote_rotate_s   = APP_QUOTE_ROTATE_S;
+    strcpy(c->vietqr_bin,     APP_VIETQR_BIN);
+    strcpy(c->vietqr_account, APP_VIETQR_ACCOUNT);
+    strcpy(c->vietqr_note,    APP_VIETQR_NOTE);
+    strcpy(c->vietqr_name,    APP_VIETQR_NAME);
+}
+
+static bool load(app_cfg_t *c)
+{
+    nvs_handle_t h;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &h) != ESP_OK) return false;
+
+    size_t    size = sizeof(s_blob);
+    esp_err_t err  = nvs_get_blob(h, NVS_KEY, &s_blob, &size);
+    nvs_close(h);
+
+    if (err != ESP_OK || size != sizeof(s_blob) ||
+        s_blob.magic != CFG_MAGIC || s_blob.size != sizeof(app_cfg_t)) {
+        return false;
+    }
+    *c = s_blob.cfg;
+    return true;
+}
+
+static void ack(uint32_t version, const char *status, const char *err)
+{
+    char msg[160];
+    int  n;
+    if (err) {
+        n = snprintf(msg, sizeof(msg),
+                     "{\"version\":%lu,\"status\":\"%s\",\"error\":\"%s\"}",
+                     (unsigned long)version, status, err);
+    } else {
+        n = snprintf(msg, sizeof(msg),
+                     "{\"version\":%lu,\"status\":\"%s\",\"apply_us\":%lu,"
+                     "\"commit_us\":%lu,\"nvs_writes\":%lu}",
+                     (unsigned long)version, status,
+                     (unsigned long)s_stats.apply_us_last,
+                     (unsigned long)s_stats.commit_us_last,
+                     (unsigned long)s_stats.nvs_writes);
+    }
+    outbox_post(APP_MQTT_TOPIC_CONFIG_ACK, msg, n, 1, 0);
+}
+
+/* flash_sched job: one blob write and one commit for the newest
+   configuration, then the ack. */
+static void persist(void)
+{
+    int64_t t0 = esp_timer_get_time();
+    xSemaphoreTake(s_cfg_lock, portMAX_DELAY);
+    s_blob.cfg = s_cfg[s_cur];
+    xSemaphoreGive(s_cfg_lock);
+    s_blob.magic = CFG_MAGIC;
+    s_blob.size  = sizeof(app_cfg_t);
+    uint32_t version = s_blob.cfg.version;
+
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(h, NVS_KEY, &s_blob, sizeof(s_blob));
+        if (err == ESP_OK) {
+            s_stats.nvs_writes++;
+            err = nvs_commit(h);
+            if (err == ESP_OK) s_stats.nvs_commits++;
+        }
+        nvs_close(h);
+    }
+    s_stats.commit_us_last = esp_timer_get_time() - t0;
+
+    ESP_LOGI(TAG, "Config v%lu committed in %lu us (%s)",
+             (unsigned long)version, (unsigned long)s_stats.commit_us_last,
+             esp_err_to_name(err));
+    ack(version, err == ESP_OK ? "applied" : "unsaved", NULL);
+}
+
+/* ── Validation ───────────────────────────────────────────────────────── */
+
+static bool is_digits(const char *s)
+{
+    if (!*s) return false;
+    for (; *s; s++) {
+        if (!isdigit((unsigned char)*s)) return false;
+    }
+    return true;
+}
+
+static bool is_alnum(const char *s)
+{
+    if (!*s) return false;
+    for (; *s; s++) {
+        if (!isalnum((unsigned char)*s)) return false;
+    }
+    return true;
+}
+
+/* EMV "ans" data: printable ASCII only. */
+static bool is_ascii(const char *s)
+{
+    for (; *s; s++) {
+        if (*s < 0x20 || *s > 0x7E) return false;
+    }
+    return true;
+}
+
+static bool is_topic_prefix(const char *s)
+{
+    return *s && !strpbrk(s, "+#") && s[strlen(s) - 1] != '/';
+}
+
+static bool is_nonempty(const char *s)
+{
+    return *s;
+}
+
+/* Optional string @p key → @p dst.  Absent leaves dst unchanged. */
+static bool take_str(const cJSON *obj, const char *key, char *dst,
+                     size_t size, bool (*valid)(const char *))
+{
+    const cJSON *item = cJSON_GetObjectItemCaseSensitive(obj, key);
+    if (!item) return true;
+    if (!cJSON_IsString(item) || strlen(item->valuestring) >= size ||
+        (valid && !valid(item->valuestring))) {
+        s_err = key;
+        return false;
+    }
+    strcpy(dst, item->valuestring);
+    return true;
+}
+
+/* Optional integer @p key in [lo, hi] → @p out.  Absent leaves it. */
+static bool take_int(const cJSON *obj, const char *key, int lo, int hi,
+                     int *out)
+{
+    const cJSON *item = cJSON_GetObjectItemCaseSensitive(obj, key);
+    if (!item) return true;
+    if (!cJSON_IsNumber(item) || item->valuedouble != (int)item->valuedouble ||
+        item->valueint < lo || item->valueint > hi) {
+        s_err = key;
+        return false;
+    }
+    *out = item->valueint;
+    return true;
+}
+
+#define TAKE_INT(obj, key, lo, hi, field) do {                  \
+        int v_ = (field);                                       \
+        if (!take_int((obj), (key), (lo), (hi), &v_)) return false; \
+        (field) = v_;                                           \
+    } while (0)
+
+static bool take_quotes(const cJSON *root, app_cfg_t *c)
+{
+    const cJSON *arr = cJSON_GetObjectItemCaseSensitive(root, "quotes");
+    if (!arr) return true;
+
+    s_err = "quotes";
+    if (!cJSON_IsArray(arr) || cJSON_GetArraySize(arr) > CFG_QUOTES_MAX) {
+        return false;
+    }
+    int n = 0;
+    const cJSON *q;
+    cJSON_ArrayForEach(q, arr) {
+        if (!cJSON_IsString(q) || !q->valuestring[0] ||
+            strlen(q->valuestring) >= CFG_QUOTE_LEN) {
+            return false;
+        }
+        strcpy(c->quotes[n++], q->valuestring);
+    }
+    c->quote_cnt = n;
+    s_err = NULL;
+    return true;
+}
+
+/* Merge the change set into @p c; on failure s_err names the key. */
+static bool take_all(const cJSON *root, app_cfg_t *c)
+{
+    if (!take_str(root, "tz", c->tz, sizeof(c->tz), is_nonempty) ||
+        !take_str(root, "topic_prefix", c->topic_prefix,
+                  sizeof(c->topic_prefix), is_topic_prefix)) {
+        return false;
+    }
+
+    const cJSON *bl = cJSON_GetObjectItemCaseSensitive(root, "bl");
+    if (bl) {
+        if (!cJSON_IsObject(bl)) { s_err = "bl"; return false; }
+        TAKE_INT(bl, "qr",            1, 100,   c->bl_qr_pct);
+        TAKE_INT(bl, "day",           1, 100,   c->bl_day_pct);
+        TAKE_INT(bl, "night",         1, 100,   c->bl_night_pct);
+        TAKE_INT(bl, "dim",           0, 100,   c->bl_dim_pct);
+        TAKE_INT(bl, "dim_after_s",   0, 65535, c->bl_dim_after_s);
+        TAKE_INT(bl, "night_start_h", 0, 23,    c->bl_night_start_h);
+        TAKE_INT(bl, "night_end_h",   0, 23,    c->bl_night_end_h);
+    }
+
+    const cJSON *ss = cJSON_GetObjectItemCaseSensitive(root, "screensaver");
+    if (ss) {
+        if (cJSON_IsString(ss) && !strcmp(ss->valuestring, "rain")) {
+            c->screensaver = CFG_SCREENSAVER_RAIN;
+        } else if (cJSON_IsString(ss) && !strcmp(ss->valuestring, "plain")) {
+            c->screensaver = CFG_SCREENSAVER_PLAIN;
+        } else {
+            s_err = "screensaver";
+            return false;
+        }
+    }
+
+    TAKE_INT(root, "quote_rotate_s", 2, 3600, c->quote_rotate_s);
+    if (!take_quotes(root, c)) return false;
+
+    const cJSON *vq = cJSON_GetObjectItemCaseSensitive(root, "vietqr");
+    if (vq) {
+        if (!cJSON_IsObject(vq)) { s_err = "vietqr"; return false; }
+        if (!take_str(vq, "bin", c->vietqr_bin, sizeof(c->vietqr_bin),
+                      is_digits) ||
+            !take_str(vq, "account", c->vietqr_account,
+                      sizeof(c->vietqr_account), is_alnum) ||
+            !take_str(vq, "note", c->vietqr_note, sizeof(c->vietqr_note),
+                      is_ascii) ||
+            !take_str(vq, "name", c->vietqr_name, sizeof(c->vietqr_name),
+                      NULL)) {
+            return false;
+        }
+        if (strlen(c->vietqr_bin) != 6) { s_err = "bin"; return false; }
+    }
+    return true;
+}
+
+/* ── Change sets ──────────────────────────────────────────────────────── */
+
+static void on_config(const char *data, int len)
+{
+    int64_t t0 = esp_timer_get_time();
+    const app_cfg_t *cur = &s_cfg[s_cur];
+    app_cfg_t       *nxt = &s_cfg[!s_cur];
+    uint32_t version = 0;
+
+    s_err = NULL;
+    cJSON *root = cJSON_ParseWithLength(data, len);
+    const cJSON *ver = cJSON_GetObjectItemCaseSensitive(root, "version");
+    if (cJSON_IsNumber(ver) && ver->valuedouble == cur->version) {
+        ESP_LOGD(TAG, "Config v%lu already applied",
+                 (unsigned long)cur->version);
+        cJSON_Delete(root);
+        return;
+    }
+    if (!root) {
+        s_err = "json";
+    } else if (!cJSON_IsNumber(ver) || ver->valuedouble <= cur->version ||
+               ver->valuedouble > UINT32_MAX) {
+        s_err = "version";
+    } else {
+        version = (uint32_t)ver->valuedouble;
+        xSemaphoreTake(s_cfg_lock, portMAX_DELAY);
+        *nxt = *cur;
+        if (take_all(root, nxt)) nxt->version = version;
+        xSemaphoreGive(s_cfg_lock);
+    }
+    cJSON_Delete(root);
+
+    if (s_err) {
+        s_stats.rejected++;
+        ESP_LOGW(TAG, "Change set rejected: \"%s\"", s_err);
+        ack(version, "rejected", s_err);
+        return;
+    }
+
+    /* Flip, then apply what does not pick the change up by itself. */
+    bool tz_changed     = strcmp(nxt->tz, cur->tz) != 0;
+    bool prefix_changed = strcmp(nxt->topic_prefix, cur->topic_prefix) != 0;
+    s_cur = !s_cur;
+    s_gen++;
+    if (tz_changed) time_service_set_tz(nxt->tz);
+    if (prefix_changed) mqtt_service_set_topic_prefix(nxt->topic_prefix);
+
+    s_stats.applied++;
+    s_stats.apply_us_last = esp_timer_get_time() - t0;
+    ESP_LOGI(TAG, "Config v%lu applied in %lu us", (unsigned long)version,
+             (unsigned long)s_stats.apply_us_last);
+    flash_sched_post(FLASH_JOB_CONFIG, persist);
+}
+
+/* ── Public API ───────────────────────────────────────────────────────── */
+
+esp_err_t config_service_init(void)
+{
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES ||
+        ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        ret = nvs_flash_init();
+    }
+    ESP_RETURN_ON_ERROR(ret, TAG, "NVS init failed");
+
+    s_cfg_lock = xSemaphoreCreateMutex();
+    ESP_RETURN_ON_FALSE(s_cfg_lock, ESP_ERR_NO_MEM, TAG, "mutex alloc failed");
+
+    if (load(&s_cfg[0])) {
+        ESP_LOGI(TAG, "Config v%lu loaded", (unsigned long)s_cfg[0].version);
+    } else {
+        set_defaults(&s_cfg[0]);
+        ESP_LOGI(TAG, "No stored config – using defaults");
+    }
+    s_cur = 0;
+    return ESP_OK;
+}
+
+esp_err_t config_service_register(void)
+{
+    ESP_RETURN_ON_ERROR(mqtt_service_set_topic_prefix(s_cfg[s_cur].topic_prefix),
+                        TAG, "stored topic prefix rejected");
+    return mqtt_service_register_handler(APP_MQTT_TOPIC_CONFIG, on_config);
+}
+
+const app_cfg_t *config_service_get(void)
+{
+    return &s_cfg[s_cur];
+}
+
+uint32_t config_service_get_gen(void)
+{
+    return s_gen;
+}
+
+void config_service_get_stats(config_stats_t *out)
+{
+    *out = s_stats;
+}
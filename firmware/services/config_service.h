@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#define CFG_TZ_LEN          32
+#define CFG_QUOTES_MAX      16
+#define CFG_QUOTE_LEN       96
+#define CFG_PREFIX_LEN      24
+
+enum {
+    CFG_SCREENSAVER_RAIN  = 0,      /* flip clock over the rain scene      */
+    CFG_SCREENSAVER_PLAIN = 1,      /* flip clock on black                 */
+};
+
+/**
+ * Runtime configuration.  Defaults come from app_config.h; a change set
+ * pushed on APP_MQTT_TOPIC_CONFIG replaces any subset of the fields.
+ */
+typedef struct {
+    uint32_t version;               /* of the last accepted change set     */
+    char     tz[CFG_TZ_LEN];        /* POSIX TZ string                     */
+    char     topic_prefix[CFG_PREFIX_LEN];  /* command topics: <p>/qr/...  */
+
+    /* Brightness policy, percent / seconds / local hours */
+    uint8_t  bl_qr_pct, bl_day_pct, bl_night_pct, bl_dim_pct;
+    uint16_t bl_dim_after_s;
+    uint8_t  bl_night_start_h, bl_night_end_h;
+
+    /* Idle screen */
+    uint8_t  screensaver;           /* CFG_SCREENSAVER_*                   */
+    uint16_t quote_rotate_s;
+    uint8_t  quote_cnt;             /* 0 = built-in quotes                 */
+    char     quotes[CFG_QUOTES_MAX][CFG_QUOTE_LEN];
+
+    /* Static VietQR shown on tap */
+    char     vietqr_bin[8];         /* bank BIN, e.g. "970422"             */
+    char     vietqr_account[20];
+    char     vietqr_note[26];       /* EMV tag 62.08                       */
+    char     vietqr_name[48];       /* caption under the code              */
+} app_cfg_t;
+
+/** Configuration store counters (monotonic since boot). */
+typedef struct {
+    uint32_t applied;
+    uint32_t rejected;
+    uint32_t nvs_writes;            /* blob writes – one per change set    */
+                                    /* (or run of them, see flash_sched)   */
+    uint32_t nvs_commits;
+    uint32_t apply_us_last;         /* parse + validate + apply            */
+    uint32_t commit_us_last;        /* NVS write + commit                  */
+} config_stats_t;
+
+/**
+ * Initialise NVS and load the stored configuration (defaults if none or
+ * if the stored layout is from another firmware).  Call first in
+ * app_main – the UI and services read the configuration while starting.
+ */
+esp_err_t config_service_init(void);
+
+/**
+ * Register the APP_MQTT_TOPIC_CONFIG handler.  Call before
+ * mqtt_service_init().
+ */
+esp_err_t config_service_register(void);
+
+/**
+ * Current configuration.  The pointer stays valid, but its contents may
+ * change with the next accepted change set – read fields promptly and
+ * copy strings that must outlive the call.
+ */
+const app_cfg_t *config_service_get(void);
+
+/**
+ * Incremented on every applied change set; consumers that cache derived
+ * state (the idle screen) compare it to rebuild.
+ */
+uint32_t config_service_get_gen(void);
+
+/**
+ * Copy the counters into @p out.
+ */
+void config_service_get_stats(config_stats_t *out);
@@ -0,0 +1,153 @@
+/*
+ * Event bus – typed state transitions from the services to the tasks
+ * that react to them, instead of flags polled every loop.
+ *
+ * Each subscriber owns a fixed queue of APP_EVENT_QUEUE_LEN events in
+ * its own slot array: nothing is allocated after boot.  A queue has many
+ * producers (WiFi event loop, lwIP, MQTT task, …) and one consumer, and
+ * is lock-free – a bounded ring where every slot carries a sequence
+ * number:
+ *
+ *   producer  claims a position with a CAS on `head`, fills the slot,
+ *             then publishes it by storing seq = pos + 1 (release);
+ *   consumer  takes the slot at `tail` once seq == tail + 1 (acquire)
+ *             and hands it back with seq = tail + LEN.
+ *
+ * A full queue drops the new event and sets `lost`; the subscriber gets
+ * one EV_OVERFLOW once it has drained the queue and re-reads the state
+ * from the services' getters – so no edge goes unnoticed.
+ *
+ * Every event carries its publish time; event_bus_get() measures the
+ * dispatch latency per subscriber.
+ */
+
+#include "event_bus.h"
+#include "app_config.h"
+
+#include <stdatomic.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *TAG = "event_bus";
+
+#define QLEN    APP_EVENT_QUEUE_LEN
+#define QMASK   (QLEN - 1)
+
+_Static_assert((QLEN & QMASK) == 0, "APP_EVENT_QUEUE_LEN: power of two");
+
+typedef struct {
+    atomic_uint seq;
+    event_t     ev;
+} slot_t;
+
+typedef struct {
+    uint32_t          mask;
+    TaskHandle_t      task;
+    atomic_uint       head;         /* next position to claim (producers) */
+    uint32_t          tail;         /* next position to take (consumer)   */
+    atomic_bool       lost;
+    atomic_uint       dropped;      /* producers count concurrently       */
+    slot_t            slot[QLEN];
+    event_sub_stats_t stats;
+} sub_t;
+
+static sub_t        s_sub[APP_EVENT_SUB_MAX];
+static atomic_int   s_sub_cnt;
+static portMUX_TYPE s_sub_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static bool push(sub_t *q, const event_t *ev)
+{
+    uint32_t pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+    for (;;) {
+        slot_t  *s   = &q->slot[pos & QMASK];
+        uint32_t seq = atomic_load_explicit(&s->seq, memory_order_acquire);
+        int32_t  dif = (int32_t)(seq - pos);
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(
+                    &q->head, &pos, pos + 1,
+                    memory_order_relaxed, memory_order_relaxed)) {
+                s->ev = *ev;
+                atomic_store_explicit(&s->seq, pos + 1, memory_order_release);
+                return true;
+            }
+        } else if (dif < 0) {
+            return false;                       /* full */
+        } else {
+            pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+        }
+    }
+}
+
+/* ── Public API ───────────────────────────────────────────────────────── */
+
+event_sub_t event_bus_subscribe(uint32_t mask, TaskHandle_t task)
+{
+    taskENTER_CRITICAL(&s_sub_mux);
+    int i = atomic_load(&s_sub_cnt);
+    if (i < APP_EVENT_SUB_MAX) {
+        sub_t *q = &s_sub[i];
+        q->mask = mask;
+        q->task = task;
+        for (uint32_t k = 0; k < QLEN; k++) atomic_init(&q->slot[k].seq, k);
+        atomic_store(&s_sub_cnt, i + 1);    /* visible to publishers now */
+    } else {
+        i = -1;
+    }
+    taskEXIT_CRITICAL(&s_sub_mux);
+
+    if (i < 0) ESP_LOGE(TAG, "APP_EVENT_SUB_MAX reached");
+    return i;
+}
+
+void event_bus_publish(event_type_t type, uint32_t arg)
+{
+    event_t ev = {
+        .type = type,
+        .arg  = arg,
+        .t_us = esp_timer_get_time(),
+    };
+    int n = atomic_load(&s_sub_cnt);
+    for (int i = 0; i < n; i++) {
+        sub_t *q = &s_sub[i];
+        if (!(q->mask & EV_BIT(type))) continue;
+        if (!push(q, &ev)) {
+            atomic_store(&q->lost, true);
+            atomic_fetch_add_explicit(&q->dropped, 1, memory_order_relaxed);
+        }
+        if (q->task) xTaskNotifyGive(q->task);
+    }
+}
+
+bool event_bus_get(event_sub_t sub, event_t *out)
+{
+    if (sub < 0) return false;
+    sub_t   *q = &s_sub[sub];
+    slot_t  *s = &q->slot[q->tail & QMASK];
+
+    if (atomic_load_explicit(&s->seq, memory_order_acquire) != q->tail + 1) {
+        /* Drained: report a loss now, after everything older. */
+        if (!atomic_exchange(&q->lost, false)) return false;
+        *out = (event_t){ .type = EV_OVERFLOW, .t_us = esp_timer_get_time() };
+        return true;
+    }
+    *out = s->ev;
+    atomic_store_explicit(&s->seq, q->tail + QLEN, memory_order_release);
+    q->tail++;
+
+    uint32_t us = esp_timer_get_time() - out->t_us;
+    q->stats.delivered++;
+    q->stats.lat_us_last = us;
+    if (us > q->stats.lat_us_max) q->stats.lat_us_max = us;
+    return true;
+}
+
+void event_bus_get_stats(event_sub_t sub, event_sub_stats_t *out)
+{
+    if (sub < 0) {
+        *out = (event_sub_stats_t){0};
+        return;
+    }
+    *out = s_sub[sub].stats;
+    out->dropped = atomic_load(&s_sub[sub].dropped);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/* State transitions published by the services */
+typedef enum {
+    EV_WIFI_UP,
+    EV_WIFI_DOWN,
+    EV_TIME_VALID,              /* first SNTP sync                        */
+    EV_MQTT_UP,                 /* arg: broker index                      */
+    EV_MQTT_DOWN,
+    EV_QR_SHOW,                 /* arg: mqtt_service_get_qr_gen()         */
+    EV_QR_HIDE,
+    EV_QR_RESULT,               /* arg: POS_BIN_STATUS_*, 0xFF unknown    */
+    EV_OVERFLOW,                /* not published: events were lost, read  */
+                                /* the state back from the services       */
+    EV_CNT
+} event_type_t;
+
+#define EV_BIT(t)   (1u << (t))
+
+typedef struct {
+    event_type_t type;
+    uint32_t     arg;
+    int64_t      t_us;          /* esp_timer time of event_bus_publish()  */
+} event_t;
+
+typedef int event_sub_t;        /* subscriber index, < 0 if none          */
+
+/** Per-subscriber counters (monotonic since boot). */
+typedef struct {
+    uint32_t delivered;
+    uint32_t dropped;           /* queue full – reported as EV_OVERFLOW   */
+    uint32_t lat_us_last;       /* publish → event_bus_get()              */
+    uint32_t lat_us_max;
+} event_sub_stats_t;
+
+/**
+ * Add a subscriber for the events in @p mask (EV_BIT()s).  If @p task is
+ * not NULL it gets an xTaskNotifyGive() per delivered event, so it can
+ * block in ulTaskNotifyTake() instead of polling.  Subscribers are never
+ * removed.  Returns -1 when APP_EVENT_SUB_MAX are in use.
+ */
+event_sub_t event_bus_subscribe(uint32_t mask, TaskHandle_t task);
+
+/**
+ * Queue an event for every subscriber of @p type.  Lock-free: one
+ * pre-allocated slot per subscriber queue, no blocking, safe from any
+ * task (not from an ISR).
+ */
+void event_bus_publish(event_type_t type, uint32_t arg);
+
+/**
+ * Take the oldest event of @p sub, from its owner task only.  Once the
+ * queue is drained after a loss, returns a single EV_OVERFLOW.  False if
+ * there is nothing.
+ */
+bool event_bus_get(event_sub_t sub, event_t *out);
+
+/**
+ * Copy the counters of @p sub into @p out.
+ */
+void event_bus_get_stats(event_sub_t sub, event_sub_stats_t *out);
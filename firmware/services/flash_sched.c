@@ -0,0 +1,198 @@
+/*
+ * Flash-write scheduler – keeps flash writes and erases away from the
+ * moments the customer is looking at the screen.
+ *
+ * While the SPI flash is written the caches are off: the scan-out refill
+ * cannot read the PSRAM framebuffer and the LVGL task cannot run from
+ * flash, so an erase (tens of ms) shows as a torn frame or a frozen QR
+ * animation.  Every writer of this firmware goes through one gate:
+ *
+ *   flash_sched_begin() / _end()   around each partition write or erase
+ *                                  (outbox segments, journal pages);
+ *   flash_sched_post()             NVS updates (active QR, configuration)
+ *                                  as coalescing jobs run by our task.
+ *
+ * The gate serialises all of them and holds each operation
+ *   - always, while a QR show or hide is under way (APP_FLASH_QUIET_MS
+ *     after flash_sched_note_transition()),
+ *   - while a QR is on screen, for up to APP_FLASH_DEFER_MAX_MS, after
+ *     which it runs right behind a scan-out frame boundary,
+ *   - not at all on the idle screen or with the panel asleep.
+ * Writers already cut their work into small pieces (a page, a segment, a
+ * sector erase), so a held-back backlog drains in short bursts.
+ *
+ * The time spent inside each operation is its stall; per-client totals
+ * and maxima are kept, and stalls over APP_FLASH_STALL_WARN_US are
+ * logged.
+ */
+
+#include "flash_sched.h"
+#include "lcd_scanout.h"
+#include "app_config.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+
+static const char *TAG = "flash_sched";
+
+static const char *const CL_NAME[FLASH_CL_CNT] = {
+    [FLASH_CL_NVS]     = "nvs",
+    [FLASH_CL_OUTBOX]  = "outbox",
+    [FLASH_CL_JOURNAL] = "journal",
+};
+
+static SemaphoreHandle_t   s_lock;          /* one flash operation at a time */
+static TaskHandle_t        s_task;
+static portMUX_TYPE        s_mux = portMUX_INITIALIZER_UNLOCKED;
+static flash_job_fn_t      s_job_fn[FLASH_JOB_CNT];
+static uint32_t            s_job_pending;   /* bit per flash_job_t        */
+static volatile int64_t    s_quiet_until;   /* us, esp_timer time         */
+static volatile bool       s_qr_visible;
+static int64_t             s_t0;            /* start of the current op    */
+static flash_sched_stats_t s_stats;
+
+/* ── Gate ─────────────────────────────────────────────────────────────── */
+
+/* Wait until the next scan-out frame starts (bounded, a frame is ~17 ms). */
+static void wait_frame_edge(void)
+{
+    lcd_scanout_stats_t st;
+    lcd_scanout_get_stats(&st);
+    uint32_t frame = st.frames;
+    for (int i = 0; i < 40; i++) {
+        vTaskDelay(1);
+        lcd_scanout_get_stats(&st);
+        if (st.frames != frame) return;
+    }
+}
+
+void flash_sched_begin(flash_client_t cl)
+{
+    if (!s_lock) return;                    /* before init: no display yet */
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+
+    int64_t start    = esp_timer_get_time();
+    int64_t deadline = start + APP_FLASH_DEFER_MAX_MS * 1000LL;
+    bool    held_tr = false, held_qr = false;
+
+    for (;;) {
+        int64_t now = esp_timer_get_time();
+        if (now < s_quiet_until) {
+            held_tr = true;
+            vTaskDelay(pdMS_TO_TICKS((s_quiet_until - now) / 1000) + 1);
+            continue;
+        }
+        if (!s_qr_visible) break;
+        if (now >= deadline) {
+            s_stats.forced++;
+            wait_frame_edge();
+            break;
+        }
+        held_qr = true;
+        vTaskDelay(pdMS_TO_TICKS(APP_FLASH_POLL_MS));
+    }
+
+    s_t0 = esp_timer_get_time();
+    uint32_t wait_ms = (s_t0 - start) / 1000;
+    if (held_tr) s_stats.held_transition++;
+    if (held_qr) s_stats.held_qr++;
+    if (wait_ms > s_stats.cl[cl].wait_ms_max) {
+        s_stats.cl[cl].wait_ms_max = wait_ms;
+    }
+}
+
+void flash_sched_end(flash_client_t cl)
+{
+    if (!s_lock) return;
+    uint32_t us = esp_timer_get_time() - s_t0;
+    flash_client_stats_t *c = &s_stats.cl[cl];
+    c->ops++;
+    c->stall_us_last   = us;
+    c->stall_us_total += us;
+    if (us > c->stall_us_max) c->stall_us_max = us;
+    xSemaphoreGive(s_lock);
+
+    if (us > APP_FLASH_STALL_WARN_US) {
+        ESP_LOGW(TAG, "%s: flash busy for %lu us%s", CL_NAME[cl],
+                 (unsigned long)us, s_qr_visible ? " with a QR up" : "");
+    }
+}
+
+/* ── Deferred jobs ────────────────────────────────────────────────────── */
+
+void flash_sched_post(flash_job_t slot, flash_job_fn_t fn)
+{
+    bool queued;
+    taskENTER_CRITICAL(&s_mux);
+    queued = s_job_pending & (1u << slot);
+    s_job_fn[slot]  = fn;
+    s_job_pending  |= 1u << slot;
+    if (queued) s_stats.jobs_coalesced++;
+    taskEXIT_CRITICAL(&s_mux);
+
+    if (!queued && s_task) xTaskNotifyGive(s_task);
+}
+
+static void sched_task(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        for (int slot = 0; slot < FLASH_JOB_CNT; slot++) {
+            if (!(s_job_pending & (1u << slot))) continue;
+
+            /* Only this task clears a bit: wait for the gate first, so
+               posts arriving meanwhile coalesce into this run. */
+            flash_sched_begin(FLASH_CL_NVS);
+            taskENTER_CRITICAL(&s_mux);
+            s_job_pending &= ~(1u << slot);
+            flash_job_fn_t fn = s_job_fn[slot];
+            taskEXIT_CRITICAL(&s_mux);
+
+            fn();
+            s_stats.jobs_run++;
+            flash_sched_end(FLASH_CL_NVS);
+        }
+    }
+}
+
+/* ── Display state ────────────────────────────────────────────────────── */
+
+void flash_sched_note_transition(void)
+{
+    s_quiet_until = esp_timer_get_time() + APP_FLASH_QUIET_MS * 1000LL;
+}
+
+void flash_sched_set_qr_visible(bool visible)
+{
+    s_qr_visible = visible;
+}
+
+/* ── Public API ───────────────────────────────────────────────────────── */
+
+esp_err_t flash_sched_init(void)
+{
+    s_lock = xSemaphoreCreateMutex();
+    ESP_RETURN_ON_FALSE(s_lock, ESP_ERR_NO_MEM, TAG, "no memory for lock");
+
+    BaseType_t ok = xTaskCreate(sched_task, "flash_sched",
+                                APP_FLASH_TASK_STACK, NULL,
+                                APP_FLASH_TASK_PRIO, &s_task);
+    ESP_RETURN_ON_FALSE(ok == pdPASS, ESP_ERR_NO_MEM, TAG,
+                        "task create failed");
+
+    /* Jobs posted before the task existed */
+    if (s_job_pending) xTaskNotifyGive(s_task);
+    return ESP_OK;
+}
+
+void flash_sched_get_stats(flash_sched_stats_t *out)
+{
+    *out = s_stats;
+}
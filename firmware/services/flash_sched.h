@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/* Who is writing – for the per-client stall statistics */
+typedef enum {
+    FLASH_CL_NVS,               /* deferred NVS jobs (config, QR, auth)   */
+    FLASH_CL_OUTBOX,
+    FLASH_CL_JOURNAL,
+    FLASH_CL_CNT
+} flash_client_t;
+
+/* Deferred jobs: one slot each, so re-posting a pending job coalesces */
+typedef enum {
+    FLASH_JOB_QR_STATE,
+    FLASH_JOB_CONFIG,
+    FLASH_JOB_AUTH_SEQ,
+    FLASH_JOB_CNT
+} flash_job_t;
+
+typedef void (*flash_job_fn_t)(void);
+
+/** Per-client counters (monotonic since boot). */
+typedef struct {
+    uint32_t ops;               /* begin/end pairs                        */
+    uint32_t stall_us_last;     /* duration of the flash operation        */
+    uint32_t stall_us_max;
+    uint64_t stall_us_total;
+    uint32_t wait_ms_max;       /* held back by the display policy        */
+} flash_client_stats_t;
+
+typedef struct {
+    flash_client_stats_t cl[FLASH_CL_CNT];
+    uint32_t jobs_run;
+    uint32_t jobs_coalesced;    /* posts absorbed by a pending job        */
+    uint32_t held_transition;   /* operations that waited out a QR switch */
+    uint32_t held_qr;           /* ... that waited for the idle screen    */
+    uint32_t forced;            /* ran on a QR screen after the deadline  */
+} flash_sched_stats_t;
+
+/**
+ * Start the scheduler task.  Call before any service that writes flash.
+ */
+esp_err_t flash_sched_init(void);
+
+/**
+ * Gate one flash operation (a write or an erase of at most a sector).
+ * Blocks until the display allows it:
+ *   - never during a QR show / hide transition (APP_FLASH_QUIET_MS),
+ *   - while a QR is on screen, up to APP_FLASH_DEFER_MAX_MS, then
+ *     aligned to a scan-out frame boundary,
+ *   - at once on the idle screen or with the panel asleep.
+ * Operations of all clients are serialised.  Never call from the LVGL or
+ * MQTT task – use flash_sched_post() there.
+ */
+void flash_sched_begin(flash_client_t cl);
+
+/**
+ * End the operation started with flash_sched_begin(); records its
+ * duration as the stall.
+ */
+void flash_sched_end(flash_client_t cl);
+
+/**
+ * Run @p fn in the scheduler task once the gate allows (it is wrapped in
+ * flash_sched_begin/end(FLASH_CL_NVS)).  A job already pending in @p slot
+ * is not queued twice: @p fn should write the state current when it runs,
+ * so a show quickly followed by a hide costs nothing.  Non-blocking.
+ */
+void flash_sched_post(flash_job_t slot, flash_job_fn_t fn);
+
+/**
+ * Display state, from the LVGL task: a QR show or hide has just been
+ * started (opens the quiet window) ...
+ */
+void flash_sched_note_transition(void);
+
+/**
+ * ... and whether a QR is currently on screen (false with the panel
+ * asleep).
+ */
+void flash_sched_set_qr_visible(bool visible);
+
+/**
+ * Copy the counters into @p out.
+ */
+void flash_sched_get_stats(flash_sched_stats_t *out);
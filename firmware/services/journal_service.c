@@ -0,0 +1,520 @@
+/*
+ * Transaction journal – an append-only record of every show, hide,
+ * result and dismiss for reconciliation and dispute handling.
+ *
+ * journal_log() fills a fixed 64-byte record in a RAM batch and returns.
+ * The journal task writes the batch to the "journal" partition once a
+ * flash page (256 B, four records) is full, or after APP_JOURNAL_FLUSH_MS
+ * of quiet – so NVS is never involved and a busy counter costs one page
+ * program per four events.  A power cut loses at most that idle window.
+ *
+ * Flash layout: a ring of 4 KB sectors, 64 record slots each, filled in
+ * sequence order.  A sector is erased only when the write position wraps
+ * onto it, so every sector is erased once per lap (wear levelling by
+ * construction) and the oldest records are the ones overwritten.  Each
+ * record carries a sequence number and a CRC; an erased slot reads as
+ * seq 0xFFFFFFFF.
+ *
+ * Time index: one RAM entry per sector with its first sequence number,
+ * record count and lowest / highest timestamp, rebuilt at boot from the
+ * first and last record of each sector.  A range query only reads the
+ * sectors whose span overlaps it.  Records logged before SNTP carry ts 0
+ * and only match queries starting at 0.
+ *
+ * Range query on APP_MQTT_TOPIC_JOURNAL_GET:
+ *   {"id":n,"from":ts,"to":ts,"max":n}       all fields optional
+ * streamed on APP_MQTT_TOPIC_JOURNAL_DATA as publishes of newline
+ * separated JSON records, oldest first:
+ *   {"seq":n,"ts":n,"up":s,"ev":"show","arg":n,"qr":"crc32",
+ *    "amount":"..","desc":".."}
+ * and closed by
+ *   {"id":n,"done":true,"count":n,"sectors":n,"ms":n}
+ */
+
+#include "journal_service.h"
+#include "flash_sched.h"
+#include "time_service.h"
+#include "app_config.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "esp_system.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "cJSON.h"
+
+static const char *TAG = "journal";
+
+#define SECTOR          4096
+#define PAGE            256
+#define SEQ_ERASED      0xFFFFFFFFu
+#define PEND_MAX        16              /* RAM batch, four pages         */
+
+typedef struct __attribute__((packed)) {
+    uint32_t seq;
+    uint32_t ts;            /* unix seconds, 0 before SNTP               */
+    uint32_t up_s;          /* uptime                                    */
+    uint8_t  type;          /* journal_ev_t                              */
+    uint8_t  arg;
+    uint16_t rsvd;
+    uint32_t qr_crc;        /* CRC-32 of qr_data, 0 if none              */
+    char     amount[16];
+    char     desc[24];      /* truncated                                 */
+    uint32_t crc;           /* over everything above                     */
+} rec_t;
+
+_Static_assert(sizeof(rec_t) == 64, "journal record must stay 64 bytes");
+
+#define REC_PER_SEC     (SECTOR / sizeof(rec_t))
+#define REC_PER_PAGE    (PAGE / sizeof(rec_t))
+
+typedef struct {
+    uint32_t first_seq;
+    uint16_t count;         /* 0 = empty sector                          */
+    bool     untimed;       /* holds records with ts 0                   */
+    uint32_t ts_min, ts_max;
+} sec_idx_t;
+
+static const esp_partition_t *s_part;
+static uint32_t          s_nsec;
+static sec_idx_t        *s_idx;
+static uint32_t          s_wr;          /* next slot, partition-wide     */
+static int               s_wr_sec = -1; /* sector erased for appending   */
+static uint32_t          s_seq = 1;
+
+static SemaphoreHandle_t s_lock;        /* RAM batch + s_seq + stats     */
+static TaskHandle_t      s_task;
+static rec_t             s_pend[PEND_MAX];
+static int               s_pend_cnt;
+static rec_t             s_out[PEND_MAX];
+
+static EXT_RAM_BSS_ATTR rec_t s_sec_buf[REC_PER_SEC];
+static EXT_RAM_BSS_ATTR char  s_stream[APP_JOURNAL_STREAM_BYTES];
+
+static struct {
+    bool     pending;
+    uint32_t id, from, to, max;
+} s_query;
+
+static journal_stats_t   s_stats;
+
+static const char *const EV_NAME[] = {
+    "?", "boot", "show", "hide", "result", "dismiss", "restore",
+};
+
+/* ── Records ──────────────────────────────────────────────────────────── */
+
+static uint32_t rec_crc(const rec_t *r)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)r, offsetof(rec_t, crc));
+}
+
+static bool rec_valid(const rec_t *r)
+{
+    return r->seq != SEQ_ERASED && r->crc == rec_crc(r);
+}
+
+static bool rec_erased(const rec_t *r)
+{
+    const uint8_t *b = (const uint8_t *)r;
+    for (size_t i = 0; i < sizeof(*r); i++) {
+        if (b[i] != 0xFF) return false;
+    }
+    return true;
+}
+
+static void idx_add(sec_idx_t *e, const rec_t *r)
+{
+    if (!e->count) {
+        e->first_seq = r->seq;
+        e->untimed   = false;
+        e->ts_min    = UINT32_MAX;
+        e->ts_max    = 0;
+    }
+    e->count++;
+    if (!r->ts) {
+        e->untimed = true;
+        return;
+    }
+    if (r->ts < e->ts_min) e->ts_min = r->ts;
+    if (r->ts > e->ts_max) e->ts_max = r->ts;
+}
+
+static void update_range(void)
+{
+    uint32_t stored = 0, oldest = 0;
+    bool     any = false;
+    for (uint32_t i = 0; i < s_nsec; i++) {
+        if (!s_idx[i].count) continue;
+        stored += s_idx[i].count;
+        if (!any || (int32_t)(s_idx[i].first_seq - oldest) < 0) {
+            oldest = s_idx[i].first_seq;
+        }
+        any = true;
+    }
+    s_stats.stored     = stored;
+    s_stats.oldest_seq = oldest;
+    s_stats.newest_seq = any ? s_seq - 1 : 0;
+}
+
+/* ── Flash ring ───────────────────────────────────────────────────────── */
+
+static bool read_slot(uint32_t slot, rec_t *r)
+{
+    return esp_partition_read(s_part, slot * sizeof(rec_t), r,
+                              sizeof(*r)) == ESP_OK;
+}
+
+/* Rebuild the index from the first and last record of each sector; the
+   sector holding the newest record is scanned for the write position. */
+static void recover(void)
+{
+    int      head = -1;
+    uint32_t newest = 0;
+
+    for (uint32_t sec = 0; sec < s_nsec; sec++) {
+        rec_t first, last;
+        uint32_t base = sec * REC_PER_SEC;
+        if (!read_slot(base, &first) || !rec_valid(&first)) continue;
+
+        sec_idx_t *e = &s_idx[sec];
+        idx_add(e, &first);
+        if (read_slot(base + REC_PER_SEC - 1, &last) && rec_valid(&last)) {
+            /* Full sector: first and last bound it (ts is monotonic
+               except across an SNTP step). */
+            e->count = REC_PER_SEC - 1;
+            idx_add(e, &last);
+        } else {
+            e->count = 0;                   /* partial: scanned below */
+        }
+        if (head < 0 || (int32_t)(first.seq - newest) > 0) {
+            head   = sec;
+            newest = first.seq;
+        }
+    }
+    if (head < 0) return;                   /* empty: s_wr = 0, unerased */
+
+    /* Head sector: walk it for the exact count, span and end. */
+    sec_idx_t *e = &s_idx[head];
+    esp_partition_read(s_part, head * SECTOR, s_sec_buf, SECTOR);
+    memset(e, 0, sizeof(*e));
+    uint32_t end = 0;
+    for (uint32_t i = 0; i < REC_PER_SEC; i++) {
+        if (rec_valid(&s_sec_buf[i])) {
+            idx_add(e, &s_sec_buf[i]);
+            newest = s_sec_buf[i].seq;
+        }
+        if (!rec_erased(&s_sec_buf[i])) end = i + 1;
+    }
+    s_seq = newest + 1;
+    if (end < REC_PER_SEC) {
+        s_wr     = head * REC_PER_SEC + end;
+        s_wr_sec = head;
+    } else {
+        s_wr = (head + 1) % s_nsec * REC_PER_SEC;
+    }
+
+    /* Partial sectors other than the head are torn leftovers – count
+       them properly too. */
+    for (uint32_t sec = 0; sec < s_nsec; sec++) {
+        if ((int)sec == head || s_idx[sec].count || !s_idx[sec].first_seq) {
+            continue;
+        }
+        esp_partition_read(s_part, sec * SECTOR, s_sec_buf, SECTOR);
+        memset(&s_idx[sec], 0, sizeof(s_idx[sec]));
+        for (uint32_t i = 0; i < REC_PER_SEC; i++) {
+            if (rec_valid(&s_sec_buf[i])) idx_add(&s_idx[sec], &s_sec_buf[i]);
+        }
+    }
+}
+
+/* Write @p n records from s_out, at most one page per flash write. */
+static void write_batch(int n)
+{
+    int i = 0;
+    while (i < n) {
+        uint32_t sec = s_wr / REC_PER_SEC;
+        if ((int)sec != s_wr_sec) {
+            /* Entering a sector: its oldest records go. */
+            flash_sched_begin(FLASH_CL_JOURNAL);
+            esp_err_t err = esp_partition_erase_range(s_part, sec * SECTOR,
+                                                      SECTOR);
+            flash_sched_end(FLASH_CL_JOURNAL);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "erase of sector %lu failed",
+                         (unsigned long)sec);
+                return;
+            }
+            memset(&s_idx[sec], 0, sizeof(s_idx[sec]));
+            s_stats.flash_erases++;
+            s_wr_sec = sec;
+        }
+
+        int room = REC_PER_PAGE - s_wr % REC_PER_PAGE;
+        int k    = n - i < room ? n - i : room;
+        flash_sched_begin(FLASH_CL_JOURNAL);
+        esp_err_t err = esp_partition_write(s_part, s_wr * sizeof(rec_t),
+                                            &s_out[i], k * sizeof(rec_t));
+        flash_sched_end(FLASH_CL_JOURNAL);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "write at slot %lu failed", (unsigned long)s_wr);
+            return;
+        }
+        s_stats.flash_writes++;
+        for (int j = 0; j < k; j++) idx_add(&s_idx[sec], &s_out[i + j]);
+
+        i    += k;
+        s_wr += k;
+        if (s_wr % REC_PER_SEC == 0) s_wr %= s_nsec * REC_PER_SEC;
+    }
+}
+
+static void flush(void)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int n = s_pend_cnt;
+    memcpy(s_out, s_pend, n * sizeof(rec_t));
+    s_pend_cnt = 0;
+    xSemaphoreGive(s_lock);
+
+    if (!n) return;
+    write_batch(n);
+    update_range();
+}
+
+/* ── Range query ──────────────────────────────────────────────────────── */
+
+/* Copy @p src into @p dst for a JSON string: quotes, backslashes and
+   control characters become '?'. */
+static void json_safe(char *dst, const char *src, size_t n)
+{
+    size_t i = 0;
+    for (; i < n && src[i]; i++) {
+        char c = src[i];
+        dst[i] = (c == '"' || c == '\\' || (unsigned char)c < 0x20) ? '?' : c;
+    }
+    dst[i] = '\0';
+}
+
+static bool publish_stream(size_t len)
+{
+    while (mqtt_service_get_outbox_bytes() > APP_OUTBOX_MQTT_HIGH_BYTES) {
+        if (!mqtt_service_is_connected()) return false;
+        vTaskDelay(pdMS_TO_TICKS(20));
+    }
+    return mqtt_service_publish(APP_MQTT_TOPIC_JOURNAL_DATA, s_stream, len,
+                                1, false) == ESP_OK;
+}
+
+static bool in_range(const rec_t *r, uint32_t from, uint32_t to)
+{
+    return r->ts ? (r->ts >= from && r->ts <= to) : from == 0;
+}
+
+static void run_query(uint32_t id, uint32_t from, uint32_t to, uint32_t max)
+{
+    int64_t  t0 = esp_timer_get_time();
+    uint32_t count = 0, sectors = 0;
+    size_t   len = 0;
+    bool     ok = true;
+
+    /* Oldest sector first: the one after the sector being appended to,
+       or the write sector itself while it still awaits its erase. */
+    uint32_t cur   = s_wr / REC_PER_SEC;
+    uint32_t start = (int)cur == s_wr_sec ? (cur + 1) % s_nsec : cur;
+    for (uint32_t k = 0; k < s_nsec && ok && count < max; k++) {
+        uint32_t         sec = (start + k) % s_nsec;
+        const sec_idx_t *e   = &s_idx[sec];
+        if (!e->count) continue;
+        bool timed_hit = e->ts_min <= to && e->ts_max >= from;
+        if (!timed_hit && !(e->untimed && from == 0)) continue;
+
+        sectors++;
+        esp_partition_read(s_part, sec * SECTOR, s_sec_buf, SECTOR);
+        for (uint32_t i = 0; i < REC_PER_SEC && count < max; i++) {
+            const rec_t *r = &s_sec_buf[i];
+            if (!rec_valid(r) || !in_range(r, from, to)) continue;
+
+            char amount[sizeof(r->amount) + 1], desc[sizeof(r->desc) + 1];
+            json_safe(amount, r->amount, sizeof(r->amount));
+            json_safe(desc,   r->desc,   sizeof(r->desc));
+            char line[224];
+            int  n = snprintf(line, sizeof(line),
+                              "{\"seq\":%lu,\"ts\":%lu,\"up\":%lu,"
+                              "\"ev\":\"%s\",\"arg\":%u,\"qr\":\"%08lx\","
+                              "\"amount\":\"%s\",\"desc\":\"%s\"}",
+                              (unsigned long)r->seq, (unsigned long)r->ts,
+                              (unsigned long)r->up_s,
+                              r->type < sizeof(EV_NAME) / sizeof(EV_NAME[0])
+                                  ? EV_NAME[r->type] : "?",
+                              r->arg, (unsigned long)r->qr_crc, amount, desc);
+
+            if (len && len + 1 + n > sizeof(s_stream)) {
+                if (!(ok = publish_stream(len))) break;
+                len = 0;
+            }
+            if (len) s_stream[len++] = '\n';
+            memcpy(s_stream + len, line, n);
+            len += n;
+            count++;
+        }
+        /* Keep appends flowing during a long stream.  Checked, not taken
+           from the notification: that may be a new query's wake-up. */
+        if (s_pend_cnt >= (int)REC_PER_PAGE) flush();
+    }
+    if (ok && len) ok = publish_stream(len);
+
+    uint32_t ms = (esp_timer_get_time() - t0) / 1000;
+    if (ok) {
+        len = snprintf(s_stream, sizeof(s_stream),
+                       "{\"id\":%lu,\"done\":true,\"count\":%lu,"
+                       "\"sectors\":%lu,\"ms\":%lu}",
+                       (unsigned long)id, (unsigned long)count,
+                       (unsigned long)sectors, (unsigned long)ms);
+        publish_stream(len);
+    }
+    s_stats.queries++;
+    s_stats.streamed          += count;
+    s_stats.query_ms_last      = ms;
+    s_stats.query_sectors_last = sectors;
+    ESP_LOGI(TAG, "query %lu: %lu records, %lu/%lu sectors read, %lu ms%s",
+             (unsigned long)id, (unsigned long)count, (unsigned long)sectors,
+             (unsigned long)s_nsec, (unsigned long)ms,
+             ok ? "" : " (link dropped)");
+}
+
+static uint32_t json_u32(const cJSON *root, const char *key, uint32_t def)
+{
+    const cJSON *v = cJSON_GetObjectItemCaseSensitive(root, key);
+    if (!cJSON_IsNumber(v) || v->valuedouble < 0) return def;
+    return v->valuedouble > UINT32_MAX ? UINT32_MAX : (uint32_t)v->valuedouble;
+}
+
+/* MQTT task: record the request; the journal task streams it. */
+static void on_query(const char *data, int len)
+{
+    cJSON *root = cJSON_ParseWithLength(data, len);
+    if (!root) {
+        ESP_LOGW(TAG, "query: invalid JSON");
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_query.id      = json_u32(root, "id", 0);
+    s_query.from    = json_u32(root, "from", 0);
+    s_query.to      = json_u32(root, "to", UINT32_MAX);
+    s_query.max     = json_u32(root, "max", APP_JOURNAL_QUERY_MAX);
+    s_query.pending = true;
+    xSemaphoreGive(s_lock);
+    cJSON_Delete(root);
+
+    xTaskNotifyGive(s_task);
+}
+
+/* ── Task ─────────────────────────────────────────────────────────────── */
+
+static void journal_task(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(APP_JOURNAL_FLUSH_MS));
+        flush();
+
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        bool     q    = s_query.pending;
+        uint32_t id   = s_query.id,   from = s_query.from;
+        uint32_t to   = s_query.to,   max  = s_query.max;
+        s_query.pending = false;
+        xSemaphoreGive(s_lock);
+
+        if (q && mqtt_service_is_connected()) run_query(id, from, to, max);
+    }
+}
+
+/* ── Public API ───────────────────────────────────────────────────────── */
+
+esp_err_t journal_service_init(void)
+{
+    s_part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                      ESP_PARTITION_SUBTYPE_ANY, "journal");
+    if (!s_part) {
+        ESP_LOGW(TAG, "No \"journal\" partition – journal disabled");
+        return ESP_OK;
+    }
+    s_nsec = s_part->size / SECTOR;
+    s_idx  = calloc(s_nsec, sizeof(*s_idx));
+    s_lock = xSemaphoreCreateMutex();
+    ESP_RETURN_ON_FALSE(s_idx && s_lock, ESP_ERR_NO_MEM, TAG,
+                        "alloc failed");
+
+    int64_t t0 = esp_timer_get_time();
+    recover();
+    update_range();
+    ESP_LOGI(TAG, "%lu records (seq %lu..%lu), index rebuilt in %lu ms",
+             (unsigned long)s_stats.stored, (unsigned long)s_stats.oldest_seq,
+             (unsigned long)s_stats.newest_seq,
+             (unsigned long)((esp_timer_get_time() - t0) / 1000));
+
+    BaseType_t ok = xTaskCreate(journal_task, "journal",
+                                APP_JOURNAL_TASK_STACK, NULL,
+                                APP_JOURNAL_TASK_PRIO, &s_task);
+    ESP_RETURN_ON_FALSE(ok == pdPASS, ESP_ERR_NO_MEM, TAG,
+                        "task create failed");
+
+    journal_log(JOURNAL_EV_BOOT, esp_reset_reason(), NULL);
+    return ESP_OK;
+}
+
+esp_err_t journal_service_register(void)
+{
+    if (!s_task) return ESP_OK;
+    return mqtt_service_register_handler(APP_MQTT_TOPIC_JOURNAL_GET, on_query);
+}
+
+void journal_log(journal_ev_t type, uint8_t arg, const qr_payload_t *qr)
+{
+    if (!s_task) return;
+
+    rec_t r = {
+        .ts   = time_service_is_time_valid() ? (uint32_t)time(NULL) : 0,
+        .up_s = esp_timer_get_time() / 1000000,
+        .type = type,
+        .arg  = arg,
+    };
+    if (qr) {
+        r.qr_crc = esp_rom_crc32_le(0, (const uint8_t *)qr->data,
+                                    strlen(qr->data));
+        strncpy(r.amount, qr->amount, sizeof(r.amount));
+        strncpy(r.desc,   qr->desc,   sizeof(r.desc));
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_pend_cnt < PEND_MAX) {
+        r.seq = s_seq++;
+        r.crc = rec_crc(&r);
+        s_pend[s_pend_cnt++] = r;
+        s_stats.logged++;
+    } else {
+        s_stats.dropped++;
+    }
+    bool page_full = s_pend_cnt >= (int)REC_PER_PAGE;
+    xSemaphoreGive(s_lock);
+
+    if (page_full) xTaskNotifyGive(s_task);
+}
+
+void journal_service_get_stats(journal_stats_t *out)
+{
+    *out = s_stats;
+}
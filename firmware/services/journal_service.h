@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "mqtt_service.h"
+
+/* Journal event types */
+typedef enum {
+    JOURNAL_EV_BOOT    = 1,     /* arg: esp_reset_reason()              */
+    JOURNAL_EV_SHOW    = 2,
+    JOURNAL_EV_HIDE    = 3,
+    JOURNAL_EV_RESULT  = 4,     /* arg: POS_BIN_STATUS_*, 0xFF unknown  */
+    JOURNAL_EV_DISMISS = 5,     /* customer tapped the QR away          */
+    JOURNAL_EV_RESTORE = 6,     /* QR brought back after a reset        */
+} journal_ev_t;
+
+/** Journal counters (monotonic since boot, except where noted). */
+typedef struct {
+    uint32_t logged;            /* records accepted by journal_log()      */
+    uint32_t dropped;           /* RAM batch full                         */
+    uint32_t flash_writes;      /* one per page-sized (or idle) batch     */
+    uint32_t flash_erases;
+    uint32_t stored;            /* current records in the partition       */
+    uint32_t oldest_seq;        /* current range of sequence numbers      */
+    uint32_t newest_seq;
+    uint32_t queries;
+    uint32_t streamed;          /* records sent by range queries          */
+    uint32_t query_ms_last;
+    uint32_t query_sectors_last;    /* sectors read; the rest skipped by  */
+                                    /* the time index                     */
+} journal_stats_t;
+
+/**
+ * Open the "journal" partition, rebuild the sector time index, start the
+ * writer task and log a JOURNAL_EV_BOOT record.  Without the partition
+ * journal_log() is a no-op.  Call early in app_main.
+ */
+esp_err_t journal_service_init(void);
+
+/**
+ * Register the APP_MQTT_TOPIC_JOURNAL_GET range query.  Call before
+ * mqtt_service_init().
+ */
+esp_err_t journal_service_register(void);
+
+/**
+ * Append an event.  Never touches flash: the fixed-size record (time,
+ * uptime, CRC of the QR string, amount and the start of the description
+ * from @p qr, which may be NULL) is batched in RAM and written by the
+ * journal task a flash page at a time.  Safe from any task.
+ */
+void journal_log(journal_ev_t type, uint8_t arg, const qr_payload_t *qr);
+
+/**
+ * Copy the counters into @p out.
+ */
+void journal_service_get_stats(journal_stats_t *out);
@@ -3,21 +3,84 @@
  *
  * Topics:
  *   pos/qr/show   → store QR payload, set has-data flag
- *   pos/qr/hide   → clear has-data flag
- *   pos/qr/result → log result (no storage yet)
+ *   pos/qr/hide   → clear has-data flag (ignored with nothing shown)
+ *   pos/qr/result → journal it, publish EV_QR_RESULT; success also hides
+ *
+ * pos/qr/show/bin, pos/qr/hide/bin and pos/qr/result/bin carry the same
+ * commands in the compact TLV format of pos_bin.h.  The "pos" prefix is
+ * APP_MQTT_TOPIC_PREFIX, replaceable at runtime through
+ * mqtt_service_set_topic_prefix().
+ *
+ * With CONFIG_MQTT_PROTOCOL_5 the client speaks MQTT 5: the broker may
+ * alias the topics it sends us, our own publishes get topic aliases, and
+ * the POS sets a message-expiry interval on show commands so the broker
+ * drops them during an outage.  Independently, a show command whose "ts"
+ * (unix seconds) is older than APP_QR_SHOW_MAX_AGE_S is dropped here.
+ *
+ * Other services register extra command topics through
+ * mqtt_service_register_handler(); they are dispatched after the QR topics.
+ *
+ * Broker failover: secrets.h gives APP_MQTT_URI and optionally
+ * APP_MQTT_URI_BACKUP and APP_MQTT_URI_LAN (same credentials).  After
+ * APP_MQTT_FAILOVER_ATTEMPTS failed connects, or three probes in a row
+ * over APP_MQTT_RTT_DEGRADED_MS, the client moves to the next broker.  From
+ * a fallback it side-probes the primary every APP_MQTT_FAILBACK_S – a TCP
+ * connect to its host and port – and moves back only once that answers.
+ * The latency probe is a QoS 1 publish timed to its PUBACK.  Every (re)connect subscribes
+ * the complete topic set, so all brokers see the same subscriptions.
+ * Switches are reported on APP_MQTT_TOPIC_BROKER through the outbox.
+ * QEMU builds (CONFIG_APP_QEMU) use APP_QEMU_MQTT_URI alone – a broker on
+ * the emulator's host.
+ *
+ * Every incoming message first passes cmd_auth_check() (HMAC envelope,
+ * replay window); handlers only ever see the stripped body.
+ *
+ * The last will sets APP_MQTT_TOPIC_STATUS to a retained "offline";
+ * presence_service publishes "online" and the heartbeat.
+ *
+ * The active QR is kept in RTC memory and NVS (qr_persist.c): saved on
+ * show, cleared on hide / success.  mqtt_service_restore_qr() brings it
+ * back at boot.  Once the first subscriptions are acknowledged, a show,
+ * hide or result – typically the broker's retained one – settles it, and a
+ * stale show hides it; if none arrives within APP_QR_RECONCILE_MS the
+ * restored QR stays up unless its "ts" is stale.  A retained show identical to the QR on screen is
+ * ignored, so reconnects neither rewrite flash nor re-pop a dismissed QR.
+ * Show and hide open flash_sched's quiet window before anything is
+ * queued for flash.
  */
 
 #include "mqtt_service.h"
+#include "pos_bin.h"
+#include "time_service.h"
+#include "outbox_service.h"
+#include "cmd_auth.h"
+#include "qr_persist.h"
+#include "flash_sched.h"
+#include "event_bus.h"
+#include "journal_service.h"
 #include "app_config.h"
 #include "secrets.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
 #include <string.h>
+#include <time.h>
 
 #include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 
 #include "esp_log.h"
 #include "esp_check.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+#include "lwip/netdb.h"
+#include "sdkconfig.h"
 #include "mqtt_client.h"
+#if CONFIG_MQTT_PROTOCOL_5
+#include "mqtt5_client.h"
+#endif
 #include "cJSON.h"
 
 static const char *TAG = "mqtt";
@@ -25,10 +88,90 @@ static const char *TAG = "mqtt";
 /* ── Shared state (written by MQTT task, read by UI task) ─────────────── */
 
 static portMUX_TYPE    s_lock   = portMUX_INITIALIZER_UNLOCKED;
-static qr_payload_t    s_qr;
+static EXT_RAM_BSS_ATTR qr_payload_t s_qr;
 static volatile bool   s_has_qr;
 static volatile uint32_t s_qr_gen;   /* incremented on each new qr/show */
 
+/* Boot restore: settled by the first show / hide / result, or by the
+   reconcile timer (which hands over to the MQTT task, the only writer). */
+static bool               s_restore_pending;
+static uint32_t           s_restore_ts;
+static esp_timer_handle_t s_reconcile_timer;
+static bool               s_rx_retained;    /* message being dispatched */
+#define USER_EV_RECONCILE   1
+#define USER_EV_PROBE       2
+
+static esp_mqtt_client_handle_t s_client;
+static volatile bool            s_connected;
+static SemaphoreHandle_t        s_pub_lock;     /* property + enqueue   */
+static mqtt_stats_t             s_stats;
+
+/* ── Broker list ──────────────────────────────────────────────────────── */
+
+static const char *const s_uris[] = {
+#if CONFIG_APP_QEMU
+    APP_QEMU_MQTT_URI,
+#else
+    APP_MQTT_URI,
+#ifdef APP_MQTT_URI_BACKUP
+    APP_MQTT_URI_BACKUP,
+#endif
+#ifdef APP_MQTT_URI_LAN
+    APP_MQTT_URI_LAN,
+#endif
+#endif
+};
+#define BROKER_CNT  ((int)(sizeof(s_uris) / sizeof(s_uris[0])))
+
+static portMUX_TYPE        s_brk_lock = portMUX_INITIALIZER_UNLOCKED;
+static mqtt_broker_stats_t s_brk[BROKER_CNT];
+static volatile int        s_active;
+static int                 s_fail_streak;   /* connects failed in a row  */
+static int                 s_slow_streak;   /* probes over the limit     */
+static int64_t             s_connect_t0;
+static int64_t             s_switched_at;
+static int                 s_probe_id = -1;
+static int64_t             s_probe_t0;
+static int                 s_sub_pending;
+static int                 s_side_fd = -1;  /* failback probe in flight  */
+static int64_t             s_side_next;     /* no side probe before this */
+
+#if CONFIG_MQTT_PROTOCOL_5
+/* Outgoing topic aliases: index + 1 is the alias number.  `conn` is the
+   connection (s_conn_gen) whose outbox took the topic string with the
+   alias, 0 for none.  Topics are copied – callers such as the outbox
+   pass transient buffers. */
+#define ALIAS_TOPIC_MAX     48
+static struct {
+    char     topic[ALIAS_TOPIC_MAX];
+    uint32_t conn;
+} s_alias[APP_MQTT_TOPIC_ALIAS_MAX];
+static bool     s_alias_ok = true; /* cleared if the broker refuses them */
+static uint32_t s_conn_gen;        /* +1 per MQTT_EVENT_CONNECTED        */
+#endif
+
+/* QR command topics, <prefix><suffix>.  Written only before the client
+   starts or from the MQTT task itself, so dispatch needs no lock. */
+enum {
+    CMD_QR_SHOW, CMD_QR_HIDE, CMD_RESULT,
+    CMD_QR_SHOW_BIN, CMD_QR_HIDE_BIN, CMD_RESULT_BIN,
+    CMD_CNT
+};
+static const char *const CMD_SUFFIX[CMD_CNT] = {
+    APP_MQTT_CMD_QR_SHOW,     APP_MQTT_CMD_QR_HIDE,
+    APP_MQTT_CMD_RESULT,      APP_MQTT_CMD_QR_SHOW_BIN,
+    APP_MQTT_CMD_QR_HIDE_BIN, APP_MQTT_CMD_RESULT_BIN,
+};
+#define CMD_TOPIC_MAX       48
+static char s_cmd_topic[CMD_CNT][CMD_TOPIC_MAX];
+
+/* Extra command topics (registered at init, read by the MQTT task). */
+static struct {
+    const char           *topic;
+    mqtt_topic_handler_t  handler;
+} s_handlers[APP_MQTT_MAX_HANDLERS];
+static int s_handler_cnt;
+
 /* ── Helpers ──────────────────────────────────────────────────────────── */
 
 static bool topic_eq(const char *topic, int topic_len, const char *expected)
@@ -37,59 +180,119 @@ static bool topic_eq(const char *topic, int topic_len, const char *expected)
     return (topic_len == elen) && (memcmp(topic, expected, elen) == 0);
 }
 
-static void json_str(const cJSON *root, const char *key,
+/* Copy string field @p key into @p dst.  Missing → empty.  Returns false
+   (and leaves dst empty) if it does not fit – a truncated QR string
+   would still scan, but as the wrong payment. */
+static bool json_str(const cJSON *root, const char *key,
                      char *dst, size_t dst_size)
 {
     const cJSON *item = cJSON_GetObjectItemCaseSensitive(root, key);
-    if (cJSON_IsString(item) && item->valuestring) {
-        strncpy(dst, item->valuestring, dst_size - 1);
-        dst[dst_size - 1] = '\0';
-    } else {
-        dst[0] = '\0';
+    dst[0] = '\0';
+    if (!cJSON_IsString(item) || !item->valuestring) return true;
+
+    size_t len = strlen(item->valuestring);
+    if (len >= dst_size) {
+        ESP_LOGW(TAG, "\"%s\" is %u bytes, max %u", key,
+                 (unsigned)len, (unsigned)(dst_size - 1));
+        return false;
     }
+    memcpy(dst, item->valuestring, len + 1);
+    return true;
+}
+
+/* Show commands carry the POS clock; 0 = no timestamp → never stale.
+   Without SNTP time we cannot judge age and accept the command. */
+static bool is_stale(uint32_t ts)
+{
+    if (!ts || !time_service_is_time_valid()) return false;
+    return (int64_t)time(NULL) - ts > APP_QR_SHOW_MAX_AGE_S;
 }
 
 /* ── Topic handlers ───────────────────────────────────────────────────── */
 
-static void handle_qr_show(const char *data, int len)
+static void handle_qr_hide(void);
+
+static void store_qr(const qr_payload_t *tmp, uint32_t ts)
 {
-    cJSON *root = cJSON_ParseWithLength(data, len);
-    if (!root) {
-        ESP_LOGW(TAG, "qr/show: invalid JSON");
+    if (is_stale(ts)) {
+        s_stats.stale_drops++;
+        ESP_LOGW(TAG, "qr/show: stale (%lld s old) – dropped",
+                 (long long)time(NULL) - ts);
+        if (s_restore_pending) {
+            /* The broker's newest show is stale, and the restored QR is
+               that show or an older one: unconfirmed and stale. */
+            s_restore_pending = false;
+            ESP_LOGW(TAG, "Restored QR unconfirmed and stale – hidden");
+            handle_qr_hide();
+        }
         return;
     }
+    s_restore_pending = false;
 
-    /* Parse into a temporary so the critical section is only a memcpy. */
-    qr_payload_t tmp;
-    json_str(root, "qr_data", tmp.data,   sizeof(tmp.data));
-    json_str(root, "amount",  tmp.amount, sizeof(tmp.amount));
-    json_str(root, "desc",    tmp.desc,   sizeof(tmp.desc));
-    cJSON_Delete(root);
-
-    if (tmp.data[0] == '\0') {
-        ESP_LOGW(TAG, "qr/show: missing \"qr_data\" field");
+    /* Retained re-delivery of what is already up (MQTT task is the only
+       writer of s_qr, so it can be read without the lock). */
+    if (s_rx_retained && s_has_qr && !strcmp(s_qr.data, tmp->data) &&
+        !strcmp(s_qr.amount, tmp->amount) && !strcmp(s_qr.desc, tmp->desc)) {
+        ESP_LOGI(TAG, "qr/show: retained copy of the current QR");
         return;
     }
 
     portENTER_CRITICAL(&s_lock);
-    s_qr     = tmp;
+    s_qr     = *tmp;
     s_has_qr = true;
     s_qr_gen++;
     portEXIT_CRITICAL(&s_lock);
 
+    event_bus_publish(EV_QR_SHOW, s_qr_gen);
+    flash_sched_note_transition();
+    qr_persist_save(tmp, ts);
+    journal_log(JOURNAL_EV_SHOW, 0, tmp);
+
     ESP_LOGI(TAG, "QR show  qr_data=\"%.60s%s\"  amount=\"%s\"  desc=\"%s\"",
-             tmp.data,
-             strlen(tmp.data) > 60 ? "..." : "",
-             tmp.amount,
-             tmp.desc);
+             tmp->data,
+             strlen(tmp->data) > 60 ? "..." : "",
+             tmp->amount,
+             tmp->desc);
+}
+
+/* Parse into a temporary so the critical section is only a memcpy.
+   Static in PSRAM: ~3 KB, MQTT task only. */
+static EXT_RAM_BSS_ATTR qr_payload_t s_tmp;
+
+static void handle_qr_show(const char *data, int len)
+{
+    uint32_t ts;
+    if (mqtt_service_decode_show_json(data, len, &s_tmp, &ts) == ESP_OK) {
+        store_qr(&s_tmp, ts);
+    }
+}
+
+static void handle_qr_show_bin(const char *data, int len)
+{
+    uint32_t  ts;
+    esp_err_t err = pos_bin_decode_show((const uint8_t *)data, len,
+                                        &s_tmp, &ts);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "qr/show/bin: rejected (%s)", esp_err_to_name(err));
+        return;
+    }
+    store_qr(&s_tmp, ts);
 }
 
 static void handle_qr_hide(void)
 {
+    /* Every reconnect redelivers the retained hide: with nothing shown
+       there is nothing to journal, clear or keep flash quiet for. */
+    if (!s_has_qr) return;
+
     portENTER_CRITICAL(&s_lock);
     s_has_qr = false;
     portEXIT_CRITICAL(&s_lock);
 
+    event_bus_publish(EV_QR_HIDE, 0);
+    flash_sched_note_transition();
+    qr_persist_clear();
+    journal_log(JOURNAL_EV_HIDE, 0, &s_qr);
     ESP_LOGI(TAG, "QR hide");
 }
 
@@ -108,6 +311,17 @@ static void handle_result(const char *data, int len)
              cJSON_IsString(status)  ? status->valuestring  : "(none)",
              cJSON_IsString(message) ? message->valuestring : "");
 
+    uint8_t st = 0xFF;
+    if (cJSON_IsString(status)) {
+        if (!strcmp(status->valuestring, "success")) {
+            st = POS_BIN_STATUS_SUCCESS;
+        } else if (!strcmp(status->valuestring, "failed")) {
+            st = POS_BIN_STATUS_FAILED;
+        }
+    }
+    journal_log(JOURNAL_EV_RESULT, st, s_has_qr ? &s_qr : NULL);
+    event_bus_publish(EV_QR_RESULT, st);
+
     /* Payment success → clear QR data so the UI hides the QR screen */
     if (cJSON_IsString(status) &&
         strcmp(status->valuestring, "success") == 0) {
@@ -118,6 +332,243 @@ static void handle_result(const char *data, int len)
     cJSON_Delete(root);
 }
 
+static void handle_result_bin(const char *data, int len)
+{
+    pos_bin_result_t r;
+    esp_err_t err = pos_bin_decode_result((const uint8_t *)data, len, &r);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "result/bin: rejected (%s)", esp_err_to_name(err));
+        return;
+    }
+
+    ESP_LOGI(TAG, "Result  status=%d  message=\"%.*s\"",
+             r.status, r.message_len, r.message ? r.message : "");
+    journal_log(JOURNAL_EV_RESULT, r.status < 0 ? 0xFF : r.status,
+                s_has_qr ? &s_qr : NULL);
+    event_bus_publish(EV_QR_RESULT, r.status < 0 ? 0xFF : r.status);
+
+    if (r.status == POS_BIN_STATUS_SUCCESS) {
+        handle_qr_hide();
+        ESP_LOGI(TAG, "Payment success – QR cleared");
+    }
+}
+
+/* ── Subscriptions and failover ───────────────────────────────────────── */
+
+static void build_cmd_topics(const char *prefix)
+{
+    for (int i = 0; i < CMD_CNT; i++) {
+        snprintf(s_cmd_topic[i], CMD_TOPIC_MAX, "%s%s", prefix, CMD_SUFFIX[i]);
+    }
+}
+
+static void subscribe_all(esp_mqtt_client_handle_t client)
+{
+    int n = 0;
+    for (int i = 0; i < CMD_CNT; i++) {
+        n += esp_mqtt_client_subscribe(client, s_cmd_topic[i], 1) >= 0;
+    }
+    for (int i = 0; i < s_handler_cnt; i++) {
+        n += esp_mqtt_client_subscribe(client, s_handlers[i].topic, 1) >= 0;
+    }
+    s_sub_pending = n;
+}
+
+/* Point the client at broker @p idx.  Takes effect on the next connect;
+   with @p now the current connection is dropped first.  MQTT task only. */
+static void switch_broker(int idx, const char *reason, bool now)
+{
+    int from = s_active;
+    if (idx == from) return;
+
+    taskENTER_CRITICAL(&s_brk_lock);
+    s_active      = idx;
+    s_fail_streak = 0;
+    s_slow_streak = 0;
+    s_probe_id    = -1;
+    s_switched_at = esp_timer_get_time();
+    s_stats.active_broker = idx;
+    s_stats.broker_switches++;
+    taskEXIT_CRITICAL(&s_brk_lock);
+
+    ESP_LOGW(TAG, "Broker %d → %d (%s): %s", from, idx, reason, s_uris[idx]);
+    esp_mqtt_client_set_uri(s_client, s_uris[idx]);
+    if (now) {
+#if CONFIG_MQTT_PROTOCOL_5
+        /* Leave with reason 0x04 so the old broker still publishes our
+           will – its retained status must not stay "online". */
+        esp_mqtt5_disconnect_property_config_t dis = {
+            .disconnect_reason = 0x04,
+        };
+        esp_mqtt5_client_set_disconnect_property(s_client, &dis);
+#endif
+        esp_mqtt_client_disconnect(s_client);
+        esp_mqtt_client_reconnect(s_client);
+    }
+
+    /* Reported once the new broker is up. */
+    char msg[160];
+    int  n = snprintf(msg, sizeof(msg),
+                      "{\"from\":%d,\"to\":%d,\"reason\":\"%s\","
+                      "\"rtt_ms\":%lu,\"uri\":\"%s\"}",
+                      from, idx, reason, (unsigned long)s_brk[from].rtt_ms,
+                      s_uris[idx]);
+    outbox_post(APP_MQTT_TOPIC_BROKER, msg, n, 1, 0);
+}
+
+static int publish_msg(const char *topic, const char *data, int len,
+                       int qos, bool retain);
+
+/* Reconcile timer (esp_timer task): run the decision in the MQTT task. */
+static void reconcile_cb(void *arg)
+{
+    (void)arg;
+    esp_mqtt_event_t ev = { .msg_id = USER_EV_RECONCILE };
+    esp_mqtt_dispatch_custom_event(s_client, &ev);
+}
+
+/* Probe timer (esp_timer task): the client calls below take the client
+   lock, held by the MQTT task through connects and network I/O, which
+   would stall every other esp_timer callback – run them in the MQTT task. */
+static void probe_cb(void *arg)
+{
+    (void)arg;
+    esp_mqtt_event_t ev = { .msg_id = USER_EV_PROBE };
+    esp_mqtt_dispatch_custom_event(s_client, &ev);
+}
+
+/* Start a non-blocking TCP connect to the host and port of @p uri
+   ("mqtt[s]://[user@]host[:port]/..", ws[s]:// alike).  Returns the
+   socket, or -1 if the URI does not parse or the name does not resolve. */
+static int side_probe_start(const char *uri)
+{
+    const char *p   = strstr(uri, "://");
+    const char *def = !strncmp(uri, "mqtts", 5) ? "8883" :
+                      !strncmp(uri, "wss", 3)   ? "443"  :
+                      !strncmp(uri, "ws", 2)    ? "80"   : "1883";
+    p = p ? p + 3 : uri;
+    const char *at = strchr(p, '@');
+    if (at && at < p + strcspn(p, "/")) p = at + 1;
+
+    char   host[64], port[6];
+    size_t n;
+    if (*p == '[') {                                /* IPv6 literal */
+        n = strcspn(++p, "]");
+        if (p[n] != ']') return -1;
+    } else {
+        n = strcspn(p, ":/");
+    }
+    if (!n || n >= sizeof(host)) return -1;
+    memcpy(host, p, n);
+    host[n] = '\0';
+    p += n + (p[n] == ']');
+    if (*p == ':') {
+        size_t m = strspn(++p, "0123456789");
+        if (!m || m >= sizeof(port)) return -1;
+        memcpy(port, p, m);
+        port[m] = '\0';
+    } else {
+        strcpy(port, def);
+    }
+
+    const struct addrinfo hints = { .ai_socktype = SOCK_STREAM };
+    struct addrinfo      *ai;
+    if (getaddrinfo(host, port, &hints, &ai) != 0 || !ai) return -1;
+    int fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd >= 0) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) != 0 &&
+            errno != EINPROGRESS) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(ai);
+    return fd;
+}
+
+/* True if the connect started by side_probe_start() has completed;
+   closes the socket either way. */
+static bool side_probe_done(int fd)
+{
+    fd_set         wr;
+    struct timeval tv = { 0 };
+    int            err = -1;
+    socklen_t      len = sizeof(err);
+    FD_ZERO(&wr);
+    FD_SET(fd, &wr);
+    if (select(fd + 1, NULL, &wr, NULL, &tv) > 0) {
+        getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len);
+    }
+    close(fd);
+    return err == 0;
+}
+
+/* MQTT task, every probe period.  On a fallback for APP_MQTT_FAILBACK_S,
+   side-probe the primary: the connect started on one tick is checked on
+   the next, and only a primary that answered is switched to.  Otherwise
+   the working connection stays and the side probe is retried after
+   another APP_MQTT_FAILBACK_S.  Returns true if it switched. */
+static bool failback_tick(void)
+{
+    int64_t now = esp_timer_get_time();
+    if (s_side_fd >= 0) {
+        bool up = side_probe_done(s_side_fd);
+        s_side_fd = -1;
+        if (s_active == 0) return false;        /* back by other means */
+        if (up) {
+            switch_broker(0, "failback", true);
+            return true;
+        }
+        ESP_LOGW(TAG, "Primary broker still unreachable – staying on %d",
+                 s_active);
+        s_side_next = now + (int64_t)APP_MQTT_FAILBACK_S * 1000000;
+        return false;
+    }
+    if (s_active == 0 || now < s_side_next ||
+        now - s_switched_at < (int64_t)APP_MQTT_FAILBACK_S * 1000000) {
+        return false;
+    }
+    s_side_fd = side_probe_start(s_uris[0]);
+    if (s_side_fd < 0) {
+        ESP_LOGW(TAG, "Primary broker does not resolve – staying on %d",
+                 s_active);
+        s_side_next = now + (int64_t)APP_MQTT_FAILBACK_S * 1000000;
+    }
+    return false;
+}
+
+/* MQTT task: time one QoS 1 publish to its PUBACK, and decide on latency
+   failover and failback. */
+static void probe_tick(void)
+{
+    if (BROKER_CNT > 1 && failback_tick()) return;
+    if (!s_connected) return;
+
+    mqtt_broker_stats_t *b = &s_brk[s_active];
+    if (s_probe_id >= 0) {
+        /* Previous probe unanswered for a whole period. */
+        b->probe_timeouts++;
+        s_slow_streak++;
+    }
+    if (BROKER_CNT > 1 && s_slow_streak >= 3) {
+        switch_broker((s_active + 1) % BROKER_CNT, "latency", true);
+        return;
+    }
+    s_probe_t0 = esp_timer_get_time();
+    s_probe_id = publish_msg(APP_MQTT_TOPIC_PROBE, "", 0, 1, false);
+}
+
+static void probe_done(void)
+{
+    mqtt_broker_stats_t *b = &s_brk[s_active];
+    uint32_t rtt = (esp_timer_get_time() - s_probe_t0) / 1000;
+    b->rtt_ms  = b->rtt_ms ? (b->rtt_ms * 3 + rtt) / 4 : rtt;
+    s_probe_id = -1;
+    s_slow_streak = (b->rtt_ms > APP_MQTT_RTT_DEGRADED_MS)
+                    ? s_slow_streak + 1 : 0;
+}
+
 /* ── MQTT event handler ───────────────────────────────────────────────── */
 
 static void mqtt_event_handler(void *arg, esp_event_base_t base,
@@ -127,43 +578,131 @@ static void mqtt_event_handler(void *arg, esp_event_base_t base,
 
     switch ((esp_mqtt_event_id_t)event_id) {
 
-    case MQTT_EVENT_CONNECTED:
-        ESP_LOGI(TAG, "Connected to broker");
-        esp_mqtt_client_subscribe(ev->client, APP_MQTT_TOPIC_QR_SHOW, 1);
-        esp_mqtt_client_subscribe(ev->client, APP_MQTT_TOPIC_QR_HIDE, 1);
-        esp_mqtt_client_subscribe(ev->client, APP_MQTT_TOPIC_RESULT,  1);
+    case MQTT_EVENT_BEFORE_CONNECT:
+        s_connect_t0 = esp_timer_get_time();
         break;
 
+    case MQTT_EVENT_CONNECTED: {
+        mqtt_broker_stats_t *b = &s_brk[s_active];
+        b->connects++;
+        b->connect_ms_last = (esp_timer_get_time() - s_connect_t0) / 1000;
+        ESP_LOGI(TAG, "Connected to broker %d in %lu ms", s_active,
+                 (unsigned long)b->connect_ms_last);
+        s_connected   = true;
+        s_fail_streak = 0;
+        event_bus_publish(EV_MQTT_UP, s_active);
+        s_probe_id    = -1;
+#if CONFIG_MQTT_PROTOCOL_5
+        s_alias_ok = true;
+        s_conn_gen++;                           /* aliases are per connection */
+#endif
+        subscribe_all(ev->client);
+        break;
+    }
+
     case MQTT_EVENT_DISCONNECTED:
-        ESP_LOGW(TAG, "Disconnected – will auto-reconnect");
+        if (s_connected) {
+            ESP_LOGW(TAG, "Disconnected – will auto-reconnect");
+            s_connected = false;
+            event_bus_publish(EV_MQTT_DOWN, 0);
+            break;
+        }
+        /* A connect attempt failed. */
+        s_brk[s_active].failures++;
+        if (BROKER_CNT > 1 && ++s_fail_streak >= APP_MQTT_FAILOVER_ATTEMPTS) {
+            switch_broker((s_active + 1) % BROKER_CNT, "connect", false);
+        }
         break;
 
     case MQTT_EVENT_SUBSCRIBED:
-        ESP_LOGI(TAG, "Subscribed, msg_id=%d", ev->msg_id);
+        /* Payload holds the SUBACK return code(s); ≥ 0x80 is a refusal. */
+        if (ev->data_len > 0 && (uint8_t)ev->data[0] >= 0x80) {
+            s_stats.sub_failures++;
+            ESP_LOGE(TAG, "Subscription refused, msg_id=%d", ev->msg_id);
+        }
+        if (s_sub_pending > 0 && --s_sub_pending == 0) {
+            ESP_LOGI(TAG, "All subscriptions acknowledged");
+            if (s_restore_pending) {
+                esp_timer_stop(s_reconcile_timer);
+                esp_timer_start_once(s_reconcile_timer,
+                                     APP_QR_RECONCILE_MS * 1000ULL);
+            }
+        }
+        break;
+
+    case MQTT_EVENT_PUBLISHED:
+        if (ev->msg_id == s_probe_id) probe_done();
         break;
 
-    case MQTT_EVENT_DATA:
+    case MQTT_EVENT_DATA: {
         /* Only process complete (non-fragmented) messages. */
         if (ev->data_len != ev->total_data_len) {
             ESP_LOGW(TAG, "Fragmented message dropped (%d/%d bytes)",
                      ev->data_len, ev->total_data_len);
             break;
         }
-
-        if (topic_eq(ev->topic, ev->topic_len, APP_MQTT_TOPIC_QR_SHOW)) {
-            handle_qr_show(ev->data, ev->data_len);
-        } else if (topic_eq(ev->topic, ev->topic_len, APP_MQTT_TOPIC_QR_HIDE)) {
-            handle_qr_hide();
-        } else if (topic_eq(ev->topic, ev->topic_len, APP_MQTT_TOPIC_RESULT)) {
-            handle_result(ev->data, ev->data_len);
+        int64_t rx_t0 = esp_timer_get_time();
+        s_stats.rx_msgs++;
+        s_stats.rx_bytes += ev->topic_len + ev->data_len;
+
+        /* HMAC envelope, checked and stripped before any parsing. */
+        const char *data = ev->data;
+        int         len  = ev->data_len;
+        if (!cmd_auth_check(&data, &len)) break;
+
+        int cmd = 0;
+        while (cmd < CMD_CNT &&
+               !topic_eq(ev->topic, ev->topic_len, s_cmd_topic[cmd])) {
+            cmd++;
+        }
+        /* A hide or result settles a restored QR; a show does so in
+           store_qr(), which tells a stale one apart. */
+        if (cmd < CMD_CNT && cmd != CMD_QR_SHOW && cmd != CMD_QR_SHOW_BIN) {
+            s_restore_pending = false;
         }
+        s_rx_retained = ev->retain;
+        switch (cmd) {
+        case CMD_QR_SHOW:     handle_qr_show(data, len);     break;
+        case CMD_QR_HIDE:     handle_qr_hide();              break;
+        case CMD_RESULT:      handle_result(data, len);      break;
+        case CMD_QR_SHOW_BIN: handle_qr_show_bin(data, len); break;
+        case CMD_QR_HIDE_BIN: handle_qr_hide();              break;
+        case CMD_RESULT_BIN:  handle_result_bin(data, len);  break;
+        default:
+            for (int i = 0; i < s_handler_cnt; i++) {
+                if (topic_eq(ev->topic, ev->topic_len, s_handlers[i].topic)) {
+                    s_handlers[i].handler(data, len);
+                    break;
+                }
+            }
+            break;
+        }
+        uint32_t rx_us = esp_timer_get_time() - rx_t0;
+        s_stats.rx_us_last = rx_us;
+        if (rx_us > s_stats.rx_us_max) s_stats.rx_us_max = rx_us;
         break;
+    }
 
     case MQTT_EVENT_ERROR:
         ESP_LOGE(TAG, "MQTT error type=%d",
                  ev->error_handle->error_type);
         break;
 
+    case MQTT_USER_EVENT:
+        if (ev->msg_id == USER_EV_PROBE) {
+            probe_tick();
+        } else if (ev->msg_id == USER_EV_RECONCILE && s_restore_pending) {
+            s_restore_pending = false;
+            if (is_stale(s_restore_ts)) {
+                ESP_LOGW(TAG, "Restored QR unconfirmed and stale – hidden");
+                handle_qr_hide();
+            } else {
+                ESP_LOGI(TAG, "Restored QR unconfirmed – kept until "
+                         "hide / result");
+            }
+        }
+        break;
+
     default:
         break;
     }
@@ -174,24 +713,102 @@ static void mqtt_event_handler(void *arg, esp_event_base_t base,
 esp_err_t mqtt_service_init(void)
 {
     const esp_mqtt_client_config_t cfg = {
-        .broker.address.uri                = APP_MQTT_URI,
+        .broker.address.uri                = s_uris[0],
         .credentials.username              = APP_MQTT_USER,
         .credentials.authentication.password = APP_MQTT_PASS,
+        .buffer.size                       = APP_MQTT_BUFFER_SIZE,
+        .network.reconnect_timeout_ms      = APP_MQTT_RECONNECT_MS,
+        .session.keepalive                 = APP_MQTT_KEEPALIVE_S,
+        .session.last_will = {
+            .topic  = APP_MQTT_TOPIC_STATUS,
+            .msg    = "offline",
+            .qos    = 1,
+            .retain = 1,
+        },
+#if CONFIG_MQTT_PROTOCOL_5
+        .session.protocol_ver              = MQTT_PROTOCOL_V_5,
+#endif
     };
 
+    s_pub_lock = xSemaphoreCreateMutex();
+    ESP_RETURN_ON_FALSE(s_pub_lock, ESP_ERR_NO_MEM, TAG, "mutex alloc failed");
+    ESP_RETURN_ON_ERROR(cmd_auth_init(), TAG, "command auth init failed");
+    if (!s_cmd_topic[0][0]) build_cmd_topics(APP_MQTT_TOPIC_PREFIX);
+
     esp_mqtt_client_handle_t client = esp_mqtt_client_init(&cfg);
     ESP_RETURN_ON_FALSE(client, ESP_FAIL, TAG, "client init failed");
+    s_client = client;
+
+#if CONFIG_MQTT_PROTOCOL_5
+    /* Let the broker alias the command topics it sends us. */
+    esp_mqtt5_connection_property_config_t conn = {
+        .topic_alias_maximum = APP_MQTT_TOPIC_ALIAS_MAX,
+    };
+    ESP_RETURN_ON_ERROR(esp_mqtt5_client_set_connect_property(client, &conn),
+                        TAG, "connect property failed");
+#endif
 
     ESP_RETURN_ON_ERROR(
         esp_mqtt_client_register_event(client, ESP_EVENT_ANY_ID,
                                        mqtt_event_handler, NULL),
         TAG, "register event handler failed");
 
+    for (int i = 0; i < BROKER_CNT; i++) {
+        s_brk[i].uri = s_uris[i];
+    }
+
+    const esp_timer_create_args_t reconcile_args = {
+        .callback = reconcile_cb,
+        .name     = "qr_reconcile",
+    };
+    ESP_RETURN_ON_ERROR(esp_timer_create(&reconcile_args, &s_reconcile_timer),
+                        TAG, "reconcile timer create failed");
+
     ESP_RETURN_ON_ERROR(
         esp_mqtt_client_start(client),
         TAG, "client start failed");
 
-    ESP_LOGI(TAG, "Started, broker=%s", APP_MQTT_URI);
+    const esp_timer_create_args_t probe_args = {
+        .callback = probe_cb,
+        .name     = "mqtt_probe",
+    };
+    esp_timer_handle_t probe;
+    ESP_RETURN_ON_ERROR(esp_timer_create(&probe_args, &probe),
+                        TAG, "probe timer create failed");
+    ESP_RETURN_ON_ERROR(
+        esp_timer_start_periodic(probe, APP_MQTT_PROBE_PERIOD_S * 1000000ULL),
+        TAG, "probe timer start failed");
+
+    ESP_LOGI(TAG, "Started, broker=%s (%d configured)", s_uris[0],
+             BROKER_CNT);
+    return ESP_OK;
+}
+
+esp_err_t mqtt_service_decode_show_json(const char *data, int len,
+                                        qr_payload_t *out, uint32_t *ts)
+{
+    cJSON *root = cJSON_ParseWithLength(data, len);
+    if (!root) {
+        ESP_LOGW(TAG, "qr/show: invalid JSON");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    bool ok = json_str(root, "qr_data", out->data,   sizeof(out->data)) &&
+              json_str(root, "amount",  out->amount, sizeof(out->amount)) &&
+              json_str(root, "desc",    out->desc,   sizeof(out->desc));
+    const cJSON *t = cJSON_GetObjectItemCaseSensitive(root, "ts");
+    *ts = (cJSON_IsNumber(t) && t->valuedouble > 0) ? (uint32_t)t->valuedouble
+                                                    : 0;
+    cJSON_Delete(root);
+
+    if (!ok) {
+        ESP_LOGW(TAG, "qr/show: field too long – rejected");
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (out->data[0] == '\0') {
+        ESP_LOGW(TAG, "qr/show: missing \"qr_data\" field");
+        return ESP_ERR_NOT_FOUND;
+    }
     return ESP_OK;
 }
 
@@ -209,3 +826,197 @@ uint32_t mqtt_service_get_qr_gen(void)
 {
     return s_qr_gen;
 }
+
+void mqtt_service_restore_qr(void)
+{
+    uint32_t ts;
+    if (qr_persist_load(&s_tmp, &ts) != ESP_OK) return;
+
+    portENTER_CRITICAL(&s_lock);
+    s_qr     = s_tmp;
+    s_has_qr = true;
+    s_qr_gen++;
+    portEXIT_CRITICAL(&s_lock);
+
+    event_bus_publish(EV_QR_SHOW, s_qr_gen);
+    s_restore_ts      = ts;
+    s_restore_pending = true;
+    journal_log(JOURNAL_EV_RESTORE, 0, &s_tmp);
+    ESP_LOGI(TAG, "Restored QR  qr_data=\"%.60s%s\"  amount=\"%s\"",
+             s_tmp.data, strlen(s_tmp.data) > 60 ? "..." : "", s_tmp.amount);
+}
+
+esp_err_t mqtt_service_register_handler(const char *topic,
+                                        mqtt_topic_handler_t handler)
+{
+    ESP_RETURN_ON_FALSE(topic && handler, ESP_ERR_INVALID_ARG, TAG,
+                        "NULL argument");
+    ESP_RETURN_ON_FALSE(s_handler_cnt < APP_MQTT_MAX_HANDLERS,
+                        ESP_ERR_NO_MEM, TAG, "handler table full");
+
+    s_handlers[s_handler_cnt].topic   = topic;
+    s_handlers[s_handler_cnt].handler = handler;
+    s_handler_cnt++;
+
+    if (s_client && s_connected) {
+        esp_mqtt_client_subscribe(s_client, topic, 1);
+    }
+    return ESP_OK;
+}
+
+esp_err_t mqtt_service_set_topic_prefix(const char *prefix)
+{
+    ESP_RETURN_ON_FALSE(prefix && prefix[0], ESP_ERR_INVALID_ARG, TAG,
+                        "empty prefix");
+    ESP_RETURN_ON_FALSE(!strpbrk(prefix, "+#") &&
+                        prefix[strlen(prefix) - 1] != '/',
+                        ESP_ERR_INVALID_ARG, TAG, "bad prefix '%s'", prefix);
+    ESP_RETURN_ON_FALSE(strlen(prefix) + strlen(APP_MQTT_CMD_RESULT_BIN)
+                        < CMD_TOPIC_MAX, ESP_ERR_INVALID_SIZE, TAG,
+                        "prefix too long");
+
+    bool live = s_client && s_connected;
+    if (live) {
+        for (int i = 0; i < CMD_CNT; i++) {
+            esp_mqtt_client_unsubscribe(s_client, s_cmd_topic[i]);
+        }
+    }
+    build_cmd_topics(prefix);
+    if (live) {
+        for (int i = 0; i < CMD_CNT; i++) {
+            s_sub_pending +=
+                esp_mqtt_client_subscribe(s_client, s_cmd_topic[i], 1) >= 0;
+        }
+    }
+    ESP_LOGI(TAG, "Command topics now %s/qr/...", prefix);
+    return ESP_OK;
+}
+
+#if CONFIG_MQTT_PROTOCOL_5
+/* Alias number for @p topic (assigning one if free), 0 for none. */
+static int alias_for(const char *topic)
+{
+    if (!s_alias_ok || strlen(topic) >= ALIAS_TOPIC_MAX) return 0;
+    for (int i = 0; i < APP_MQTT_TOPIC_ALIAS_MAX; i++) {
+        if (!s_alias[i].topic[0]) {
+            strcpy(s_alias[i].topic, topic);
+            return i + 1;
+        }
+        if (strcmp(s_alias[i].topic, topic) == 0) return i + 1;
+    }
+    return 0;
+}
+
+/*
+ * True if a QoS 0 message for @p alias may go out with an empty topic.
+ * The topic string must already be on the wire of this connection: it
+ * was enqueued on this connection and the outbox has drained since.
+ * The empty-topic message itself is then written directly, not queued,
+ * so it cannot wait in the outbox and surface after a reconnect where
+ * the alias is unknown (a protocol error that drops the link).  A
+ * reconnect waits APP_MQTT_RECONNECT_MS, far longer than the gap
+ * between this check and the write.
+ */
+static bool alias_only(int alias, int qos)
+{
+    return alias && qos == 0 && s_connected &&
+           s_alias[alias - 1].conn == s_conn_gen &&
+           esp_mqtt_client_get_outbox_size(s_client) == 0;
+}
+
+/* Select @p alias for the next publish; 0 always succeeds. */
+static bool set_alias(int alias)
+{
+    esp_mqtt5_publish_property_config_t prop = { .topic_alias = alias };
+    return esp_mqtt5_client_set_publish_property(s_client, &prop) == ESP_OK;
+}
+
+static void aliases_off(int alias)
+{
+    /* Broker allows fewer aliases than we assumed – stop using them. */
+    ESP_LOGW(TAG, "topic alias %d refused – aliases disabled", alias);
+    s_alias_ok = false;
+    set_alias(0);
+}
+#endif
+
+/* Queue one message (or write an alias-only one directly); returns the
+   message id, < 0 on failure. */
+static int publish_msg(const char *topic, const char *data, int len,
+                       int qos, bool retain)
+{
+    if (len <= 0 && data) len = strlen(data);
+
+    xSemaphoreTake(s_pub_lock, portMAX_DELAY);
+
+    int topic_bytes = strlen(topic);
+    int id;
+#if CONFIG_MQTT_PROTOCOL_5
+    int alias = alias_for(topic);
+    if (alias && !set_alias(alias)) {
+        aliases_off(alias);
+        alias = 0;
+    }
+
+    if (alias_only(alias, qos)) {
+        id = esp_mqtt_client_publish(s_client, "", data, len, qos, retain);
+        if (id >= 0) {
+            s_stats.tx_aliased++;
+            topic_bytes = 0;
+        }
+    } else {
+        id = esp_mqtt_client_enqueue(s_client, topic, data, len,
+                                     qos, retain, true);
+        if (id < 0 && alias) {
+            aliases_off(alias);
+            id = esp_mqtt_client_enqueue(s_client, topic, data, len,
+                                         qos, retain, true);
+        } else if (id >= 0 && alias && s_connected) {
+            s_alias[alias - 1].conn = s_conn_gen;
+        }
+    }
+#else
+    id = esp_mqtt_client_enqueue(s_client, topic, data, len,
+                                 qos, retain, true);
+#endif
+    if (id >= 0) {
+        s_stats.tx_msgs++;
+        s_stats.tx_bytes += topic_bytes + len;
+    }
+
+    xSemaphoreGive(s_pub_lock);
+    return id;
+}
+
+esp_err_t mqtt_service_publish(const char *topic, const char *data, int len,
+                               int qos, bool retain)
+{
+    ESP_RETURN_ON_FALSE(s_client, ESP_ERR_INVALID_STATE, TAG,
+                        "publish before init");
+
+    return publish_msg(topic, data, len, qos, retain) < 0 ? ESP_FAIL : ESP_OK;
+}
+
+bool mqtt_service_is_connected(void)
+{
+    return s_connected;
+}
+
+int mqtt_service_get_outbox_bytes(void)
+{
+    return s_client ? (int)esp_mqtt_client_get_outbox_size(s_client) : 0;
+}
+
+void mqtt_service_get_stats(mqtt_stats_t *out)
+{
+    *out = s_stats;
+}
+
+int mqtt_service_get_broker_stats(mqtt_broker_stats_t *out, int max)
+{
+    int n = max < BROKER_CNT ? max : BROKER_CNT;
+    taskENTER_CRITICAL(&s_brk_lock);
+    memcpy(out, s_brk, n * sizeof(*out));
+    taskEXIT_CRITICAL(&s_brk_lock);
+    return n;
+}
@@ -1,11 +1,13 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "esp_err.h"
 
 /* Maximum field lengths (including NUL terminator).
-   Sized so the struct fits comfortably in internal SRAM. */
-#define QR_DATA_MAX     512
+   QR_DATA_MAX holds a version 40-L symbol in byte mode (2953 bytes), so
+   qr_payload_t instances are kept in PSRAM, never on a task stack. */
+#define QR_DATA_MAX     2954
 #define QR_AMOUNT_MAX   32
 #define QR_DESC_MAX     64
 
@@ -16,6 +18,7 @@
  *   { "qr_data": "<qr-string>", "amount": "150.00", "desc": "Order #1" }
  *
  * Only "qr_data" is mandatory; "amount" and "desc" default to empty.
+ * A field longer than its maximum rejects the whole command.
  */
 typedef struct {
     char data[QR_DATA_MAX];
@@ -23,17 +26,60 @@ typedef struct {
     char desc[QR_DESC_MAX];
 } qr_payload_t;
 
+/**
+ * Handler for an extra (non-QR) command topic.
+ * Runs in the MQTT task – copy what you need and return quickly.
+ */
+typedef void (*mqtt_topic_handler_t)(const char *data, int len);
+
+/** Traffic counters (monotonic since boot). */
+typedef struct {
+    uint32_t rx_msgs;
+    uint64_t rx_bytes;      /* topic + payload as delivered              */
+    uint32_t tx_msgs;
+    uint64_t tx_bytes;      /* topic (0 once aliased) + payload          */
+    uint32_t tx_aliased;    /* publishes sent with the alias only        */
+    uint32_t stale_drops;   /* show commands older than the max age      */
+    uint32_t active_broker; /* index into the broker list, 0 = primary   */
+    uint32_t broker_switches;
+    uint32_t sub_failures;  /* SUBACKs with a refusal code               */
+    uint32_t rx_us_last;    /* auth + parse + dispatch of one message    */
+    uint32_t rx_us_max;
+} mqtt_stats_t;
+
+/** Per-broker counters, in list order (primary, backup, LAN). */
+typedef struct {
+    const char *uri;
+    uint32_t connects;
+    uint32_t failures;          /* connect attempts that failed           */
+    uint32_t connect_ms_last;   /* TCP + TLS + CONNACK                    */
+    uint32_t rtt_ms;            /* smoothed probe PUBACK time, 0 = none   */
+    uint32_t probe_timeouts;
+} mqtt_broker_stats_t;
+
 /**
  * Start the MQTT client.
  *
- * Connects to the broker (credentials from secrets/secrets.h) and
- * subscribes to pos/qr/show, pos/qr/hide, and pos/qr/result.
+ * Connects to the first broker (credentials from secrets/secrets.h,
+ * failing over to APP_MQTT_URI_BACKUP / APP_MQTT_URI_LAN if defined) and
+ * subscribes to pos/qr/show, pos/qr/hide, and pos/qr/result (JSON) plus
+ * their binary .../bin counterparts ("pos" unless a prefix was set).
  * Requires WiFi to be connected first.
  */
 esp_err_t mqtt_service_init(void);
 
+/**
+ * Decode a pos/qr/show JSON body into @p out – the path the MQTT task
+ * uses, exposed for the benchmark.  Over-long fields are rejected.
+ * @p ts gets the optional "ts" field (unix seconds), 0 if absent.
+ */
+esp_err_t mqtt_service_decode_show_json(const char *data, int len,
+                                        qr_payload_t *out, uint32_t *ts);
+
 /**
  * Returns true after a pos/qr/show message and false after pos/qr/hide.
+ * Changes are published as EV_QR_SHOW / EV_QR_HIDE (event_bus.h); read
+ * this on EV_OVERFLOW or to seed a new subscriber.
  */
 bool mqtt_service_has_qr_data(void);
 
@@ -47,7 +93,70 @@ bool mqtt_service_has_qr_data(void);
 const qr_payload_t *mqtt_service_get_qr(void);
 
 /**
- * Generation counter – incremented each time a new pos/qr/show arrives.
- * Used by the UI loop to detect new payloads vs. the same old data.
+ * Generation counter – incremented each time a new pos/qr/show arrives,
+ * and carried by its EV_QR_SHOW.  Tells a new payload from the same old
+ * data.
  */
 uint32_t mqtt_service_get_qr_gen(void);
+
+/**
+ * Re-display the QR that was active when the device went down (RTC
+ * memory, else NVS – see qr_persist.h).  Call once at boot, after
+ * nvs_flash_init() and before the UI loop starts; needs no network.  The
+ * broker's state settles it after the first connect.
+ */
+void mqtt_service_restore_qr(void);
+
+/**
+ * Route an extra command topic to @p handler.
+ *
+ * The topic is subscribed on every (re)connect; if the client is already
+ * connected it is subscribed immediately.  At most APP_MQTT_MAX_HANDLERS.
+ */
+esp_err_t mqtt_service_register_handler(const char *topic,
+                                        mqtt_topic_handler_t handler);
+
+/**
+ * Move the QR command topics to <prefix>/qr/show etc.
+ *
+ * Call before mqtt_service_init() or from a topic handler (the MQTT task);
+ * when connected the old topics are unsubscribed and the new ones
+ * subscribed at once.  Wildcards and a trailing '/' are rejected.
+ */
+esp_err_t mqtt_service_set_topic_prefix(const char *prefix);
+
+/**
+ * Queue a message for publishing.
+ *
+ * The message is copied into the client outbox and sent by the MQTT task.
+ * Returns ESP_ERR_INVALID_STATE before mqtt_service_init().
+ * With MQTT 5 each topic is given a topic alias on first use, so repeat
+ * QoS 0 publishes send only the two-byte alias instead of the topic.
+ * Those are written to the socket directly, once the topic itself is on
+ * the wire of the current connection, so they may block the caller for
+ * the write: call from a background task, not from LVGL or a timer.
+ */
+esp_err_t mqtt_service_publish(const char *topic, const char *data, int len,
+                               int qos, bool retain);
+
+/**
+ * True while the client holds a broker connection.
+ */
+bool mqtt_service_is_connected(void);
+
+/**
+ * Bytes waiting in the client's own outbox (queued or unacknowledged) –
+ * the backpressure signal for services/outbox_service.c.
+ */
+int mqtt_service_get_outbox_bytes(void);
+
+/**
+ * Copy the traffic counters into @p out.
+ */
+void mqtt_service_get_stats(mqtt_stats_t *out);
+
+/**
+ * Copy up to @p max per-broker records into @p out; returns how many
+ * brokers are configured (at most @p max).
+ */
+int mqtt_service_get_broker_stats(mqtt_broker_stats_t *out, int max);
@@ -0,0 +1,549 @@
+/*
+ * Offline outbox – ordered, persistent publishing for acks and reports.
+ *
+ * outbox_post() copies a message into a ring in PSRAM and returns.  A
+ * low-priority task drains the ring while the broker is connected (woken
+ * at once by EV_MQTT_UP after a reconnect), pacing
+ * itself on the MQTT client's own outbox (backpressure), and coalesces
+ * runs of OUTBOX_F_BATCH messages to one topic into a single publish.
+ *
+ * Once the ring passes APP_OUTBOX_SPILL_PCT the oldest messages move to
+ * the "outbox" flash partition, one esp_partition_write() per batch.
+ * Flash only ever holds messages older than anything in RAM, so a flush
+ * drains flash first and order is kept end to end.
+ *
+ * Flash layout: a ring of 4 KB sectors, each filled front to back with
+ * segments that never cross a sector boundary:
+ *
+ *   seg_hdr_t  magic, seq, len, count, crc32, done
+ *   records    rec_hdr_t, topic + NUL, body + NUL – back to back
+ *
+ * `done` is programmed 0xFFFFFFFF → 0 once the segment is published, so
+ * no erase is needed to retire it.  At boot the sectors are scanned for
+ * the oldest pending and the newest segment.  A reboot in the middle of
+ * a segment re-sends its first records: delivery is at-least-once.
+ */
+
+#include "outbox_service.h"
+#include "mqtt_service.h"
+#include "flash_sched.h"
+#include "event_bus.h"
+#include "app_config.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+
+static const char *TAG = "outbox";
+
+#define SECTOR          4096
+#define SEG_MAGIC       0x584F4253u             /* "SBOX" */
+#define SEG_PENDING     0xFFFFFFFFu
+#define TOPIC_MAX       64
+#define RING_CAP        APP_OUTBOX_RAM_BYTES
+#define SPILL_BYTES     (RING_CAP * APP_OUTBOX_SPILL_PCT / 100)
+
+typedef struct __attribute__((packed)) {
+    uint16_t size;          /* whole record, header included             */
+    uint8_t  topic_len;     /* including the NUL                         */
+    uint8_t  qos;
+    uint8_t  flags;         /* OUTBOX_F_*                                */
+    uint8_t  rsvd;
+} rec_hdr_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint16_t len;           /* record bytes after the header             */
+    uint16_t count;
+    uint32_t crc;
+    uint32_t done;          /* SEG_PENDING until published               */
+} seg_hdr_t;
+
+#define REC_MAX         (SECTOR - sizeof(seg_hdr_t))
+
+/* RAM ring: records never wrap; when the tail end is too short the head
+   restarts at 0 and s_wrap marks where the older records end. */
+static EXT_RAM_BSS_ATTR uint8_t s_ring[RING_CAP];
+static size_t            s_head, s_tail, s_wrap, s_used;
+static bool              s_wrapped;
+static int               s_ring_cnt;
+static SemaphoreHandle_t s_lock;
+static TaskHandle_t      s_task;
+static event_sub_t       s_sub = -1;    /* EV_MQTT_UP: flush at once     */
+
+/* Flash ring */
+static const esp_partition_t *s_part;
+static uint32_t          s_nsec;
+static uint32_t          s_wr;          /* next segment offset           */
+static int               s_wr_sec = -1; /* sector erased for appending   */
+static uint32_t          s_rd;          /* oldest pending segment        */
+static uint32_t          s_seq;
+static int               s_flash_segs;  /* pending segments              */
+static int               s_seg_skip;    /* records of s_rd already sent  */
+
+/* Segment being written or replayed; records start after the header. */
+static EXT_RAM_BSS_ATTR uint8_t s_stage[SECTOR];
+static EXT_RAM_BSS_ATTR char    s_batch[APP_OUTBOX_BATCH_BYTES];
+
+static outbox_stats_t    s_stats;
+static uint32_t          s_pass_bytes;
+
+/* ── RAM ring (lock held) ─────────────────────────────────────────────── */
+
+static uint8_t *ring_reserve(size_t n)
+{
+    size_t at;
+    if (!s_wrapped) {
+        if (RING_CAP - s_head >= n) {
+            at = s_head;
+        } else if (s_tail >= n) {
+            s_wrap    = s_head;
+            s_wrapped = true;
+            at        = 0;
+        } else {
+            return NULL;
+        }
+    } else if (s_tail - s_head >= n) {
+        at = s_head;
+    } else {
+        return NULL;
+    }
+    s_head  = at + n;
+    s_used += n;
+    s_ring_cnt++;
+    return s_ring + at;
+}
+
+static void ring_drop(int n)
+{
+    while (n-- > 0 && s_ring_cnt) {
+        const rec_hdr_t *r = (const rec_hdr_t *)(s_ring + s_tail);
+        s_tail += r->size;
+        s_used -= r->size;
+        if (--s_ring_cnt == 0) {
+            s_head = s_tail = 0;
+            s_wrapped = false;
+        } else if (s_wrapped && s_tail == s_wrap) {
+            s_tail    = 0;
+            s_wrapped = false;
+        }
+    }
+    s_stats.ram_bytes = s_used;
+    s_stats.ram_msgs  = s_ring_cnt;
+}
+
+/* Copy the oldest records that fit in REC_MAX bytes to the stage. */
+static int ring_gather(size_t *len)
+{
+    uint8_t *dst = s_stage + sizeof(seg_hdr_t);
+    size_t   pos = s_tail, n = 0;
+    bool     wrapped = s_wrapped;
+    int      cnt = 0;
+
+    while (cnt < s_ring_cnt) {
+        if (wrapped && pos == s_wrap) {
+            pos     = 0;
+            wrapped = false;
+        }
+        const rec_hdr_t *r = (const rec_hdr_t *)(s_ring + pos);
+        if (n + r->size > REC_MAX) break;
+        memcpy(dst + n, r, r->size);
+        n   += r->size;
+        pos += r->size;
+        cnt++;
+    }
+    *len = n;
+    return cnt;
+}
+
+/* ── Flash ring ───────────────────────────────────────────────────────── */
+
+static uint32_t sector_next(uint32_t off)
+{
+    return (off / SECTOR + 1) % s_nsec * SECTOR;
+}
+
+static bool seg_read_hdr(uint32_t off, seg_hdr_t *h)
+{
+    if (off % SECTOR + sizeof(*h) > SECTOR) return false;
+    return esp_partition_read(s_part, off, h, sizeof(*h)) == ESP_OK &&
+           h->magic == SEG_MAGIC &&
+           off % SECTOR + sizeof(*h) + h->len <= SECTOR;
+}
+
+/* Read the segment at @p off into the stage and check its CRC. */
+static bool seg_load(uint32_t off, seg_hdr_t *h)
+{
+    if (!seg_read_hdr(off, h)) return false;
+    uint8_t *rec = s_stage + sizeof(*h);
+    return esp_partition_read(s_part, off + sizeof(*h), rec, h->len) == ESP_OK
+           && esp_rom_crc32_le(0, rec, h->len) == h->crc;
+}
+
+static uint32_t seg_next(uint32_t off, const seg_hdr_t *h)
+{
+    uint32_t  nx = off + sizeof(*h) + h->len;
+    seg_hdr_t n;
+    if (nx % SECTOR != 0 && seg_read_hdr(nx, &n)) return nx;
+    return sector_next(off);
+}
+
+/* Retire the segment at s_rd; @p sent of its records were published. */
+static void seg_retire(const seg_hdr_t *h, int sent)
+{
+    s_stats.flash_pending -= h->count - s_seg_skip;
+    s_stats.flash_lost    += h->count - sent;
+    s_seg_skip = 0;
+    s_rd = --s_flash_segs ? seg_next(s_rd, h) : s_wr;
+}
+
+/* Write the staged records as one segment – a single flash write, plus
+   an erase whenever a new sector is entered. */
+static bool seg_append(size_t len, int count)
+{
+    size_t total = sizeof(seg_hdr_t) + len;
+
+    if (s_wr % SECTOR + total > SECTOR) s_wr = sector_next(s_wr);
+    if ((int)(s_wr / SECTOR) != s_wr_sec) {
+        /* Ring full: the sector to erase still holds the oldest pending
+           segments – they are lost. */
+        seg_hdr_t old;
+        while (s_flash_segs && s_rd / SECTOR == s_wr / SECTOR &&
+               seg_read_hdr(s_rd, &old)) {
+            seg_retire(&old, s_seg_skip);
+        }
+        flash_sched_begin(FLASH_CL_OUTBOX);
+        esp_err_t err = esp_partition_erase_range(s_part, s_wr, SECTOR);
+        flash_sched_end(FLASH_CL_OUTBOX);
+        if (err != ESP_OK) return false;
+        s_stats.flash_erases++;
+        s_wr_sec = s_wr / SECTOR;
+    }
+
+    seg_hdr_t *h = (seg_hdr_t *)s_stage;
+    *h = (seg_hdr_t){
+        .magic = SEG_MAGIC,
+        .seq   = s_seq,
+        .len   = len,
+        .count = count,
+        .crc   = esp_rom_crc32_le(0, s_stage + sizeof(*h), len),
+        .done  = SEG_PENDING,
+    };
+    flash_sched_begin(FLASH_CL_OUTBOX);
+    esp_err_t err = esp_partition_write(s_part, s_wr, s_stage, total);
+    flash_sched_end(FLASH_CL_OUTBOX);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "segment write at 0x%lx failed", (unsigned long)s_wr);
+        return false;
+    }
+    s_stats.flash_writes++;
+
+    if (!s_flash_segs) {
+        s_rd       = s_wr;
+        s_seg_skip = 0;
+    }
+    s_flash_segs++;
+    s_seq++;
+    s_wr += total;
+    s_stats.flash_pending += count;
+    s_stats.spilled       += count;
+    return true;
+}
+
+static void flash_recover(void)
+{
+    bool     any = false, pending = false;
+    uint32_t newest = 0, newest_end = 0, oldest = 0;
+
+    for (uint32_t sec = 0; sec < s_nsec; sec++) {
+        uint32_t  off = sec * SECTOR;
+        seg_hdr_t h;
+        while (off < (sec + 1) * SECTOR && seg_load(off, &h)) {
+            if (!any || (int32_t)(h.seq - newest) > 0) {
+                newest     = h.seq;
+                newest_end = off + sizeof(h) + h.len;
+                any        = true;
+            }
+            if (h.done == SEG_PENDING) {
+                if (!pending || (int32_t)(h.seq - s_seq) < 0) {
+                    s_seq  = h.seq;          /* oldest pending so far */
+                    oldest = off;
+                    pending = true;
+                }
+                s_flash_segs++;
+                s_stats.flash_pending += h.count;
+            }
+            off += sizeof(h) + h.len;
+        }
+    }
+
+    if (!any) return;                        /* s_wr = 0, sector unerased */
+
+    /* Append after the newest segment if the rest of its sector is still
+       erased; a torn write there sends us to the next sector. */
+    uint32_t tail[sizeof(seg_hdr_t) / 4];
+    s_wr = newest_end;
+    if (s_wr % SECTOR != 0 &&
+        s_wr % SECTOR + sizeof(tail) <= SECTOR &&
+        esp_partition_read(s_part, s_wr, tail, sizeof(tail)) == ESP_OK) {
+        bool erased = true;
+        for (size_t i = 0; i < sizeof(tail) / 4; i++) {
+            erased &= (tail[i] == 0xFFFFFFFFu);
+        }
+        if (erased) s_wr_sec = s_wr / SECTOR;
+    }
+    if ((int)(s_wr / SECTOR) != s_wr_sec) s_wr = sector_next(s_wr - 1);
+
+    s_rd  = pending ? oldest : s_wr;
+    s_seq = newest + 1;
+}
+
+/* ── Publishing ───────────────────────────────────────────────────────── */
+
+static int body_len(const rec_hdr_t *r)
+{
+    return r->size - sizeof(*r) - r->topic_len - 1;
+}
+
+/* Wait until the client outbox has room.  False if the link dropped. */
+static bool wait_room(void)
+{
+    bool waited = false;
+    while (mqtt_service_get_outbox_bytes() > APP_OUTBOX_MQTT_HIGH_BYTES) {
+        if (!mqtt_service_is_connected()) return false;
+        if (!waited) s_stats.backpressure_waits++;
+        waited = true;
+        vTaskDelay(pdMS_TO_TICKS(20));
+    }
+    return mqtt_service_is_connected();
+}
+
+/* Publish @p count records from @p p, skipping the first @p done.
+   Returns how many are done afterwards (< count if the link dropped). */
+static int publish_records(const uint8_t *p, int count, int done)
+{
+    for (int i = 0; i < done; i++) p += ((const rec_hdr_t *)p)->size;
+
+    int i = done;
+    while (i < count) {
+        const rec_hdr_t *r     = (const rec_hdr_t *)p;
+        const char      *topic = (const char *)(r + 1);
+        const char      *body  = topic + r->topic_len;
+        int              len   = body_len(r);
+        const uint8_t   *q     = p + r->size;
+        int              n     = 1;
+
+        if ((r->flags & OUTBOX_F_BATCH) && len < (int)sizeof(s_batch)) {
+            int blen = len;
+            while (i + n < count) {
+                const rec_hdr_t *r2 = (const rec_hdr_t *)q;
+                const char      *t2 = (const char *)(r2 + 1);
+                int              l2 = body_len(r2);
+                if (!(r2->flags & OUTBOX_F_BATCH) || r2->qos != r->qos ||
+                    strcmp(t2, topic) != 0 ||
+                    blen + 1 + l2 > (int)sizeof(s_batch)) {
+                    break;
+                }
+                if (n == 1) memcpy(s_batch, body, len);
+                s_batch[blen++] = '\n';
+                memcpy(s_batch + blen, t2 + r2->topic_len, l2);
+                blen += l2;
+                q    += r2->size;
+                n++;
+            }
+            if (n > 1) {
+                body = s_batch;
+                len  = blen;
+            }
+        }
+
+        if (!wait_room() ||
+            mqtt_service_publish(topic, body, len, r->qos, false) != ESP_OK) {
+            break;
+        }
+        s_stats.published += n;
+        s_stats.publishes++;
+        s_pass_bytes += len;
+        i += n;
+        p  = q;
+    }
+    return i;
+}
+
+static void flush(void)
+{
+    int64_t  t0   = esp_timer_get_time();
+    uint32_t msgs = 0;
+    s_pass_bytes  = 0;
+
+    /* Flash first: everything there is older than the ring. */
+    while (s_flash_segs) {
+        seg_hdr_t h;
+        if (!seg_load(s_rd, &h)) {
+            ESP_LOGW(TAG, "corrupt segment at 0x%lx skipped",
+                     (unsigned long)s_rd);
+            if (!seg_read_hdr(s_rd, &h)) {
+                /* Header gone too: cannot walk on – forget the rest. */
+                s_stats.flash_lost   += s_stats.flash_pending;
+                s_stats.flash_pending = 0;
+                s_flash_segs = 0;
+                s_rd = s_wr;
+                break;
+            }
+            seg_retire(&h, s_seg_skip);
+            continue;
+        }
+        int skip = s_seg_skip;
+        int sent = publish_records(s_stage + sizeof(h), h.count, skip);
+        msgs += sent - skip;
+        if (sent < h.count) {
+            s_stats.flash_pending -= sent - skip;
+            s_seg_skip = sent;
+            goto out;                           /* link dropped */
+        }
+        uint32_t zero = 0;
+        flash_sched_begin(FLASH_CL_OUTBOX);
+        esp_partition_write(s_part, s_rd + offsetof(seg_hdr_t, done),
+                            &zero, sizeof(zero));
+        flash_sched_end(FLASH_CL_OUTBOX);
+        s_stats.flash_marks++;
+        seg_retire(&h, sent);
+    }
+
+    for (;;) {
+        size_t len;
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        int cnt = ring_gather(&len);
+        xSemaphoreGive(s_lock);
+        if (!cnt) break;
+
+        int sent = publish_records(s_stage + sizeof(seg_hdr_t), cnt, 0);
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        ring_drop(sent);
+        xSemaphoreGive(s_lock);
+        msgs += sent;
+        if (sent < cnt) break;
+    }
+
+out:
+    if (msgs) {
+        uint32_t ms = (esp_timer_get_time() - t0) / 1000;
+        s_stats.flush_msgs_last = msgs;
+        s_stats.flush_ms_last   = ms;
+        s_stats.flush_bps_last  = s_pass_bytes * 1000ULL / (ms ? ms : 1);
+        ESP_LOGI(TAG, "flushed %lu msgs, %lu B in %lu ms (%lu B/s)",
+                 (unsigned long)msgs, (unsigned long)s_pass_bytes,
+                 (unsigned long)ms, (unsigned long)s_stats.flush_bps_last);
+    }
+}
+
+static void spill(void)
+{
+    while (s_part && s_used > SPILL_BYTES) {
+        size_t len;
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        int cnt = ring_gather(&len);
+        xSemaphoreGive(s_lock);
+
+        if (!cnt || !seg_append(len, cnt)) break;
+
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        ring_drop(cnt);
+        xSemaphoreGive(s_lock);
+    }
+}
+
+static void outbox_task(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(APP_OUTBOX_POLL_MS));
+        event_t ev;
+        while (event_bus_get(s_sub, &ev)) {}    /* only the wake-up counts */
+        if (mqtt_service_is_connected()) flush();
+        spill();
+    }
+}
+
+/* ── Public API ───────────────────────────────────────────────────────── */
+
+esp_err_t outbox_service_init(void)
+{
+    s_lock = xSemaphoreCreateMutex();
+    ESP_RETURN_ON_FALSE(s_lock, ESP_ERR_NO_MEM, TAG, "mutex alloc failed");
+
+    s_part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                      ESP_PARTITION_SUBTYPE_ANY, "outbox");
+    if (s_part) {
+        s_nsec = s_part->size / SECTOR;
+        flash_recover();
+        ESP_LOGI(TAG, "%lu KB flash ring, %lu msgs pending",
+                 (unsigned long)(s_part->size / 1024),
+                 (unsigned long)s_stats.flash_pending);
+    } else {
+        ESP_LOGW(TAG, "No \"outbox\" partition – RAM only");
+    }
+
+    BaseType_t ok = xTaskCreate(outbox_task, "outbox", APP_OUTBOX_TASK_STACK,
+                                NULL, APP_OUTBOX_TASK_PRIO, &s_task);
+    ESP_RETURN_ON_FALSE(ok == pdPASS, ESP_ERR_NO_MEM, TAG,
+                        "task create failed");
+    s_sub = event_bus_subscribe(EV_BIT(EV_MQTT_UP), s_task);
+    return ESP_OK;
+}
+
+esp_err_t outbox_post(const char *topic, const void *data, int len,
+                      int qos, uint8_t flags)
+{
+    ESP_RETURN_ON_FALSE(s_task, ESP_ERR_INVALID_STATE, TAG,
+                        "post before init");
+
+    if (len <= 0) len = data ? strlen(data) : 0;
+    size_t tlen = strlen(topic) + 1;
+    size_t size = sizeof(rec_hdr_t) + tlen + len + 1;
+    if (tlen > TOPIC_MAX || size > REC_MAX) {
+        s_stats.dropped++;
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint8_t *p = ring_reserve(size);
+    if (p) {
+        rec_hdr_t h = {
+            .size = size, .topic_len = tlen, .qos = qos, .flags = flags,
+        };
+        memcpy(p, &h, sizeof(h));
+        memcpy(p + sizeof(h), topic, tlen);
+        if (len) memcpy(p + sizeof(h) + tlen, data, len);
+        p[size - 1] = '\0';
+        s_stats.posted++;
+    } else {
+        s_stats.dropped++;
+    }
+    s_stats.ram_bytes = s_used;
+    s_stats.ram_msgs  = s_ring_cnt;
+    xSemaphoreGive(s_lock);
+
+    if (!p) {
+        ESP_LOGW(TAG, "Ring full – %s dropped", topic);
+        return ESP_ERR_NO_MEM;
+    }
+    xTaskNotifyGive(s_task);
+    return ESP_OK;
+}
+
+void outbox_service_get_stats(outbox_stats_t *out)
+{
+    *out = s_stats;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/* outbox_post() flags */
+#define OUTBOX_F_BATCH      0x01    /* may share a publish with neighbours */
+
+/** Outbox counters (monotonic since boot, except where noted). */
+typedef struct {
+    uint32_t posted;            /* messages accepted by outbox_post()     */
+    uint32_t dropped;           /* rejected: RAM ring full / too large    */
+    uint32_t published;         /* messages handed to the MQTT client     */
+    uint32_t publishes;         /* MQTT publishes after per-topic batching */
+    uint32_t spilled;           /* messages moved from RAM to flash       */
+    uint32_t flash_writes;      /* segment writes – one per spilled batch */
+    uint32_t flash_marks;       /* "segment flushed" marks                */
+    uint32_t flash_erases;
+    uint32_t flash_lost;        /* pending messages erased when full      */
+    uint32_t backpressure_waits;
+    uint32_t ram_bytes;         /* current RAM ring use                   */
+    uint32_t ram_msgs;          /* current messages in the RAM ring       */
+    uint32_t flash_pending;     /* current messages waiting in flash      */
+    uint32_t flush_msgs_last;   /* last flush pass: messages, time, rate  */
+    uint32_t flush_ms_last;
+    uint32_t flush_bps_last;
+} outbox_stats_t;
+
+/**
+ * Allocate the PSRAM ring, recover pending messages from the "outbox"
+ * flash partition and start the flush task.  Without the partition the
+ * outbox still works, RAM-only.  Call before mqtt_service_init().
+ */
+esp_err_t outbox_service_init(void);
+
+/**
+ * Queue a message for publishing.  Never blocks on the network and never
+ * touches flash: the message is copied into the RAM ring and the flush
+ * task publishes it in order once the broker is reachable, spilling to
+ * flash meanwhile if the ring fills up.  Consecutive messages to the same
+ * topic posted with OUTBOX_F_BATCH are sent as one publish, their bodies
+ * separated by '\n'.  Delivery is at-least-once across reboots.
+ *
+ * Returns ESP_ERR_NO_MEM when the ring is full, ESP_ERR_INVALID_SIZE if
+ * the message could never be stored.
+ */
+esp_err_t outbox_post(const char *topic, const void *data, int len,
+                      int qos, uint8_t flags);
+
+/**
+ * Copy the outbox counters into @p out.
+ */
+void outbox_service_get_stats(outbox_stats_t *out);
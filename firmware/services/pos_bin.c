@@ -0,0 +1,150 @@
+/*
+ * Binary POS command codec – see pos_bin.h for the wire format.
+ *
+ * The decoder walks the TLV records of the MQTT event buffer once and
+ * copies each value into the fixed qr_payload_t field with a single
+ * memcpy: no allocation, no tokenizer; the only scan is a memchr that
+ * refuses embedded NULs.
+ */
+
+#include "pos_bin.h"
+
+#include <string.h>
+
+#define TLV_HDR     3
+
+/* Walk one record: returns false on a truncated buffer. */
+static bool next_tlv(const uint8_t *buf, size_t len, size_t *pos,
+                     uint8_t *type, const uint8_t **val, uint16_t *vlen)
+{
+    if (*pos + TLV_HDR > len) return false;
+
+    *type = buf[*pos];
+    *vlen = buf[*pos + 1] | (uint16_t)buf[*pos + 2] << 8;
+    *val  = buf + *pos + TLV_HDR;
+    if (*pos + TLV_HDR + *vlen > len) return false;
+
+    *pos += TLV_HDR + *vlen;
+    return true;
+}
+
+/* A NUL inside the value would silently cut the string short – for the
+   QR data that means a different, still scannable code – so refuse it. */
+static esp_err_t put_str(char *dst, size_t cap, const uint8_t *val,
+                         uint16_t vlen)
+{
+    if (vlen >= cap)             return ESP_ERR_INVALID_SIZE;
+    if (memchr(val, 0, vlen))    return ESP_ERR_INVALID_ARG;
+    memcpy(dst, val, vlen);
+    dst[vlen] = '\0';
+    return ESP_OK;
+}
+
+static esp_err_t check_header(const uint8_t *buf, size_t len)
+{
+    if (len < 2 || buf[0] != POS_BIN_MAGIC)  return ESP_ERR_INVALID_ARG;
+    if (buf[1] != POS_BIN_VERSION)           return ESP_ERR_NOT_SUPPORTED;
+    return ESP_OK;
+}
+
+esp_err_t pos_bin_decode_show(const uint8_t *buf, size_t len,
+                              qr_payload_t *out, uint32_t *ts)
+{
+    esp_err_t err = check_header(buf, len);
+    if (err != ESP_OK) return err;
+
+    out->data[0] = out->amount[0] = out->desc[0] = '\0';
+    *ts = 0;
+
+    size_t         pos = 2;
+    uint8_t        type;
+    const uint8_t *val;
+    uint16_t       vlen;
+
+    while (pos < len) {
+        if (!next_tlv(buf, len, &pos, &type, &val, &vlen)) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        switch (type) {
+        case POS_BIN_T_QR_DATA:
+            err = put_str(out->data, sizeof(out->data), val, vlen);
+            break;
+        case POS_BIN_T_AMOUNT:
+            err = put_str(out->amount, sizeof(out->amount), val, vlen);
+            break;
+        case POS_BIN_T_DESC:
+            err = put_str(out->desc, sizeof(out->desc), val, vlen);
+            break;
+        case POS_BIN_T_TS:
+            if (vlen != 4) {
+                err = ESP_ERR_INVALID_SIZE;
+                break;
+            }
+            *ts = val[0] | val[1] << 8 | val[2] << 16 |
+                  (uint32_t)val[3] << 24;
+            break;
+        default:
+            break;                              /* skip unknown */
+        }
+        if (err != ESP_OK) return err;
+    }
+
+    return out->data[0] ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t pos_bin_decode_result(const uint8_t *buf, size_t len,
+                                pos_bin_result_t *out)
+{
+    esp_err_t err = check_header(buf, len);
+    if (err != ESP_OK) return err;
+
+    out->status      = -1;
+    out->message     = NULL;
+    out->message_len = 0;
+
+    size_t         pos = 2;
+    uint8_t        type;
+    const uint8_t *val;
+    uint16_t       vlen;
+
+    while (pos < len) {
+        if (!next_tlv(buf, len, &pos, &type, &val, &vlen)) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        if (type == POS_BIN_T_STATUS && vlen == 1) {
+            out->status = val[0];
+        } else if (type == POS_BIN_T_MESSAGE) {
+            if (memchr(val, 0, vlen)) return ESP_ERR_INVALID_ARG;
+            out->message     = (const char *)val;
+            out->message_len = vlen;
+        }
+    }
+    return ESP_OK;
+}
+
+static size_t put_tlv(uint8_t *buf, size_t pos, size_t cap, uint8_t type,
+                      const char *s)
+{
+    size_t n = strlen(s);
+    if (!pos || n == 0) return pos;             /* error or empty field */
+    if (pos + TLV_HDR + n > cap || n > UINT16_MAX) return 0;
+
+    buf[pos]     = type;
+    buf[pos + 1] = n & 0xFF;
+    buf[pos + 2] = n >> 8;
+    memcpy(buf + pos + TLV_HDR, s, n);
+    return pos + TLV_HDR + n;
+}
+
+size_t pos_bin_encode_show(const qr_payload_t *in, uint8_t *buf, size_t cap)
+{
+    if (cap < 2) return 0;
+    buf[0] = POS_BIN_MAGIC;
+    buf[1] = POS_BIN_VERSION;
+
+    size_t pos = 2;
+    pos = put_tlv(buf, pos, cap, POS_BIN_T_QR_DATA, in->data);
+    pos = put_tlv(buf, pos, cap, POS_BIN_T_AMOUNT,  in->amount);
+    pos = put_tlv(buf, pos, cap, POS_BIN_T_DESC,    in->desc);
+    return pos;
+}
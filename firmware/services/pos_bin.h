@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "mqtt_service.h"
+
+/*
+ * Binary POS command format – the compact alternative to the JSON bodies
+ * of pos/qr/show and pos/qr/result, sent on the parallel .../bin topics.
+ *
+ *   byte 0   POS_BIN_MAGIC
+ *   byte 1   POS_BIN_VERSION
+ *   then     TLV records: type (u8), length (u16 LE), value[length]
+ *
+ * Strings are UTF-8 without terminator and must not contain a 0 byte.
+ * Records may come in any order; unknown types are skipped so newer
+ * senders stay compatible.
+ * tools/pos_bin.py is the host-side encoder.
+ */
+#define POS_BIN_MAGIC       0xB1
+#define POS_BIN_VERSION     1
+
+enum {
+    POS_BIN_T_QR_DATA   = 0x01,     /* show: QR string (required)      */
+    POS_BIN_T_AMOUNT    = 0x02,     /* show: amount label              */
+    POS_BIN_T_DESC      = 0x03,     /* show: description label         */
+    POS_BIN_T_TS        = 0x04,     /* show: u32 LE unix seconds       */
+    POS_BIN_T_STATUS    = 0x10,     /* result: u8, POS_BIN_STATUS_*    */
+    POS_BIN_T_MESSAGE   = 0x11,     /* result: message string          */
+};
+
+enum {
+    POS_BIN_STATUS_FAILED  = 0,
+    POS_BIN_STATUS_SUCCESS = 1,
+};
+
+/** Decoded result; @c message points into the decoded buffer. */
+typedef struct {
+    int         status;             /* POS_BIN_STATUS_*, -1 if absent  */
+    const char *message;
+    uint16_t    message_len;
+} pos_bin_result_t;
+
+/**
+ * Decode a show command straight into @p out – no allocation, one memcpy
+ * per field.  Fails (out unspecified) on a malformed buffer, a missing
+ * QR string, a field longer than qr_payload_t can hold
+ * (ESP_ERR_INVALID_SIZE) or a string with an embedded NUL
+ * (ESP_ERR_INVALID_ARG).  @p ts gets the sender timestamp, 0 if absent.
+ */
+esp_err_t pos_bin_decode_show(const uint8_t *buf, size_t len,
+                              qr_payload_t *out, uint32_t *ts);
+
+/**
+ * Decode a result command.  Strings are not copied; a message with an
+ * embedded NUL is refused (ESP_ERR_INVALID_ARG).
+ */
+esp_err_t pos_bin_decode_result(const uint8_t *buf, size_t len,
+                                pos_bin_result_t *out);
+
+/**
+ * Encode a show command into @p buf (for the benchmark and loopback
+ * tests; the POS side uses tools/pos_bin.py).  Returns the encoded
+ * length, or 0 if @p cap is too small.
+ */
+size_t pos_bin_encode_show(const qr_payload_t *in, uint8_t *buf, size_t cap);
@@ -0,0 +1,267 @@
+/*
+ * Deep idle – panel sleep during closed hours or on MQTT command.
+ *
+ * Entering deep idle (only from the idle screen):
+ *   backlight off → ST7701S display-off + sleep-in → scan-out blanked
+ *   (no PSRAM reads) + PCLK dropped → CPU 240 → 80 MHz → LVGL touch
+ *   polling disabled, GT911 polled directly every APP_DEEP_IDLE_TOUCH_POLL_MS.
+ *
+ * Wake triggers:
+ *   - a pos/qr/show payload waiting (qr_wanted), checked every loop
+ *   - touch (consumed – LVGL touch stays off until the finger lifts)
+ *   - pos/display/sleep {"sleep":false}
+ *   - shop opening hour (schedule)
+ *
+ * Wake-to-visible latency is measured from the trigger to the first
+ * frame presented after wake, and checked against
+ * APP_DEEP_IDLE_WAKE_BUDGET_MS.  On wake the scan-out PSRAM traffic and
+ * refill interrupt count during sleep are logged next to the awake rates.
+ *
+ * Schedule: closed when the local hour is outside
+ * [APP_SHOP_OPEN_H, APP_SHOP_CLOSE_H).  Only applies once SNTP is valid,
+ * and only after APP_DEEP_IDLE_AFTER_S without touch.
+ */
+
+#include "power_service.h"
+#include "brightness_service.h"
+#include "lcd_st7701.h"
+#include "lcd_scanout.h"
+#include "touch_gt911.h"
+#include "time_service.h"
+#include "mqtt_service.h"
+#include "qr_screen.h"
+#include "app_config.h"
+
+#include <time.h>
+
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_pm.h"
+#include "cJSON.h"
+#include "lvgl.h"
+
+static const char *TAG = "power";
+
+typedef enum {
+    CMD_NONE,
+    CMD_SLEEP,
+    CMD_WAKE,
+} power_cmd_t;
+
+static esp_lcd_panel_handle_t s_panel;
+static volatile power_cmd_t   s_cmd;
+
+static bool     s_asleep;
+static bool     s_by_schedule;
+static int64_t  s_next_touch_poll_us;
+static int64_t  s_touch_release_us;      /* 0 = LVGL touch enabled   */
+
+/* Measurement */
+static int64_t             s_wake_t0_us;     /* 0 = no wake in flight   */
+static const char         *s_wake_reason;
+static lcd_scanout_stats_t s_mark;           /* stats at last transition */
+static int64_t             s_mark_us;
+static uint64_t            s_awake_bytes_per_s;
+static uint64_t            s_awake_fills_per_s;
+
+/* ── Helpers ─────────────────────────────────────────────────────────── */
+
+static bool shop_closed(void)
+{
+    if (!time_service_is_time_valid()) return false;
+
+    time_t now = time(NULL);
+    struct tm t;
+    localtime_r(&now, &t);
+    return t.tm_hour < APP_SHOP_OPEN_H || t.tm_hour >= APP_SHOP_CLOSE_H;
+}
+
+static void set_cpu_mhz(int mhz)
+{
+    const esp_pm_config_t pm = {
+        .max_freq_mhz       = mhz,
+        .min_freq_mhz       = mhz,
+        .light_sleep_enable = false,
+    };
+    esp_err_t err = esp_pm_configure(&pm);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "CPU %d MHz not applied: %s", mhz, esp_err_to_name(err));
+    }
+}
+
+static void take_mark(lcd_scanout_stats_t *delta, int64_t *elapsed_us)
+{
+    lcd_scanout_stats_t now;
+    lcd_scanout_get_stats(&now);
+    int64_t t = esp_timer_get_time();
+
+    delta->fills       = now.fills - s_mark.fills;
+    delta->psram_bytes = now.psram_bytes - s_mark.psram_bytes;
+    delta->frames      = now.frames - s_mark.frames;
+    *elapsed_us        = t - s_mark_us;
+
+    s_mark    = now;
+    s_mark_us = t;
+}
+
+/* ── Transitions ─────────────────────────────────────────────────────── */
+
+static void enter_sleep(const char *reason, bool by_schedule)
+{
+    lcd_scanout_stats_t d;
+    int64_t             us;
+    take_mark(&d, &us);
+    if (us > 0) {
+        s_awake_bytes_per_s = d.psram_bytes * 1000000ULL / us;
+        s_awake_fills_per_s = d.fills * 1000000ULL / us;
+    }
+
+    ESP_LOGI(TAG, "Deep idle (%s)", reason);
+    touch_gt911_set_lvgl_enabled(false);
+    lcd_st7701_sleep(s_panel);
+    set_cpu_mhz(APP_DEEP_IDLE_CPU_MHZ);
+
+    s_asleep             = true;
+    s_by_schedule        = by_schedule;
+    s_next_touch_poll_us = 0;
+}
+
+static void leave_sleep(const char *reason)
+{
+    s_wake_t0_us  = esp_timer_get_time();
+    s_wake_reason = reason;
+
+    set_cpu_mhz(CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+    lcd_st7701_wake(s_panel);
+    brightness_service_invalidate();    /* sleep switched it off behind
+                                           the policy's back            */
+    lv_disp_trig_activity(NULL);        /* restart the inactivity clock */
+    lv_obj_invalidate(lv_scr_act());    /* clock face is stale          */
+
+    lcd_scanout_stats_t d;
+    int64_t             us;
+    take_mark(&d, &us);
+    uint32_t secs = (uint32_t)(us / 1000000);
+    ESP_LOGI(TAG, "Woke (%s) after %lu s: scan-out read %llu KB from PSRAM "
+             "(awake rate would be %llu KB), %llu refills (awake %llu)",
+             reason, (unsigned long)secs,
+             d.psram_bytes / 1024, s_awake_bytes_per_s * secs / 1024,
+             d.fills, s_awake_fills_per_s * secs);
+
+    s_asleep = false;
+}
+
+/*
+ * The waking finger is still down: keep LVGL touch off until the panel
+ * has reported no touch for a full poll period, so the wake tap does not
+ * also trigger the idle screen's static QR.
+ */
+static void release_touch_when_lifted(void)
+{
+    int64_t now = esp_timer_get_time();
+    if (touch_gt911_is_touched()) {
+        s_touch_release_us = now + APP_DEEP_IDLE_TOUCH_POLL_MS * 1000;
+    } else if (now >= s_touch_release_us) {
+        s_touch_release_us = 0;
+        touch_gt911_set_lvgl_enabled(true);
+    }
+}
+
+/* Called on the first loop after wake, once LVGL has flushed a frame. */
+static void finish_wake_measurement(void)
+{
+    int64_t ms = (esp_timer_get_time() - s_wake_t0_us) / 1000;
+    s_wake_t0_us = 0;
+
+    if (ms > APP_DEEP_IDLE_WAKE_BUDGET_MS) {
+        ESP_LOGW(TAG, "Wake-to-visible %lld ms (%s) – over %d ms budget",
+                 ms, s_wake_reason, APP_DEEP_IDLE_WAKE_BUDGET_MS);
+    } else {
+        ESP_LOGI(TAG, "Wake-to-visible %lld ms (%s)", ms, s_wake_reason);
+    }
+}
+
+/* ── MQTT command (MQTT task context) ─────────────────────────────────── */
+
+static void on_sleep_cmd(const char *data, int len)
+{
+    cJSON *root = cJSON_ParseWithLength(data, len);
+    if (!root) {
+        ESP_LOGW(TAG, "sleep: invalid JSON");
+        return;
+    }
+    const cJSON *sleep = cJSON_GetObjectItemCaseSensitive(root, "sleep");
+    if (cJSON_IsBool(sleep)) {
+        s_cmd = cJSON_IsTrue(sleep) ? CMD_SLEEP : CMD_WAKE;
+    }
+    cJSON_Delete(root);
+}
+
+/* ── Public API ──────────────────────────────────────────────────────── */
+
+esp_err_t power_service_init(esp_lcd_panel_handle_t panel)
+{
+    ESP_RETURN_ON_FALSE(panel, ESP_ERR_INVALID_ARG, TAG, "panel is NULL");
+    s_panel = panel;
+
+    lcd_scanout_get_stats(&s_mark);
+    s_mark_us = esp_timer_get_time();
+
+    return mqtt_service_register_handler(APP_MQTT_TOPIC_SLEEP, on_sleep_cmd);
+}
+
+bool power_service_poll(bool qr_wanted)
+{
+    power_cmd_t cmd = s_cmd;
+    s_cmd = CMD_NONE;
+
+    if (!s_asleep) {
+        if (s_wake_t0_us) {
+            finish_wake_measurement();
+        }
+        if (s_touch_release_us) {
+            release_touch_when_lifted();
+        }
+
+        if (qr_wanted || qr_screen_is_visible()) {
+            return false;
+        }
+
+        if (cmd == CMD_SLEEP) {
+            enter_sleep("command", false);
+        } else if (shop_closed() &&
+                   lv_disp_get_inactive_time(NULL) >=
+                       APP_DEEP_IDLE_AFTER_S * 1000U) {
+            enter_sleep("schedule", true);
+        }
+        return s_asleep;
+    }
+
+    /* Asleep: cheapest checks first. */
+    if (qr_wanted) {
+        leave_sleep("qr");
+    } else if (cmd == CMD_WAKE) {
+        leave_sleep("command");
+    } else if (s_by_schedule && !shop_closed()) {
+        /* Opening hour – a commanded sleep holds until woken. */
+        leave_sleep("schedule");
+    }
+
+    if (s_asleep) {
+        int64_t now = esp_timer_get_time();
+        if (now >= s_next_touch_poll_us) {
+            s_next_touch_poll_us = now + APP_DEEP_IDLE_TOUCH_POLL_MS * 1000;
+            if (touch_gt911_is_touched()) {
+                leave_sleep("touch");
+            }
+        }
+    }
+
+    /* After any wake, hand touch back to LVGL once no finger is down. */
+    if (!s_asleep && s_touch_release_us == 0 && s_wake_t0_us) {
+        s_touch_release_us = esp_timer_get_time();
+    }
+
+    return s_asleep;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_lcd_panel_ops.h"
+
+/**
+ * Register the pos/display/sleep command topic and remember the panel.
+ * Call after lcd_st7701_init() and before mqtt_service_init().
+ */
+esp_err_t power_service_init(esp_lcd_panel_handle_t panel);
+
+/**
+ * Run the deep-idle state machine.  Call from the LVGL task every loop.
+ *
+ * @p qr_wanted  true when an MQTT QR is waiting to be shown – wakes the
+ *               panel immediately and blocks entering sleep.
+ *
+ * Returns true while the display is asleep; the caller should then skip
+ * LVGL work and sleep APP_DEEP_IDLE_LOOP_MS.
+ */
+bool power_service_poll(bool qr_wanted);
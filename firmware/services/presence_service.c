@@ -0,0 +1,146 @@
+/*
+ * Presence – tells the POS whether the display is reachable before it
+ * publishes a QR, so it can pick a fallback without waiting for a timeout.
+ *
+ *   pos/display/status     retained "online" / "offline".  "offline" is
+ *                          the last will, published by the broker once
+ *                          the keep-alive (APP_MQTT_KEEPALIVE_S) lapses.
+ *   pos/display/heartbeat  QoS 0, every APP_HEARTBEAT_PERIOD_S:
+ *     {"up":s,"render_ms":n,"render_age_s":n,"queue":n,"qr":0|1,"broker":i,
+ *      "flash_us":n,"rx_us":n}
+ *
+ *     up            uptime, seconds
+ *     render_ms     duration of the latest LVGL refresh
+ *     render_age_s  seconds since that refresh
+ *     queue         messages waiting in the outbox (RAM + flash)
+ *     flash_us      longest flash write / erase stall so far (flash_sched)
+ *     rx_us         longest handling of one incoming command so far
+ *
+ * A small task drives both, woken by EV_MQTT_UP and at least once a
+ * second: "online" follows every EV_MQTT_UP, so a reconnect still
+ * replaces the will.  Not an esp_timer – the publishes take the MQTT
+ * client lock, which the MQTT task holds through connects and network
+ * I/O, and would stall every other timer callback.  A heartbeat is one
+ * snprintf and one publish of under 160 bytes; under MQTT 5 the topic
+ * goes as a two-byte alias.  Nothing is sent while disconnected – a
+ * stale heartbeat is worthless, the retained status covers that case.
+ */
+
+#include "presence_service.h"
+#include "mqtt_service.h"
+#include "outbox_service.h"
+#include "flash_sched.h"
+#include "event_bus.h"
+#include "lcd_st7701.h"
+#include "app_config.h"
+
+#include <stdio.h>
+
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "presence";
+
+static presence_stats_t s_stats;
+static event_sub_t      s_sub = -1;
+static int64_t          s_next_hb_us;
+
+static void heartbeat(void)
+{
+    int64_t t0 = esp_timer_get_time();
+
+    lcd_render_stats_t r;
+    outbox_stats_t     o;
+    mqtt_stats_t       m;
+    flash_sched_stats_t f;
+    lcd_st7701_get_render_stats(&r);
+    outbox_service_get_stats(&o);
+    mqtt_service_get_stats(&m);
+    flash_sched_get_stats(&f);
+
+    uint32_t stall = 0;
+    for (int i = 0; i < FLASH_CL_CNT; i++) {
+        if (f.cl[i].stall_us_max > stall) stall = f.cl[i].stall_us_max;
+    }
+
+    uint32_t age = r.last_render_at_us
+                   ? (uint32_t)((t0 - r.last_render_at_us) / 1000000) : 0;
+    char msg[160];
+    int  n = snprintf(msg, sizeof(msg),
+                      "{\"up\":%lu,\"render_ms\":%lu,\"render_age_s\":%lu,"
+                      "\"queue\":%lu,\"qr\":%d,\"broker\":%lu,"
+                      "\"flash_us\":%lu,\"rx_us\":%lu}",
+                      (unsigned long)(t0 / 1000000),
+                      (unsigned long)r.last_render_ms, (unsigned long)age,
+                      (unsigned long)(o.ram_msgs + o.flash_pending),
+                      mqtt_service_has_qr_data(),
+                      (unsigned long)m.active_broker, (unsigned long)stall,
+                      (unsigned long)m.rx_us_max);
+    if (mqtt_service_publish(APP_MQTT_TOPIC_HEARTBEAT, msg, n, 0, false)
+        != ESP_OK) {
+        return;
+    }
+
+    uint32_t us = esp_timer_get_time() - t0;
+    s_stats.heartbeats++;
+    s_stats.heartbeat_bytes = n;
+    if (us > s_stats.cost_us_max) s_stats.cost_us_max = us;
+}
+
+static void presence_tick(void)
+{
+    bool connected = mqtt_service_is_connected();
+
+    bool    up = false;
+    event_t ev;
+    while (event_bus_get(s_sub, &ev)) up = true;    /* EV_MQTT_UP, overflow */
+
+    if (connected && up) {
+        /* Overwrite the will left by the previous connection. */
+        if (mqtt_service_publish(APP_MQTT_TOPIC_STATUS, "online", 0,
+                                 1, true) == ESP_OK) {
+            s_stats.announces++;
+            ESP_LOGI(TAG, "Announced online");
+        }
+        s_next_hb_us = 0;                       /* heartbeat right away */
+    }
+
+    int64_t now = esp_timer_get_time();
+    if (connected && now >= s_next_hb_us) {
+        heartbeat();
+        s_next_hb_us = now + APP_HEARTBEAT_PERIOD_S * 1000000LL;
+    }
+}
+
+static void presence_task(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000));
+        presence_tick();
+    }
+}
+
+esp_err_t presence_service_init(void)
+{
+    TaskHandle_t task;
+    BaseType_t ok = xTaskCreate(presence_task, "presence",
+                                APP_PRESENCE_TASK_STACK, NULL,
+                                APP_PRESENCE_TASK_PRIO, &task);
+    ESP_RETURN_ON_FALSE(ok == pdPASS, ESP_ERR_NO_MEM, TAG,
+                        "task create failed");
+
+    /* Subscribed before mqtt_service_init(): no connect goes unseen */
+    s_sub = event_bus_subscribe(EV_BIT(EV_MQTT_UP), task);
+    ESP_RETURN_ON_FALSE(s_sub >= 0, ESP_ERR_NO_MEM, TAG,
+                        "no event bus slot");
+    return ESP_OK;
+}
+
+void presence_service_get_stats(presence_stats_t *out)
+{
+    *out = s_stats;
+}
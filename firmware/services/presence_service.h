@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+/** Presence counters (monotonic since boot). */
+typedef struct {
+    uint32_t announces;         /* retained "online" publishes            */
+    uint32_t heartbeats;
+    uint32_t heartbeat_bytes;   /* last heartbeat body                    */
+    uint32_t cost_us_max;       /* build + publish of one heartbeat       */
+} presence_stats_t;
+
+/**
+ * Start the presence task: publishes the retained "online" status on
+ * every (re)connect and a heartbeat every APP_HEARTBEAT_PERIOD_S.  The
+ * matching "offline" is the MQTT last will set up by mqtt_service_init().
+ * Call before mqtt_service_init().
+ */
+esp_err_t presence_service_init(void);
+
+/**
+ * Copy the presence counters into @p out.
+ */
+void presence_service_get_stats(presence_stats_t *out);
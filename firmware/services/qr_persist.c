@@ -0,0 +1,183 @@
+/*
+ * Active QR persistence – lets a display that browns out or restarts
+ * mid-transaction show the customer's QR again within the first frames
+ * after boot, before WiFi, MQTT or the POS are back.
+ *
+ * Two copies:
+ *   RTC memory  the whole qr_payload_t plus a CRC.  Survives software,
+ *               watchdog and brown-out resets; free to write.
+ *   NVS         "qr" blob in namespace "qrstate": ts plus the three
+ *               strings back to back, so a typical VietQR costs a few
+ *               hundred bytes of flash, not sizeof(qr_payload_t).
+ *               Survives a power cycle.
+ *
+ * The RTC copy is written at once.  The NVS copy is a flash_sched job
+ * that writes whatever state is wanted when it runs – after the QR
+ * transition is over – so a show followed by a hide inside that window
+ * costs no flash write at all.
+ *
+ * qr_persist_load() prefers RTC (never older than NVS and cannot fail)
+ * and falls back to NVS.  Reconciling the restored QR with the broker is
+ * up to mqtt_service.c.
+ */
+
+#include "qr_persist.h"
+#include "flash_sched.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "esp_rom_crc.h"
+#include "nvs.h"
+
+static const char *TAG = "qr_persist";
+
+#define NVS_NAMESPACE   "qrstate"
+#define NVS_KEY         "qr"
+#define RTC_MAGIC       0x51525354u             /* "QRST" */
+
+typedef struct {
+    uint32_t     magic;
+    uint32_t     crc;           /* over ts + qr                           */
+    uint32_t     ts;
+    qr_payload_t qr;
+} rtc_qr_t;
+
+/* NVS image: ts, then data\0amount\0desc\0 */
+typedef struct {
+    uint32_t ts;
+    char     str[sizeof(qr_payload_t)];
+} nvs_qr_t;
+
+static RTC_NOINIT_ATTR rtc_qr_t   s_rtc;
+static EXT_RAM_BSS_ATTR nvs_qr_t  s_want;       /* state to reach in NVS */
+static EXT_RAM_BSS_ATTR nvs_qr_t  s_nvs;        /* load / job image      */
+static size_t                     s_want_len;   /* 0: no active QR       */
+static portMUX_TYPE               s_mux = portMUX_INITIALIZER_UNLOCKED;
+static bool                       s_stored;     /* something to clear    */
+static qr_persist_stats_t         s_stats;
+
+static uint32_t rtc_crc(void)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)&s_rtc.ts,
+                            sizeof(s_rtc) - offsetof(rtc_qr_t, ts));
+}
+
+/* Copy the string at *p into @p dst and step past its NUL; false if the
+   blob ends first or the string does not fit. */
+static bool take(const char **p, const char *end, char *dst, size_t size)
+{
+    size_t n = strnlen(*p, end - *p);
+    if (n == (size_t)(end - *p) || n >= size) return false;
+    memcpy(dst, *p, n + 1);
+    *p += n + 1;
+    return true;
+}
+
+esp_err_t qr_persist_load(qr_payload_t *out, uint32_t *ts)
+{
+    if (s_rtc.magic == RTC_MAGIC && s_rtc.crc == rtc_crc()) {
+        *out = s_rtc.qr;
+        *ts  = s_rtc.ts;
+        s_stored = true;
+        s_stats.restored_from = QR_PERSIST_SRC_RTC;
+        ESP_LOGI(TAG, "Active QR restored from RTC memory");
+        return ESP_OK;
+    }
+
+    nvs_handle_t h;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &h) != ESP_OK) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    size_t    size = sizeof(s_nvs);
+    esp_err_t err  = nvs_get_blob(h, NVS_KEY, &s_nvs, &size);
+    nvs_close(h);
+    if (err != ESP_OK || size <= sizeof(s_nvs.ts)) return ESP_ERR_NOT_FOUND;
+
+    s_stored = true;            /* even if corrupt: clear it on next hide */
+    const char *p   = s_nvs.str;
+    const char *end = (const char *)&s_nvs + size;
+    if (!take(&p, end, out->data,   sizeof(out->data)) ||
+        !take(&p, end, out->amount, sizeof(out->amount)) ||
+        !take(&p, end, out->desc,   sizeof(out->desc)) || !out->data[0]) {
+        ESP_LOGW(TAG, "Stored QR malformed – ignored");
+        return ESP_ERR_NOT_FOUND;
+    }
+    *ts = s_nvs.ts;
+    s_stats.restored_from = QR_PERSIST_SRC_NVS;
+    ESP_LOGI(TAG, "Active QR restored from NVS");
+    return ESP_OK;
+}
+
+/* flash_sched job: bring NVS to the wanted state. */
+static void nvs_sync(void)
+{
+    int64_t t0 = esp_timer_get_time();
+
+    taskENTER_CRITICAL(&s_mux);
+    size_t len = s_want_len;
+    if (len) memcpy(&s_nvs, &s_want, len);
+    taskEXIT_CRITICAL(&s_mux);
+    if (!len && !s_stored) return;
+
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h);
+    if (err == ESP_OK) {
+        err = len ? nvs_set_blob(h, NVS_KEY, &s_nvs, len)
+                  : nvs_erase_key(h, NVS_KEY);
+        if (err == ESP_OK) err = nvs_commit(h);
+        nvs_close(h);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "NVS %s failed (%s) – RTC copy only",
+                 len ? "save" : "clear", esp_err_to_name(err));
+    } else {
+        s_stored = len != 0;
+        s_stats.nvs_writes++;
+    }
+    s_stats.nvs_us_last = esp_timer_get_time() - t0;
+}
+
+void qr_persist_save(const qr_payload_t *qr, uint32_t ts)
+{
+    int64_t t0 = esp_timer_get_time();
+
+    s_rtc.ts    = ts;
+    s_rtc.qr    = *qr;
+    s_rtc.crc   = rtc_crc();
+    s_rtc.magic = RTC_MAGIC;
+
+    taskENTER_CRITICAL(&s_mux);
+    size_t n = 0;
+    s_want.ts = ts;
+    n += strlcpy(s_want.str + n, qr->data,   sizeof(s_want.str) - n) + 1;
+    n += strlcpy(s_want.str + n, qr->amount, sizeof(s_want.str) - n) + 1;
+    n += strlcpy(s_want.str + n, qr->desc,   sizeof(s_want.str) - n) + 1;
+    s_want_len = sizeof(s_want.ts) + n;
+    taskEXIT_CRITICAL(&s_mux);
+    flash_sched_post(FLASH_JOB_QR_STATE, nvs_sync);
+
+    s_stats.saves++;
+    s_stats.save_us_last = esp_timer_get_time() - t0;
+}
+
+void qr_persist_clear(void)
+{
+    s_rtc.magic = 0;
+
+    taskENTER_CRITICAL(&s_mux);
+    s_want_len = 0;
+    taskEXIT_CRITICAL(&s_mux);
+    flash_sched_post(FLASH_JOB_QR_STATE, nvs_sync);
+    s_stats.clears++;
+}
+
+void qr_persist_get_stats(qr_persist_stats_t *out)
+{
+    *out = s_stats;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "mqtt_service.h"
+
+/** Persistence counters (monotonic since boot). */
+typedef struct {
+    uint32_t saves;
+    uint32_t clears;
+    uint32_t nvs_writes;        /* blob writes + key erases, each committed */
+    uint32_t save_us_last;      /* RTC copy, caller's side                 */
+    uint32_t nvs_us_last;       /* deferred NVS write + commit             */
+    uint8_t  restored_from;     /* QR_PERSIST_SRC_* of the boot restore    */
+} qr_persist_stats_t;
+
+enum {
+    QR_PERSIST_SRC_NONE = 0,
+    QR_PERSIST_SRC_RTC  = 1,    /* reset / brown-out: RTC memory kept      */
+    QR_PERSIST_SRC_NVS  = 2,    /* power cycle                             */
+};
+
+/**
+ * Look for a QR that was active when the device went down: RTC memory
+ * first, then NVS (needs nvs_flash_init(), see config_service_init()).
+ * Returns ESP_ERR_NOT_FOUND if none.  @p ts gets its "ts" (0 if none).
+ */
+esp_err_t qr_persist_load(qr_payload_t *out, uint32_t *ts);
+
+/**
+ * Record @p qr as the active QR: in RTC memory at once, in NVS (one blob
+ * write and one commit, only the used string bytes) through flash_sched.
+ * Never blocks on flash.
+ */
+void qr_persist_save(const qr_payload_t *qr, uint32_t ts);
+
+/**
+ * Forget the active QR (hide / result).  No flash write if none reached
+ * NVS.
+ */
+void qr_persist_clear(void);
+
+/**
+ * Copy the counters into @p out.
+ */
+void qr_persist_get_stats(qr_persist_stats_t *out);
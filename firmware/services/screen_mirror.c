@@ -0,0 +1,405 @@
+/*
+ * Screen mirror – shows remote support what a counter display shows.
+ *
+ * {"on":true,"fps":2} on APP_MQTT_TOPIC_MIRROR starts a session.  The
+ * first sweep over the front framebuffer sends every 16×16 tile; later
+ * sweeps send only the tiles that differ from a PSRAM shadow of what the
+ * viewer already has.  Tiles are RLE-compressed RGB565 (screen_mirror.h):
+ * a flat background tile is two 128-pixel runs, 6 bytes after its 4-byte
+ * header, and a full first frame of the idle UI a few tens of KB.
+ * tools/mirror_view.py decodes and shows the stream.
+ *
+ * Budgets, so a session never competes with the display:
+ *   - at most APP_MIRROR_FPS_MAX sweeps a second, in a priority-1 task
+ *   - APP_MIRROR_CPU_US of scan + encode per sweep
+ *   - APP_MIRROR_BYTES_PER_S on the air (token bucket), and no sweep at
+ *     all while the MQTT client outbox is above APP_OUTBOX_MQTT_HIGH_BYTES
+ * A sweep that runs out of either budget stops at a tile and the next
+ * tick resumes there, so a busy screen gives a slower sweep, never a
+ * bigger burst.  A tile that was not sent still differs from the shadow
+ * and is picked up later – including one read while LVGL was drawing it.
+ *
+ * A session ends on {"on":false}, APP_MIRROR_MAX_S after the last
+ * {"on":true}, on MQTT disconnect and – with APP_MIRROR_STOP_ON_QR – as
+ * soon as a QR is shown; it cannot start while one is up.  Each start and
+ * stop is reported on APP_MQTT_TOPIC_MIRROR_STATE as
+ * {"on":bool,"reason":"...","fps":n}.  {"on":true} during a session
+ * restarts it with a full frame, for a viewer that joins late.
+ */
+
+#include "screen_mirror.h"
+#include "mqtt_service.h"
+#include "event_bus.h"
+#include "lcd_scanout.h"
+#include "app_config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "cJSON.h"
+
+static const char *TAG = "mirror";
+
+#define TILES_X     (APP_LCD_H_RES / MIRROR_TILE)
+#define TILES_Y     (APP_LCD_V_RES / MIRROR_TILE)
+#define TILE_CNT    (TILES_X * TILES_Y)
+#define TILE_PX     (MIRROR_TILE * MIRROR_TILE)
+#define FB_BPP      (APP_LCD_FB_INDEXED ? 1 : 2)
+#define LINE_BYTES  (APP_LCD_H_RES * FB_BPP)
+#define TROW_BYTES  (MIRROR_TILE * FB_BPP)      /* one tile row, fb format */
+#define TILE_BYTES  (TILE_PX * FB_BPP)
+#define TILE_HDR    4
+/* A literal run costs 2 B/px + 1 and is followed by a repeat of >= 2
+   pixels in 3 B; only 128-pixel splits and a trailing literal add more. */
+#define RLE_MAX     (TILE_PX * 2 + TILE_PX / 128 + 1)
+#define BUCKET_MAX  (APP_MIRROR_BYTES_PER_S / 2)
+
+_Static_assert(APP_LCD_H_RES % MIRROR_TILE == 0 &&
+               APP_LCD_V_RES % MIRROR_TILE == 0,
+               "the screen must be a whole number of tiles");
+_Static_assert(APP_MIRROR_MSG_BYTES >= MIRROR_HDR_BYTES + TILE_HDR + RLE_MAX,
+               "a message must hold one tile");
+_Static_assert(BUCKET_MAX >= APP_MIRROR_MSG_BYTES,
+               "the airtime bucket must hold one message");
+
+static TaskHandle_t     s_task;
+static event_sub_t      s_sub = -1;
+static volatile int8_t  s_cmd = -1;     /* from MQTT: -1 none, 0 off, 1 on */
+static volatile int     s_cmd_fps;
+static mirror_stats_t   s_stats;
+
+/* Session, owned by the mirror task */
+static bool             s_on;
+static bool             s_key;          /* this sweep sends every tile    */
+static int              s_cursor;       /* next tile of the sweep         */
+static uint32_t         s_sweep_tiles;  /* tiles sent in this sweep       */
+static uint16_t         s_seq;
+static int              s_fps;
+static int64_t          s_start_us, s_next_us, s_fill_us;
+static int32_t          s_tokens;       /* airtime budget, bytes          */
+static uint8_t         *s_shadow;       /* what the viewer has, per tile  */
+
+static EXT_RAM_BSS_ATTR uint8_t s_msg[APP_MIRROR_MSG_BYTES];
+static int              s_msg_len, s_msg_tiles;
+static uint8_t          s_raw[TILE_BYTES] __attribute__((aligned(4)));
+#if APP_LCD_FB_INDEXED
+static uint16_t         s_px[TILE_PX];
+#endif
+
+static inline uint8_t *put16(uint8_t *p, uint16_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    return p + 2;
+}
+
+static inline uint8_t *put32(uint8_t *p, uint32_t v)
+{
+    return put16(put16(p, v), v >> 16);
+}
+
+/* ── Encoding ─────────────────────────────────────────────────────────── */
+
+static int rle_encode(uint8_t *out, const uint16_t *px, int n)
+{
+    uint8_t *o = out;
+    int      i = 0;
+
+    while (i < n) {
+        int run = 1;
+        while (i + run < n && run < 128 && px[i + run] == px[i]) run++;
+        if (run >= 2) {
+            *o++ = run - 1;
+            o = put16(o, px[i]);
+            i += run;
+            continue;
+        }
+        /* Literals up to the next pair of equal pixels */
+        int lit = 1;
+        while (i + lit < n && lit < 128 &&
+               !(i + lit + 1 < n && px[i + lit] == px[i + lit + 1])) {
+            lit++;
+        }
+        *o++ = 0x7F + lit;
+        for (int k = 0; k < lit; k++) o = put16(o, px[i + k]);
+        i += lit;
+    }
+    return o - out;
+}
+
+/* Header in front of the tiles gathered so far; publish; start over.
+   Returns why the session must end, or NULL. */
+static const char *flush(uint8_t flags)
+{
+    if (!s_msg_tiles && !(flags & MIRROR_F_END)) return NULL;
+#if APP_MIRROR_STOP_ON_QR
+    /* Set before the UI draws the QR: nothing drawn after it leaves */
+    if (mqtt_service_has_qr_data()) return "qr";
+#endif
+
+    uint8_t *p = s_msg;
+    *p++ = MIRROR_MAGIC;
+    *p++ = MIRROR_VERSION;
+    *p++ = flags | (s_key ? MIRROR_F_KEY : 0);
+    *p++ = MIRROR_TILE;
+    p = put16(p, s_seq);
+    p = put16(p, APP_LCD_H_RES);
+    p = put16(p, APP_LCD_V_RES);
+    p = put16(p, s_msg_tiles);
+    put32(p, (esp_timer_get_time() - s_start_us) / 1000);
+
+    esp_err_t err = mqtt_service_publish(APP_MQTT_TOPIC_MIRROR_DATA,
+                                         (const char *)s_msg, s_msg_len,
+                                         0, false);
+    s_tokens       -= s_msg_len;
+    s_stats.bytes  += s_msg_len;
+    s_stats.tiles  += s_msg_tiles;
+    s_msg_len   = MIRROR_HDR_BYTES;
+    s_msg_tiles = 0;
+    return err == ESP_OK ? NULL : "offline";
+}
+
+/* One tick of the sweep.  Returns why the session must end, or NULL. */
+static const char *sweep(void)
+{
+    const uint8_t *fb   = lcd_scanout_get_front();
+    int64_t        t0   = esp_timer_get_time();
+    const char    *stop = NULL;
+
+    for (int n = 0; n < TILE_CNT && !stop; n++) {
+        if (n && esp_timer_get_time() - t0 > APP_MIRROR_CPU_US) {
+            s_stats.cut_cpu++;
+            break;
+        }
+
+        int            i   = s_cursor;
+        int            tx  = i % TILES_X;
+        int            ty  = i / TILES_X;
+        const uint8_t *src = fb + (ty * MIRROR_TILE * APP_LCD_H_RES +
+                                   tx * MIRROR_TILE) * FB_BPP;
+        uint8_t       *sh  = s_shadow + i * TILE_BYTES;
+
+        for (int y = 0; y < MIRROR_TILE; y++) {
+            memcpy(s_raw + y * TROW_BYTES, src + y * LINE_BYTES, TROW_BYTES);
+        }
+
+        if (s_key || memcmp(s_raw, sh, TILE_BYTES)) {
+            if (s_msg_len + TILE_HDR + RLE_MAX > APP_MIRROR_MSG_BYTES) {
+                if ((stop = flush(0))) break;
+            }
+#if APP_LCD_FB_INDEXED
+            for (int k = 0; k < TILE_PX; k++) {
+                s_px[k] = lcd_scanout_index_color(s_raw[k]);
+            }
+            const uint16_t *px = s_px;
+#else
+            const uint16_t *px = (const uint16_t *)s_raw;
+#endif
+            uint8_t *t   = s_msg + s_msg_len;
+            int      len = rle_encode(t + TILE_HDR, px, TILE_PX);
+            if (s_tokens < s_msg_len + TILE_HDR + len) {
+                s_stats.cut_bytes++;
+                break;                          /* resume at this tile */
+            }
+            t[0] = tx;
+            t[1] = ty;
+            put16(t + 2, len);
+            s_msg_len += TILE_HDR + len;
+            s_msg_tiles++;
+            s_sweep_tiles++;
+            memcpy(sh, s_raw, TILE_BYTES);
+        }
+
+        if (++s_cursor == TILE_CNT) {
+            s_cursor = 0;
+            if (s_sweep_tiles) {
+                stop = flush(MIRROR_F_END);
+                s_stats.frames++;
+                s_seq++;
+            }
+            s_sweep_tiles = 0;
+            s_key = false;
+            break;                              /* one frame per tick */
+        }
+    }
+    if (!stop) stop = flush(0);
+
+    uint32_t us = esp_timer_get_time() - t0;
+    s_stats.cpu_us_last = us;
+    if (us > s_stats.cpu_us_max) s_stats.cpu_us_max = us;
+    return stop;
+}
+
+/* ── Session ──────────────────────────────────────────────────────────── */
+
+static void report(bool on, const char *reason)
+{
+    char msg[64];
+    int  n = snprintf(msg, sizeof(msg),
+                      "{\"on\":%s,\"reason\":\"%s\",\"fps\":%d}",
+                      on ? "true" : "false", reason, on ? s_fps : 0);
+    mqtt_service_publish(APP_MQTT_TOPIC_MIRROR_STATE, msg, n, 1, false);
+}
+
+static void stop(const char *reason)
+{
+    if (!s_on) return;
+    s_on = false;
+    ESP_LOGI(TAG, "Stopped (%s): %lu frames, %lu tiles, %lu B so far",
+             reason, (unsigned long)s_stats.frames,
+             (unsigned long)s_stats.tiles, (unsigned long)s_stats.bytes);
+    report(false, reason);
+}
+
+static void start(int fps)
+{
+#if APP_MIRROR_STOP_ON_QR
+    if (mqtt_service_has_qr_data()) {
+        if (s_on) stop("qr");
+        else      report(false, "qr");
+        return;
+    }
+#endif
+    if (!s_shadow) {
+        s_shadow = heap_caps_malloc(TILE_CNT * TILE_BYTES, MALLOC_CAP_SPIRAM);
+        if (!s_shadow) {
+            ESP_LOGE(TAG, "no memory for the shadow framebuffer");
+            report(false, "no memory");
+            return;
+        }
+    }
+
+    int64_t now = esp_timer_get_time();
+    if (!s_on) {
+        s_stats.sessions++;
+        s_tokens  = BUCKET_MAX;
+        s_fill_us = now;
+    }
+    s_on          = true;
+    s_fps         = fps < 1 ? 1 : fps > APP_MIRROR_FPS_MAX ? APP_MIRROR_FPS_MAX
+                                                           : fps;
+    s_key         = true;
+    s_cursor      = 0;
+    s_sweep_tiles = 0;
+    s_msg_len     = MIRROR_HDR_BYTES;
+    s_msg_tiles   = 0;
+    s_start_us    = now;
+    s_next_us     = now;
+    ESP_LOGI(TAG, "Streaming at %d fps", s_fps);
+    report(true, "start");
+}
+
+static void mirror_task(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        TickType_t wait = portMAX_DELAY;
+        if (s_on) {
+            int64_t left = s_next_us - esp_timer_get_time();
+            wait = left > 0 ? pdMS_TO_TICKS(left / 1000) + 1 : 0;
+        }
+        ulTaskNotifyTake(pdTRUE, wait);
+
+        event_t ev;
+        while (event_bus_get(s_sub, &ev)) {
+            if (ev.type == EV_MQTT_DOWN) {
+                stop("offline");
+            } else if (ev.type == EV_QR_SHOW) {
+                stop("qr");
+            } else if (ev.type == EV_OVERFLOW) {
+                if (!mqtt_service_is_connected()) stop("offline");
+#if APP_MIRROR_STOP_ON_QR
+                if (mqtt_service_has_qr_data()) stop("qr");
+#endif
+            }
+        }
+
+        int8_t cmd = s_cmd;
+        if (cmd >= 0) {
+            s_cmd = -1;
+            if (cmd) start(s_cmd_fps);
+            else     stop("request");
+        }
+        if (!s_on) continue;
+
+        int64_t now = esp_timer_get_time();
+        if (now < s_next_us) continue;
+        s_next_us = now + 1000000 / s_fps;
+
+        if (now - s_start_us > APP_MIRROR_MAX_S * 1000000LL) {
+            stop("timeout");
+            continue;
+        }
+        if (mqtt_service_get_outbox_bytes() > APP_OUTBOX_MQTT_HIGH_BYTES) {
+            s_stats.skipped++;
+            continue;
+        }
+
+        int64_t fill = (now - s_fill_us) * APP_MIRROR_BYTES_PER_S / 1000000;
+        s_tokens   = fill + s_tokens > BUCKET_MAX ? BUCKET_MAX
+                                                  : s_tokens + fill;
+        s_fill_us  = now;
+
+        const char *why = sweep();
+        if (why) stop(why);
+    }
+}
+
+/* ── MQTT command (MQTT task context) ─────────────────────────────────── */
+
+static void on_mirror_cmd(const char *data, int len)
+{
+    cJSON *root = cJSON_ParseWithLength(data, len);
+    if (!root) {
+        ESP_LOGW(TAG, "mirror: invalid JSON");
+        return;
+    }
+    const cJSON *on  = cJSON_GetObjectItemCaseSensitive(root, "on");
+    const cJSON *fps = cJSON_GetObjectItemCaseSensitive(root, "fps");
+    if (cJSON_IsBool(on)) {
+        s_cmd_fps = cJSON_IsNumber(fps) ? fps->valueint
+                                        : APP_MIRROR_FPS_DEFAULT;
+        s_cmd     = cJSON_IsTrue(on);
+        xTaskNotifyGive(s_task);
+    }
+    cJSON_Delete(root);
+}
+
+/* ── Public API ───────────────────────────────────────────────────────── */
+
+esp_err_t screen_mirror_init(void)
+{
+    BaseType_t ok = xTaskCreate(mirror_task, "mirror", APP_MIRROR_TASK_STACK,
+                                NULL, APP_MIRROR_TASK_PRIO, &s_task);
+    ESP_RETURN_ON_FALSE(ok == pdPASS, ESP_ERR_NO_MEM, TAG,
+                        "task create failed");
+
+    uint32_t mask = EV_BIT(EV_MQTT_DOWN);
+#if APP_MIRROR_STOP_ON_QR
+    mask |= EV_BIT(EV_QR_SHOW);
+#endif
+    s_sub = event_bus_subscribe(mask, s_task);
+    ESP_RETURN_ON_FALSE(s_sub >= 0, ESP_ERR_NO_MEM, TAG,
+                        "no event bus slot");
+
+    return mqtt_service_register_handler(APP_MQTT_TOPIC_MIRROR,
+                                         on_mirror_cmd);
+}
+
+bool screen_mirror_is_active(void)
+{
+    return s_on;
+}
+
+void screen_mirror_get_stats(mirror_stats_t *out)
+{
+    *out = s_stats;
+}
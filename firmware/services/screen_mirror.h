@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/* Wire format of APP_MQTT_TOPIC_MIRROR_DATA (little-endian):
+ *
+ *   header   u8 magic, u8 version, u8 flags, u8 tile size,
+ *            u16 frame seq, u16 width, u16 height, u16 tile count,
+ *            u32 ms since the session started
+ *   tiles    u8 tile x, u8 tile y, u16 length, RLE data
+ *
+ * RLE over RGB565 pixels, row-major within the tile: a control byte
+ * c < 0x80 repeats the following pixel c + 1 times, c >= 0x80 is followed
+ * by c - 0x7F literal pixels.
+ */
+#define MIRROR_MAGIC        0xB2
+#define MIRROR_VERSION      1
+#define MIRROR_TILE         16
+#define MIRROR_HDR_BYTES    16
+#define MIRROR_F_KEY        0x01    /* tile of a full frame                */
+#define MIRROR_F_END        0x02    /* last message of a frame             */
+
+/** Mirror counters (monotonic since boot). */
+typedef struct {
+    uint32_t sessions;
+    uint32_t frames;            /* completed scans that sent tiles        */
+    uint32_t tiles;
+    uint32_t bytes;             /* published, headers included            */
+    uint32_t cpu_us_last;       /* scan + encode of the last tick         */
+    uint32_t cpu_us_max;
+    uint32_t cut_cpu;           /* ticks cut short by APP_MIRROR_CPU_US   */
+    uint32_t cut_bytes;         /* … by APP_MIRROR_BYTES_PER_S            */
+    uint32_t skipped;           /* ticks skipped, MQTT outbox backed up   */
+} mirror_stats_t;
+
+/**
+ * Register APP_MQTT_TOPIC_MIRROR and start the (idle) mirror task.  Call
+ * after lcd_st7701_init() and before mqtt_service_init().
+ */
+esp_err_t screen_mirror_init(void);
+
+/**
+ * True while a mirror session is streaming.
+ */
+bool screen_mirror_is_active(void);
+
+/**
+ * Copy the mirror counters into @p out.
+ */
+void screen_mirror_get_stats(mirror_stats_t *out);
@@ -4,10 +4,12 @@
  * Initialisation is non-blocking: the lwIP SNTP client sends periodic
  * requests in the background.  When WiFi comes up and a response
  * arrives, the system clock is stepped and the sync callback sets the
- * flag returned by time_service_is_time_valid().
+ * flag returned by time_service_is_time_valid() and, the first time,
+ * publishes EV_TIME_VALID.
  *
- * The timezone is applied before the first sync so that localtime_r()
- * returns local time as soon as the clock is set.
+ * The timezone (APP_TZ, or the "tz" of the runtime configuration) is
+ * applied before the first sync so that localtime_r() returns local time
+ * as soon as the clock is set, and can be replaced at any time.
  */
 
 #include "time_service.h"
@@ -16,13 +18,11 @@
 
 #include "esp_log.h"
 #include "esp_netif_sntp.h"
+#include "config_service.h"
+#include "event_bus.h"
 
 static const char *TAG = "time_svc";
 
-/* POSIX TZ string – adjust for your locale.
-   ICT = Indochina Time, UTC+7, no DST. */
-#define APP_TZ          "ICT-7"
-
 #define APP_NTP_SERVER  "pool.ntp.org"
 
 static volatile bool s_valid;
@@ -32,7 +32,10 @@ static volatile bool s_valid;
 static void on_time_sync(struct timeval *tv)
 {
     (void)tv;
-    s_valid = true;
+    if (!s_valid) {
+        s_valid = true;
+        event_bus_publish(EV_TIME_VALID, 0);
+    }
 
     time_t now = time(NULL);
     struct tm t;
@@ -48,16 +51,21 @@ void time_service_init(void)
 {
     /* Set timezone before the first sync so localtime_r() returns
        local time immediately once the clock is set. */
-    setenv("TZ", APP_TZ, 1);
-    tzset();
+    const char *tz = config_service_get()->tz;
+    time_service_set_tz(tz);
 
     esp_sntp_config_t cfg = ESP_NETIF_SNTP_DEFAULT_CONFIG(APP_NTP_SERVER);
     cfg.sync_cb = on_time_sync;
 
     ESP_ERROR_CHECK(esp_netif_sntp_init(&cfg));
 
-    ESP_LOGI(TAG, "SNTP started – server %s, TZ %s",
-             APP_NTP_SERVER, APP_TZ);
+    ESP_LOGI(TAG, "SNTP started – server %s, TZ %s", APP_NTP_SERVER, tz);
+}
+
+void time_service_set_tz(const char *tz)
+{
+    setenv("TZ", tz, 1);
+    tzset();
 }
 
 bool time_service_is_time_valid(void)
@@ -15,3 +15,9 @@ void time_service_init(void);
  * Returns true once SNTP has synchronised the system clock.
  */
 bool time_service_is_time_valid(void);
+
+/**
+ * Replace the POSIX TZ string (e.g. "ICT-7"); localtime_r() in every task
+ * uses it from the next call.
+ */
+void time_service_set_tz(const char *tz);
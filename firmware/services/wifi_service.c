@@ -9,9 +9,15 @@
  * If the retry limit is hit the service stops reconnecting and logs
  * an error.  A successful connection (GOT_IP) always resets the
  * counter, so a later disconnect restarts the full retry budget.
+ *
+ * QEMU builds (CONFIG_APP_QEMU) bring up the emulator's open-eth NIC
+ * instead of WiFi and publish the same EV_WIFI_UP / EV_WIFI_DOWN, so the
+ * services above cannot tell.  Without a NIC (-nic none) the firmware
+ * keeps running offline, as with an unreachable AP.
  */
 
 #include "wifi_service.h"
+#include "event_bus.h"
 #include "app_config.h"
 #include "secrets.h"
 
@@ -24,11 +30,16 @@
 #include "esp_event.h"
 #include "esp_netif.h"
 #include "nvs_flash.h"
+#include "sdkconfig.h"
+#if CONFIG_APP_QEMU
+#include "esp_eth.h"
+#endif
 
 static const char *TAG = "wifi";
 
-static volatile bool s_connected;
-static int           s_retry_count;
+static volatile bool     s_connected;
+static volatile uint32_t s_ip;          /* esp_ip4_addr_t.addr, 0 = none */
+static int               s_retry_count;
 
 /* ── Event handler ───────────────────────────────────────────────────── */
 
@@ -44,7 +55,10 @@ static void wifi_event_handler(void *arg, esp_event_base_t base,
             break;
 
         case WIFI_EVENT_STA_DISCONNECTED: {
-            s_connected = false;
+            if (s_connected) {
+                s_connected = false;
+                event_bus_publish(EV_WIFI_DOWN, 0);
+            }
             if (s_retry_count < APP_WIFI_MAX_RETRY) {
                 s_retry_count++;
                 ESP_LOGW(TAG, "Disconnected – retry %d/%d",
@@ -61,14 +75,58 @@ static void wifi_event_handler(void *arg, esp_event_base_t base,
             break;
         }
 
-    } else if (base == IP_EVENT && id == IP_EVENT_STA_GOT_IP) {
+    } else if (base == IP_EVENT && (id == IP_EVENT_STA_GOT_IP ||
+                                    id == IP_EVENT_ETH_GOT_IP)) {
         ip_event_got_ip_t *ev = data;
         ESP_LOGI(TAG, "Connected – IP: " IPSTR, IP2STR(&ev->ip_info.ip));
+        s_ip = ev->ip_info.ip.addr;
         s_retry_count = 0;
         s_connected   = true;
+        event_bus_publish(EV_WIFI_UP, 0);
+    }
+}
+
+#if CONFIG_APP_QEMU
+static void eth_event_handler(void *arg, esp_event_base_t base,
+                              int32_t id, void *data)
+{
+    if (id == ETHERNET_EVENT_DISCONNECTED && s_connected) {
+        s_connected = false;
+        event_bus_publish(EV_WIFI_DOWN, 0);
     }
 }
 
+static void eth_start(void)
+{
+    eth_mac_config_t mac_cfg = ETH_MAC_DEFAULT_CONFIG();
+    eth_phy_config_t phy_cfg = ETH_PHY_DEFAULT_CONFIG();
+    phy_cfg.autonego_timeout_ms = 100;
+    esp_eth_mac_t   *mac = esp_eth_mac_new_openeth(&mac_cfg);
+    esp_eth_phy_t   *phy = esp_eth_phy_new_dp83848(&phy_cfg);
+    esp_eth_config_t cfg = ETH_DEFAULT_CONFIG(mac, phy);
+
+    esp_eth_handle_t eth = NULL;
+    if (!mac || !phy || esp_eth_driver_install(&cfg, &eth) != ESP_OK) {
+        ESP_LOGE(TAG, "QEMU: no open-eth NIC, running offline");
+        return;
+    }
+
+    esp_netif_config_t netif_cfg = ESP_NETIF_DEFAULT_ETH();
+    esp_netif_t       *netif     = esp_netif_new(&netif_cfg);
+    ESP_ERROR_CHECK(esp_netif_attach(netif, esp_eth_new_netif_glue(eth)));
+
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(
+        ETH_EVENT, ETHERNET_EVENT_DISCONNECTED,
+        eth_event_handler, NULL, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(
+        IP_EVENT, IP_EVENT_ETH_GOT_IP,
+        wifi_event_handler, NULL, NULL));
+
+    ESP_ERROR_CHECK(esp_eth_start(eth));
+    ESP_LOGW(TAG, "QEMU: open-eth instead of WiFi");
+}
+#endif
+
 /* ── Public API ──────────────────────────────────────────────────────── */
 
 void wifi_service_init(void)
@@ -85,11 +143,18 @@ void wifi_service_init(void)
     /* ── Network interface + default event loop ──────────────────── */
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
+#if CONFIG_APP_QEMU
+    eth_start();
+    return;
+#endif
     esp_netif_create_default_wifi_sta();
 
     /* ── WiFi driver ─────────────────────────────────────────────── */
     wifi_init_config_t init_cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&init_cfg));
+    /* Credentials come from secrets.h – keep the driver off NVS, so its
+       writes cannot bypass flash_sched. */
+    ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
 
     /* ── Event handlers ──────────────────────────────────────────── */
     ESP_ERROR_CHECK(esp_event_handler_instance_register(
@@ -126,3 +191,15 @@ bool wifi_service_is_connected(void)
 {
     return s_connected;
 }
+
+uint32_t wifi_service_get_ip(void)
+{
+    return s_connected ? s_ip : 0;
+}
+
+int wifi_service_get_rssi(void)
+{
+    wifi_ap_record_t ap;
+    if (!s_connected || esp_wifi_sta_get_ap_info(&ap) != ESP_OK) return 0;
+    return ap.rssi;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 
 /**
  * Initialise WiFi in STA mode and begin connecting.
@@ -12,6 +13,18 @@
 void wifi_service_init(void);
 
 /**
- * Returns true once an IP address has been obtained.
+ * Returns true once an IP address has been obtained.  Transitions are
+ * published as EV_WIFI_UP / EV_WIFI_DOWN (event_bus.h).
  */
 bool wifi_service_is_connected(void);
+
+/**
+ * Current IPv4 address (esp_ip4_addr_t.addr, network order); 0 while not
+ * connected.
+ */
+uint32_t wifi_service_get_ip(void);
+
+/**
+ * Signal strength of the current AP in dBm; 0 while not connected.
+ */
+int wifi_service_get_rssi(void);
@@ -0,0 +1,34 @@
+/* Host stub: enough of cJSON to compile; the tests never parse. */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct cJSON {
+    double valuedouble;
+} cJSON;
+
+static inline cJSON *cJSON_ParseWithLength(const char *value, size_t len)
+{
+    (void)value;
+    (void)len;
+    return NULL;
+}
+
+static inline cJSON *cJSON_GetObjectItemCaseSensitive(const cJSON *object,
+                                                      const char *string)
+{
+    (void)object;
+    (void)string;
+    return NULL;
+}
+
+static inline bool cJSON_IsNumber(const cJSON *item)
+{
+    return item != NULL;
+}
+
+static inline void cJSON_Delete(cJSON *item)
+{
+    (void)item;
+}
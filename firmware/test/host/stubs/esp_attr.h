@@ -0,0 +1,6 @@
+/* Host stub: placement attributes are no-ops. */
+#pragma once
+
+#define EXT_RAM_BSS_ATTR
+#define IRAM_ATTR
+#define RTC_NOINIT_ATTR
@@ -0,0 +1,12 @@
+/* Host stub: ESP_RETURN_ON_FALSE from esp_check.h. */
+#pragma once
+
+#include "esp_err.h"
+#include "esp_log.h"
+
+#define ESP_RETURN_ON_FALSE(a, err_code, log_tag, fmt, ...) do {    \
+        if (!(a)) {                                                 \
+            ESP_LOGE(log_tag, fmt, ##__VA_ARGS__);                  \
+            return err_code;                                        \
+        }                                                           \
+    } while (0)
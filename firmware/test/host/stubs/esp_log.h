@@ -0,0 +1,12 @@
+/* Host stub: logging compiles (arguments type-checked) but prints nothing. */
+#pragma once
+
+#include <stdio.h>
+
+#define ESP_LOG_STUB(tag, fmt, ...) \
+    do { (void)(tag); if (0) printf(fmt, ##__VA_ARGS__); } while (0)
+
+#define ESP_LOGE ESP_LOG_STUB
+#define ESP_LOGW ESP_LOG_STUB
+#define ESP_LOGI ESP_LOG_STUB
+#define ESP_LOGD ESP_LOG_STUB
@@ -0,0 +1,12 @@
+/* Host stub. */
+#pragma once
+
+typedef enum {
+    ESP_RST_UNKNOWN,
+    ESP_RST_POWERON,
+} esp_reset_reason_t;
+
+static inline esp_reset_reason_t esp_reset_reason(void)
+{
+    return ESP_RST_POWERON;
+}
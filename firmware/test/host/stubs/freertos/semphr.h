@@ -0,0 +1,25 @@
+/* Host stub: single-threaded, so a mutex is a token. */
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct stub_sem *SemaphoreHandle_t;
+
+static inline SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    static int token;
+    return (SemaphoreHandle_t)&token;
+}
+
+static inline BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t wait)
+{
+    (void)s;
+    (void)wait;
+    return pdTRUE;
+}
+
+static inline BaseType_t xSemaphoreGive(SemaphoreHandle_t s)
+{
+    (void)s;
+    return pdTRUE;
+}
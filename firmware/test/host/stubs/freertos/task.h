@@ -0,0 +1,38 @@
+/* Host stub: tasks are never started; notifications are counted. */
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct stub_task *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+extern uint32_t stub_task_notify;       /* pending notification count */
+
+static inline BaseType_t xTaskCreate(TaskFunction_t fn, const char *name,
+                                     uint32_t stack, void *arg,
+                                     UBaseType_t prio, TaskHandle_t *out)
+{
+    (void)fn; (void)name; (void)stack; (void)arg; (void)prio;
+    if (out) *out = (TaskHandle_t)&stub_task_notify;
+    return pdPASS;
+}
+
+static inline BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    (void)task;
+    stub_task_notify++;
+    return pdPASS;
+}
+
+static inline uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait)
+{
+    (void)wait;
+    uint32_t n = stub_task_notify;
+    stub_task_notify = clear ? 0 : (n ? n - 1 : 0);
+    return n;
+}
+
+static inline void vTaskDelay(TickType_t ticks)
+{
+    (void)ticks;
+}
@@ -0,0 +1,400 @@
+/*
+ * Host test: the transaction journal on a stubbed "journal" partition.
+ *
+ * services/journal_service.c is compiled in whole against the headers in
+ * stubs/; the partition is a RAM image of NSEC sectors with NOR rules
+ * (erase to 0xFF, a write may only clear bits, no write across a page).
+ * No task runs: the test does the journal task's work by calling flush()
+ * and run_query() itself.  Checked:
+ *   - every flash write is page-sized or less and stays inside its page;
+ *   - the ring wraps, erasing one sector per lap, and always holds a
+ *     contiguous run of sequence numbers;
+ *   - a reboot rebuilds the same index and write position, including
+ *     right on a sector boundary;
+ *   - a narrow range query reads only 1-2 of the NSEC sectors;
+ *   - a stream never swallows the notification of a newer query.
+ *
+ *     make -C firmware/test/host
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "app_config.h"
+#include "esp_partition.h"
+#include "esp_timer.h"
+#include "flash_sched.h"
+#include "mqtt_service.h"
+#include "time_service.h"
+
+#define NSEC        8
+#define FL_SECTOR   4096
+#define FL_PAGE     256
+
+static int s_fail;
+
+#define CHECK(cond) do {                                                \
+        if (!(cond) && s_fail++ < 20) {                                 \
+            fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond);  \
+        }                                                               \
+    } while (0)
+
+/* ── Fakes ────────────────────────────────────────────────────────────── */
+
+static uint8_t s_flash[NSEC * FL_SECTOR];
+static const esp_partition_t s_fake_part = {
+    .type    = ESP_PARTITION_TYPE_DATA,
+    .subtype = (esp_partition_subtype_t)0x41,
+    .size    = sizeof(s_flash),
+    .label   = "journal",
+};
+
+static struct {
+    uint32_t writes, bad_writes, erases, sector_reads;
+} s_fl;
+
+uint32_t stub_task_notify;
+
+static int64_t  s_now_us;
+static uint32_t s_unix = 1700000000;
+
+static char     s_pub[1 << 16];         /* journal/data payloads, joined */
+static size_t   s_pub_len;
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type,
+                                                esp_partition_subtype_t subtype,
+                                                const char *label)
+{
+    (void)type;
+    (void)subtype;
+    return strcmp(label, "journal") == 0 ? &s_fake_part : NULL;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *part, size_t src_offset,
+                             void *dst, size_t size)
+{
+    if (src_offset + size > part->size) return ESP_ERR_INVALID_SIZE;
+    memcpy(dst, s_flash + src_offset, size);
+    if (size == FL_SECTOR) s_fl.sector_reads++;
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *part, size_t dst_offset,
+                              const void *src, size_t size)
+{
+    if (dst_offset + size > part->size) return ESP_ERR_INVALID_SIZE;
+    s_fl.writes++;
+    if (dst_offset % FL_PAGE + size > FL_PAGE) s_fl.bad_writes++;
+    const uint8_t *b = src;
+    for (size_t i = 0; i < size; i++) {
+        if (b[i] & ~s_flash[dst_offset + i]) s_fl.bad_writes++;  /* 0 → 1 */
+        s_flash[dst_offset + i] &= b[i];
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *part,
+                                    size_t offset, size_t size)
+{
+    if (offset % FL_SECTOR || size % FL_SECTOR || offset + size > part->size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(s_flash + offset, 0xFF, size);
+    s_fl.erases++;
+    return ESP_OK;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return s_now_us;
+}
+
+static time_t fake_time(time_t *t)
+{
+    if (t) *t = s_unix;
+    return s_unix;
+}
+
+bool time_service_is_time_valid(void)
+{
+    return true;
+}
+
+void flash_sched_begin(flash_client_t cl)
+{
+    (void)cl;
+}
+
+void flash_sched_end(flash_client_t cl)
+{
+    (void)cl;
+}
+
+int mqtt_service_get_outbox_bytes(void)
+{
+    return 0;
+}
+
+bool mqtt_service_is_connected(void)
+{
+    return true;
+}
+
+esp_err_t mqtt_service_publish(const char *topic, const char *data, int len,
+                               int qos, bool retain)
+{
+    (void)qos;
+    (void)retain;
+    if (strcmp(topic, APP_MQTT_TOPIC_JOURNAL_DATA) != 0) return ESP_FAIL;
+    if (s_pub_len + len + 2 > sizeof(s_pub)) return ESP_ERR_NO_MEM;
+    memcpy(s_pub + s_pub_len, data, len);
+    s_pub_len += len;
+    s_pub[s_pub_len++] = '\n';
+    s_pub[s_pub_len]   = '\0';
+    return ESP_OK;
+}
+
+esp_err_t mqtt_service_register_handler(const char *topic,
+                                        mqtt_topic_handler_t handler)
+{
+    (void)topic;
+    (void)handler;
+    return ESP_OK;
+}
+
+/* ── Unit under test ──────────────────────────────────────────────────── */
+
+#define time(t) fake_time(t)
+#include "journal_service.c"
+#undef time
+
+/* ── Helpers ──────────────────────────────────────────────────────────── */
+
+/* Power cycle: RAM state (and any unflushed batch) is lost, the flash
+   image stays; init rebuilds the index and logs a boot record. */
+static void reboot(void)
+{
+    free(s_idx);
+    s_idx      = NULL;
+    s_part     = NULL;
+    s_nsec     = 0;
+    s_wr       = 0;
+    s_wr_sec   = -1;
+    s_seq      = 1;
+    s_task     = NULL;
+    s_pend_cnt = 0;
+    memset(&s_query, 0, sizeof(s_query));
+    memset(&s_stats, 0, sizeof(s_stats));
+    stub_task_notify = 0;
+    CHECK(journal_service_init() == ESP_OK);
+    CHECK(s_stats.logged == 1);                 /* the boot record */
+}
+
+static void fresh(void)
+{
+    memset(s_flash, 0xFF, sizeof(s_flash));
+    memset(&s_fl, 0, sizeof(s_fl));
+    reboot();
+}
+
+/* Log @p n events @p dt seconds apart, doing the journal task's part:
+   a page-full wake-up writes the batch, and every @p idle_every events
+   the quiet-time flush writes a partial page. */
+static void log_n(int n, uint32_t dt, int idle_every)
+{
+    for (int i = 0; i < n; i++) {
+        s_unix   += dt;
+        s_now_us += dt * 1000000LL;
+        journal_log(JOURNAL_EV_SHOW, 0, NULL);
+        if (ulTaskNotifyTake(pdTRUE, 0)) flush();
+        if (idle_every && (i + 1) % idle_every == 0) flush();
+    }
+    flush();
+}
+
+/* Every valid record in the image: the seqs must be exactly
+   oldest..newest, each once. */
+static void check_contiguous(void)
+{
+    static uint8_t seen[NSEC * REC_PER_SEC];
+    uint32_t n = 0, lo = UINT32_MAX, hi = 0;
+    memset(seen, 0, sizeof(seen));
+    for (uint32_t slot = 0; slot < NSEC * REC_PER_SEC; slot++) {
+        const rec_t *r = (const rec_t *)(s_flash + slot * sizeof(rec_t));
+        if (!rec_valid(r)) continue;
+        n++;
+        if (r->seq < lo) lo = r->seq;
+        if (r->seq > hi) hi = r->seq;
+    }
+    CHECK(n == s_stats.stored);
+    CHECK(!n || lo == s_stats.oldest_seq);
+    CHECK(!n || hi == s_stats.newest_seq);
+    CHECK(!n || hi - lo + 1 == n);
+    for (uint32_t slot = 0; n && slot < NSEC * REC_PER_SEC; slot++) {
+        const rec_t *r = (const rec_t *)(s_flash + slot * sizeof(rec_t));
+        if (!rec_valid(r)) continue;
+        CHECK(r->seq - lo < n && !seen[r->seq - lo]);
+        if (r->seq - lo < n) seen[r->seq - lo] = 1;
+    }
+}
+
+static uint32_t count_lines(const char *key)
+{
+    uint32_t n = 0;
+    for (const char *p = s_pub; (p = strstr(p, key)); p += strlen(key)) n++;
+    return n;
+}
+
+/* ── Tests ────────────────────────────────────────────────────────────── */
+
+static void test_page_writes_and_wrap(void)
+{
+    fresh();
+    log_n(3 * NSEC * REC_PER_SEC + 17, 1, 7);   /* three laps and a bit */
+
+    uint32_t total = s_stats.logged;
+    CHECK(s_fl.bad_writes == 0);
+    CHECK(s_stats.flash_writes == s_fl.writes);
+    /* one erase per sector entered */
+    CHECK(s_fl.erases == (total + REC_PER_SEC - 1) / REC_PER_SEC);
+    CHECK(s_stats.stored > (NSEC - 1) * REC_PER_SEC);
+    CHECK(s_stats.stored <= NSEC * REC_PER_SEC);
+    CHECK(s_stats.newest_seq == total);
+    check_contiguous();
+}
+
+/* Log up to @p records in total, reboot, and compare. */
+static void reboot_after(uint32_t records, int idle_every)
+{
+    fresh();
+    log_n(records - 1, 1, idle_every);          /* plus the boot record */
+
+    sec_idx_t idx[NSEC];
+    memcpy(idx, s_idx, sizeof(idx));
+    uint32_t wr = s_wr, newest = s_stats.newest_seq;
+    journal_stats_t st = s_stats;
+
+    reboot();
+    CHECK(s_wr == wr);
+    CHECK(s_stats.stored == st.stored);
+    CHECK(s_stats.oldest_seq == st.oldest_seq);
+    CHECK(s_stats.newest_seq == newest);
+    CHECK(s_seq == newest + 2);                 /* new boot record pending */
+    for (int i = 0; i < NSEC; i++) {
+        CHECK(s_idx[i].count == idx[i].count);
+        if (!idx[i].count) continue;
+        CHECK(s_idx[i].first_seq == idx[i].first_seq);
+        CHECK(s_idx[i].ts_min == idx[i].ts_min);
+        CHECK(s_idx[i].ts_max == idx[i].ts_max);
+    }
+
+    /* Appending carries on from there. */
+    uint32_t erases = s_fl.erases;
+    log_n(REC_PER_SEC + 3, 1, 0);
+    CHECK(s_fl.bad_writes == 0);
+    CHECK(s_fl.erases >= erases + 1);
+    CHECK(s_stats.newest_seq == newest + 1 + REC_PER_SEC + 3);
+    check_contiguous();
+}
+
+static void test_recovery(void)
+{
+    reboot_after(5, 0);
+    reboot_after(REC_PER_SEC - 1, 0);
+    reboot_after(REC_PER_SEC, 0);                   /* sector boundary  */
+    reboot_after(3 * REC_PER_SEC, 5);               /* boundary, torn pages */
+    reboot_after(NSEC * REC_PER_SEC, 0);            /* full, wraps next */
+    reboot_after(NSEC * REC_PER_SEC + 37, 3);       /* wrapped          */
+    reboot_after(2 * NSEC * REC_PER_SEC + REC_PER_SEC, 0);
+
+    /* Power lost right after the erase of the next, oldest sector. */
+    fresh();
+    log_n((NSEC + 2) * REC_PER_SEC - 1, 1, 0);
+    CHECK(s_wr == 2 * REC_PER_SEC);
+    esp_partition_erase_range(s_part, 2 * SECTOR, SECTOR);
+    uint32_t wr = s_wr, newest = s_stats.newest_seq;
+    reboot();
+    CHECK(s_wr == wr);
+    CHECK(s_stats.newest_seq == newest);
+    log_n(10, 1, 0);
+    CHECK(s_fl.bad_writes == 0);
+    check_contiguous();
+}
+
+static void test_range_query(void)
+{
+    fresh();
+    log_n(NSEC * REC_PER_SEC + 40, 10, 0);          /* wrapped, 10 s apart */
+
+    /* Sixty seconds in the middle of the oldest full sector, and a span
+       that crosses into the next one. */
+    uint32_t start = (s_wr / REC_PER_SEC + 1) % NSEC;
+    const rec_t *r = (const rec_t *)(s_flash + start * SECTOR);
+    const uint32_t span[][2] = {
+        { r[20].ts, r[26].ts },
+        { r[60].ts, r[60].ts + 100 },
+    };
+    for (size_t q = 0; q < sizeof(span) / sizeof(span[0]); q++) {
+        uint32_t want = 0;
+        for (uint32_t slot = 0; slot < NSEC * REC_PER_SEC; slot++) {
+            const rec_t *x = (const rec_t *)(s_flash + slot * sizeof(rec_t));
+            if (rec_valid(x) && in_range(x, span[q][0], span[q][1])) want++;
+        }
+        s_pub_len = 0;
+        s_pub[0]  = '\0';
+        s_fl.sector_reads = 0;
+        run_query(q, span[q][0], span[q][1], APP_JOURNAL_QUERY_MAX);
+        CHECK(want > 0);
+        CHECK(count_lines("\"seq\":") == want);
+        CHECK(s_fl.sector_reads == q + 1);
+        CHECK(s_stats.query_sectors_last == q + 1);
+        CHECK(strstr(s_pub, "\"done\":true") != NULL);
+    }
+
+    /* Everything, oldest first. */
+    s_pub_len = 0;
+    run_query(9, 0, UINT32_MAX, UINT32_MAX);
+    CHECK(count_lines("\"seq\":") == s_stats.stored);
+    uint32_t prev = 0;
+    for (const char *p = s_pub; (p = strstr(p, "\"seq\":")); p += 6) {
+        uint32_t seq = strtoul(p + 6, NULL, 10);
+        CHECK(seq > prev);
+        prev = seq;
+    }
+    CHECK(prev == s_stats.newest_seq);
+}
+
+static void test_query_keeps_notification(void)
+{
+    fresh();
+    log_n(REC_PER_SEC, 1, 0);
+
+    /* A page fills while a query streams: the stream writes it, and a
+       newer query's wake-up is still pending afterwards. */
+    for (uint32_t i = 0; i < REC_PER_PAGE; i++) {
+        journal_log(JOURNAL_EV_HIDE, 0, NULL);
+    }
+    stub_task_notify = 1;
+    s_pub_len = 0;
+    run_query(1, 0, UINT32_MAX, APP_JOURNAL_QUERY_MAX);
+    CHECK(s_pend_cnt == 0);
+    CHECK(stub_task_notify == 1);
+    check_contiguous();
+}
+
+int main(void)
+{
+    test_page_writes_and_wrap();
+    test_recovery();
+    test_range_query();
+    test_query_keeps_notification();
+
+    if (s_fail) {
+        fprintf(stderr, "FAIL: %d check(s)\n", s_fail);
+        return 1;
+    }
+    printf("ok: journal on a %d-sector stub partition\n", NSEC);
+    return 0;
+}
@@ -0,0 +1,87 @@
+/*
+ * Host test: the ST7701S init table replays the golden byte stream.
+ *
+ * Walks ST7701_INIT the way st7701_send() does – command frame, data
+ * frames, then the delay if any – and compares every line with
+ * st7701_init.golden, the stream of the hardware-verified inline init.
+ *
+ *     make -C firmware/test/host
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "lcd_st7701_seq.h"
+
+#define N_ITEMS(a)  (sizeof(a) / sizeof((a)[0]))
+
+static FILE *s_golden;
+static int   s_line;
+static int   s_fail;
+
+/* Next non-comment line of the golden file, "" at the end. */
+static const char *golden_next(void)
+{
+    static char buf[256];
+    while (fgets(buf, sizeof(buf), s_golden)) {
+        s_line++;
+        if (buf[0] == '#' || buf[0] == '\n') continue;
+        buf[strcspn(buf, "\n")] = '\0';
+        return buf;
+    }
+    return "";
+}
+
+static void expect(const char *got)
+{
+    const char *want = golden_next();
+    if (strcmp(got, want) != 0 && s_fail++ < 10) {
+        fprintf(stderr, "golden line %d: want \"%s\", table gives \"%s\"\n",
+                s_line, want, got);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = argc > 1 ? argv[1] : "st7701_init.golden";
+    s_golden = fopen(path, "r");
+    if (!s_golden) {
+        perror(path);
+        return 2;
+    }
+
+    char item[16];
+    int  frames = 0;
+    for (size_t i = 0; i < N_ITEMS(ST7701_INIT); i++) {
+        const st7701_cmd_t *c = &ST7701_INIT[i];
+        if (c->len > sizeof(c->data)) {
+            fprintf(stderr, "entry %zu: len %u\n", i, c->len);
+            return 1;
+        }
+        snprintf(item, sizeof(item), "cmd %02X", c->cmd);
+        expect(item);
+        frames++;
+        for (int j = 0; j < c->len; j++) {
+            snprintf(item, sizeof(item), "dat %02X", c->data[j]);
+            expect(item);
+            frames++;
+        }
+        if (c->delay_ms) {
+            snprintf(item, sizeof(item), "ms  %u", c->delay_ms);
+            expect(item);
+        }
+    }
+    const char *rest = golden_next();
+    if (rest[0] && s_fail++ < 10) {
+        fprintf(stderr, "golden line %d: \"%s\" not produced by the table\n",
+                s_line, rest);
+    }
+    fclose(s_golden);
+
+    if (s_fail) {
+        fprintf(stderr, "FAIL: %d mismatch(es)\n", s_fail);
+        return 1;
+    }
+    printf("ok: %d frames match %s\n", frames, path);
+    return 0;
+}
@@ -13,7 +13,7 @@
 #include "lvgl.h"
 #include "bg_rain.h"
 
-void bg_rain_create(lv_obj_t *parent)
+lv_obj_t *bg_rain_create(lv_obj_t *parent)
 {
     /* ── Base: dark gradient background ─────────────────────────────── */
     lv_obj_t *bg = lv_obj_create(parent);
@@ -83,4 +83,6 @@ void bg_rain_create(lv_obj_t *parent)
     lv_obj_set_style_bg_opa(fog, 8, 0);
     lv_obj_set_style_border_width(fog, 0, 0);
     lv_obj_clear_flag(fog, LV_OBJ_FLAG_SCROLLABLE);
+
+    return bg;
 }
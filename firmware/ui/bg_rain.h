@@ -5,5 +5,6 @@
 /**
  * Create the programmatic rain background scene.
  * Call once during UI init — all objects are parented to @p parent.
+ * Returns the scene's root object (hide it to show a plain background).
  */
-void bg_rain_create(lv_obj_t *parent);
+lv_obj_t *bg_rain_create(lv_obj_t *parent);
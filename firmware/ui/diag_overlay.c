@@ -0,0 +1,242 @@
+/*
+ * Diagnostics overlay – an on-device view of the link and render state
+ * for staff, two lines across the top of whatever screen is up:
+ *
+ *   192.168.1.23  -61 dBm  broker 0  rtt 42 ms
+ *   fps 12/60  show 85 ms  heap 143/97 K  psram 6120 K
+ *
+ *   fps    LVGL refreshes / panel frames in the last second
+ *   show   MQTT show command decoded → first frame rendered
+ *   heap   internal RAM free now / lowest since boot
+ *
+ * The text is drawn once a second into a small opaque canvas on
+ * lv_layer_top(); between updates LVGL only blits that cached strip when
+ * something below it redraws, never re-shapes glyphs.  Its buffer is
+ * allocated the first time the strip is shown.  Costs while visible: one
+ * 480×36 text render per second (it counts as one of the refreshes in
+ * "fps").  Costs while hidden: a 1 Hz timer reading a flag.
+ *
+ * Toggled by {"on":true|false} on APP_MQTT_TOPIC_DIAG or by five taps
+ * within 3 s on the top-left corner.
+ *
+ * Any message on APP_MQTT_TOPIC_LVGL_GET has the same timer walk the
+ * object trees (lv_inventory.c) and publish the result on
+ * APP_MQTT_TOPIC_LVGL_DATA – LVGL is only touched from its own task.
+ */
+
+#include "diag_overlay.h"
+#include "lv_inventory.h"
+#include "mqtt_service.h"
+#include "outbox_service.h"
+#include "wifi_service.h"
+#include "lcd_st7701.h"
+#include "lcd_scanout.h"
+#include "app_config.h"
+
+#include <stdio.h>
+
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "esp_netif_ip_addr.h"
+#include "cJSON.h"
+
+static const char *TAG = "diag";
+
+#define STRIP_W             APP_LCD_H_RES
+#define STRIP_H             36
+#define CORNER              60      /* hot corner, px                    */
+#define CORNER_TAPS         5
+#define CORNER_WINDOW_MS    3000
+#define BROKER_MAX          3       /* primary, backup, LAN              */
+
+static lv_disp_t           *s_disp;
+static lv_obj_t            *s_strip;    /* canvas on the top layer       */
+static lv_color_t          *s_buf;
+static lv_draw_label_dsc_t  s_txt;
+static volatile int8_t      s_cmd = -1; /* from MQTT: -1 none, 0 off, 1 on */
+static bool                 s_visible;
+static volatile uint32_t    s_show_us;
+static volatile bool        s_inv_req;  /* inventory asked for over MQTT */
+
+static EXT_RAM_BSS_ATTR lv_inventory_t s_inv;
+static EXT_RAM_BSS_ATTR char           s_inv_json[APP_LVGL_INV_BYTES];
+
+/* Per-second deltas */
+static uint32_t s_refreshes, s_frames;
+
+/* Hot corner */
+static int      s_taps;
+static uint32_t s_tap0_ms;
+
+/* ── Strip ────────────────────────────────────────────────────────────── */
+
+static void draw(void)
+{
+    lcd_render_stats_t  r;
+    lcd_scanout_stats_t f;
+    mqtt_stats_t        m;
+    mqtt_broker_stats_t b[BROKER_MAX];
+    lcd_st7701_get_render_stats(&r);
+    lcd_scanout_get_stats(&f);
+    mqtt_service_get_stats(&m);
+    int nb = mqtt_service_get_broker_stats(b, BROKER_MAX);
+
+    uint32_t fps   = r.refreshes - s_refreshes;
+    uint32_t panel = f.frames - s_frames;
+    s_refreshes = r.refreshes;
+    s_frames    = f.frames;
+
+    char ip[16] = "no wifi";
+    esp_ip4_addr_t a = { .addr = wifi_service_get_ip() };
+    if (a.addr) snprintf(ip, sizeof(ip), IPSTR, IP2STR(&a));
+
+    char line[2][80];
+    snprintf(line[0], sizeof(line[0]), "%s  %d dBm  broker %lu  rtt %lu ms%s",
+             ip, wifi_service_get_rssi(), (unsigned long)m.active_broker,
+             (unsigned long)((int)m.active_broker < nb
+                             ? b[m.active_broker].rtt_ms : 0),
+             mqtt_service_is_connected() ? "" : "  (offline)");
+    snprintf(line[1], sizeof(line[1]),
+             "fps %lu/%lu  show %lu ms  heap %u/%u K  psram %u K",
+             (unsigned long)fps, (unsigned long)panel,
+             (unsigned long)(s_show_us / 1000),
+             (unsigned)(heap_caps_get_free_size(MALLOC_CAP_INTERNAL) / 1024),
+             (unsigned)(heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL)
+                        / 1024),
+             (unsigned)(heap_caps_get_free_size(MALLOC_CAP_SPIRAM) / 1024));
+
+    lv_canvas_fill_bg(s_strip, lv_color_black(), LV_OPA_COVER);
+    lv_canvas_draw_text(s_strip, 6, 2,  STRIP_W - 12, &s_txt, line[0]);
+    lv_canvas_draw_text(s_strip, 6, 19, STRIP_W - 12, &s_txt, line[1]);
+}
+
+static void set_visible(bool on)
+{
+    if (on == s_visible) return;
+    if (on && !s_buf) {
+        s_buf = heap_caps_malloc(LV_CANVAS_BUF_SIZE_TRUE_COLOR(STRIP_W,
+                                                               STRIP_H),
+                                 MALLOC_CAP_SPIRAM);
+        if (!s_buf) {
+            ESP_LOGE(TAG, "no memory for the strip");
+            return;
+        }
+        lv_canvas_set_buffer(s_strip, s_buf, STRIP_W, STRIP_H,
+                             LV_IMG_CF_TRUE_COLOR);
+    }
+    s_visible = on;
+    if (on) {
+        draw();
+        lv_obj_clear_flag(s_strip, LV_OBJ_FLAG_HIDDEN);
+    } else {
+        lv_obj_add_flag(s_strip, LV_OBJ_FLAG_HIDDEN);
+    }
+    ESP_LOGI(TAG, "Overlay %s", on ? "on" : "off");
+}
+
+static void publish_inventory(void)
+{
+    lv_inventory_collect(s_disp, &s_inv);
+    int n = lv_inventory_to_json(&s_inv, s_inv_json, sizeof(s_inv_json));
+    if (n >= (int)sizeof(s_inv_json)) {
+        ESP_LOGW(TAG, "inventory truncated (%d B)", n);
+        return;
+    }
+    outbox_post(APP_MQTT_TOPIC_LVGL_DATA, s_inv_json, n, 1, 0);
+
+    ESP_LOGI(TAG, "LVGL: %lu objects, %lu B; pool %u%% used, %u%% fragmented",
+             (unsigned long)s_inv.objs, (unsigned long)s_inv.bytes,
+             (unsigned)s_inv.mem.used_pct, (unsigned)s_inv.mem.frag_pct);
+    if (s_inv.mem.used_pct > APP_LVGL_POOL_WARN_PCT) {
+        ESP_LOGW(TAG, "LVGL pool over %d%% budget", APP_LVGL_POOL_WARN_PCT);
+    }
+}
+
+static void tick_cb(lv_timer_t *t)
+{
+    (void)t;
+    if (s_inv_req) {
+        s_inv_req = false;
+        publish_inventory();
+    }
+    int8_t cmd = s_cmd;
+    if (cmd >= 0) {
+        s_cmd = -1;
+        set_visible(cmd);
+    }
+    if (s_visible) draw();
+}
+
+static void on_corner_tap(lv_event_t *e)
+{
+    (void)e;
+    uint32_t now = lv_tick_get();
+    if (!s_taps || lv_tick_elaps(s_tap0_ms) > CORNER_WINDOW_MS) {
+        s_taps    = 0;
+        s_tap0_ms = now;
+    }
+    if (++s_taps == CORNER_TAPS) {
+        s_taps = 0;
+        set_visible(!s_visible);
+    }
+}
+
+/* ── MQTT command (MQTT task context) ─────────────────────────────────── */
+
+static void on_diag_cmd(const char *data, int len)
+{
+    cJSON *root = cJSON_ParseWithLength(data, len);
+    if (!root) {
+        ESP_LOGW(TAG, "diag: invalid JSON");
+        return;
+    }
+    const cJSON *on = cJSON_GetObjectItemCaseSensitive(root, "on");
+    if (cJSON_IsBool(on)) s_cmd = cJSON_IsTrue(on);
+    cJSON_Delete(root);
+}
+
+static void on_inventory_cmd(const char *data, int len)
+{
+    (void)data;
+    (void)len;
+    s_inv_req = true;
+}
+
+/* ── Public API ───────────────────────────────────────────────────────── */
+
+esp_err_t diag_overlay_init(lv_disp_t *disp)
+{
+    s_disp = disp;
+    lv_obj_t *top = lv_disp_get_layer_top(disp);
+
+    s_strip = lv_canvas_create(top);
+    lv_obj_set_pos(s_strip, 0, 0);
+    lv_obj_add_flag(s_strip, LV_OBJ_FLAG_HIDDEN);
+    lv_obj_clear_flag(s_strip, LV_OBJ_FLAG_CLICKABLE);
+
+    lv_draw_label_dsc_init(&s_txt);
+    s_txt.color = lv_color_make(0x7F, 0xFF, 0x7F);
+    s_txt.font  = &lv_font_montserrat_14;
+
+    /* Invisible hot corner; swallows taps there on every screen */
+    lv_obj_t *corner = lv_obj_create(top);
+    lv_obj_remove_style_all(corner);
+    lv_obj_set_size(corner, CORNER, CORNER);
+    lv_obj_set_pos(corner, 0, 0);
+    lv_obj_add_flag(corner, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_add_event_cb(corner, on_corner_tap, LV_EVENT_CLICKED, NULL);
+
+    lv_timer_create(tick_cb, 1000, NULL);
+
+    ESP_RETURN_ON_ERROR(mqtt_service_register_handler(APP_MQTT_TOPIC_LVGL_GET,
+                                                      on_inventory_cmd),
+                        TAG, "inventory topic");
+    return mqtt_service_register_handler(APP_MQTT_TOPIC_DIAG, on_diag_cmd);
+}
+
+void diag_overlay_set_show_latency(uint32_t us)
+{
+    s_show_us = us;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "lvgl.h"
+
+/**
+ * Create the (hidden) diagnostics strip on lv_layer_top() and register
+ * APP_MQTT_TOPIC_DIAG ({"on":bool}).  Five taps on the top-left corner
+ * toggle it too.  Also registers the LVGL inventory request
+ * (APP_MQTT_TOPIC_LVGL_GET, see lv_inventory.h).  Call after
+ * qr_screen_init() and before mqtt_service_init().
+ */
+esp_err_t diag_overlay_init(lv_disp_t *disp);
+
+/**
+ * Latest MQTT-to-first-frame time of a QR show, from the LVGL task.
+ */
+void diag_overlay_set_show_latency(uint32_t us);
@@ -0,0 +1,202 @@
+/*
+ * LVGL inventory – what the UI holds in the LVGL pool
+ * (CONFIG_LV_MEM_SIZE_KILOBYTES), by widget class and by screen.
+ *
+ * Per object it counts the class instance, the special attributes
+ * (children array, event callbacks), the style list and every local
+ * style with its property array, and the text of dynamic labels.  Pool
+ * use and fragmentation come from lv_mem_monitor().
+ *
+ * Uses nothing but LVGL and the C library, so an LVGL host build can
+ * link it and check a UI change against the pool budget before it
+ * reaches a device; the firmware publishes it from diag_overlay.c.
+ *
+ *   {"objs":n,"local_styles":n,"bytes":n,
+ *    "pool":{"total":n,"free":n,"biggest":n,"used_pct":n,"frag_pct":n,
+ *            "max_used":n},
+ *    "classes":[{"class":"label","objs":n,"bytes":n,"avg":n},...],
+ *    "screens":[{"name":"scr0","active":true,"objs":n,
+ *                "local_styles":n,"bytes":n},...]}
+ */
+
+#include "lv_inventory.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* lv_event_dsc_t: callback, user data, filter */
+#define EVENT_DSC_BYTES     (3 * sizeof(void *))
+
+static const struct {
+    const lv_obj_class_t *cls;
+    const char           *name;
+} CLASS_NAME[] = {
+    { &lv_obj_class,    "obj"    },
+#if LV_USE_LABEL
+    { &lv_label_class,  "label"  },
+#endif
+#if LV_USE_IMG
+    { &lv_img_class,    "img"    },
+#endif
+#if LV_USE_CANVAS
+    { &lv_canvas_class, "canvas" },
+#endif
+#if LV_USE_QRCODE
+    { &lv_qrcode_class, "qrcode" },
+#endif
+};
+
+static const char *class_name(const lv_obj_class_t *cls)
+{
+    for (size_t i = 0; i < sizeof(CLASS_NAME) / sizeof(CLASS_NAME[0]); i++) {
+        if (CLASS_NAME[i].cls == cls) return CLASS_NAME[i].name;
+    }
+    return NULL;
+}
+
+/* Pool bytes held by one object, not counting its children. */
+static uint32_t obj_bytes(const lv_obj_t *obj, uint32_t *local_styles)
+{
+    uint32_t n = obj->class_p->instance_size;
+
+    if (obj->spec_attr) {
+        n += sizeof(*obj->spec_attr);
+        n += obj->spec_attr->child_cnt * sizeof(lv_obj_t *);
+        n += obj->spec_attr->event_dsc_cnt * EVENT_DSC_BYTES;
+    }
+
+    n += obj->style_cnt * sizeof(obj->styles[0]);
+    for (uint32_t i = 0; i < obj->style_cnt; i++) {
+        const lv_style_t *st = obj->styles[i].style;
+        if (!obj->styles[i].is_local) continue;
+        (*local_styles)++;
+        n += sizeof(lv_style_t);
+        if (st->prop_cnt > 1) {         /* values, then 16-bit prop ids */
+            n += st->prop_cnt * (sizeof(lv_style_value_t) +
+                                 sizeof(uint16_t));
+        }
+    }
+
+#if LV_USE_LABEL
+    if (obj->class_p == &lv_label_class) {
+        const lv_label_t *l = (const lv_label_t *)obj;
+        if (l->text && !l->static_txt) n += strlen(l->text) + 1;
+    }
+#endif
+    return n;
+}
+
+static void add_class(lv_inventory_t *inv, const lv_obj_class_t *cls,
+                      uint32_t bytes)
+{
+    int i;
+    for (i = 0; i < inv->cls_cnt; i++) {
+        if (inv->cls[i].cls == cls) break;
+    }
+    if (i == inv->cls_cnt) {
+        if (i == LV_INV_CLASS_MAX) i--;     /* last slot takes the rest */
+        else inv->cls[inv->cls_cnt++].cls = cls;
+    }
+    inv->cls[i].objs++;
+    inv->cls[i].bytes += bytes;
+}
+
+static void walk(lv_inventory_t *inv, lv_inv_screen_t *scr,
+                 const lv_obj_t *obj)
+{
+    uint32_t local = 0;
+    uint32_t bytes = obj_bytes(obj, &local);
+
+    scr->objs++;
+    scr->local_styles += local;
+    scr->bytes        += bytes;
+    add_class(inv, obj->class_p, bytes);
+
+    uint32_t cnt = lv_obj_get_child_cnt(obj);
+    for (uint32_t i = 0; i < cnt; i++) {
+        walk(inv, scr, lv_obj_get_child(obj, i));
+    }
+}
+
+static void add_tree(lv_inventory_t *inv, const char *name,
+                     const lv_obj_t *root, bool active)
+{
+    if (!root || inv->scr_cnt == LV_INV_SCREEN_MAX) return;
+    lv_inv_screen_t *scr = &inv->scr[inv->scr_cnt++];
+    scr->name   = name;
+    scr->active = active;
+    walk(inv, scr, root);
+
+    inv->objs         += scr->objs;
+    inv->local_styles += scr->local_styles;
+    inv->bytes        += scr->bytes;
+}
+
+/* ── Public API ───────────────────────────────────────────────────────── */
+
+void lv_inventory_collect(lv_disp_t *disp, lv_inventory_t *out)
+{
+    static const char *const SCR_NAME[] = {
+        "scr0", "scr1", "scr2", "scr3", "scr4", "scr5",
+    };
+
+    memset(out, 0, sizeof(*out));
+    lv_obj_t *act = lv_disp_get_scr_act(disp);
+    uint32_t  n   = disp->screen_cnt;
+    if (n > sizeof(SCR_NAME) / sizeof(SCR_NAME[0])) {
+        n = sizeof(SCR_NAME) / sizeof(SCR_NAME[0]);
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        add_tree(out, SCR_NAME[i], disp->screens[i], disp->screens[i] == act);
+    }
+    add_tree(out, "top", lv_disp_get_layer_top(disp), true);
+    add_tree(out, "sys", lv_disp_get_layer_sys(disp), true);
+
+    lv_mem_monitor(&out->mem);
+}
+
+int lv_inventory_to_json(const lv_inventory_t *inv, char *buf, size_t size)
+{
+    size_t n = 0;
+#define PUT(...) \
+    n += snprintf(buf + (n < size ? n : size), n < size ? size - n : 0, \
+                  __VA_ARGS__)
+
+    PUT("{\"objs\":%lu,\"local_styles\":%lu,\"bytes\":%lu,"
+        "\"pool\":{\"total\":%lu,\"free\":%lu,\"biggest\":%lu,"
+        "\"used_pct\":%u,\"frag_pct\":%u,\"max_used\":%lu},\"classes\":[",
+        (unsigned long)inv->objs, (unsigned long)inv->local_styles,
+        (unsigned long)inv->bytes, (unsigned long)inv->mem.total_size,
+        (unsigned long)inv->mem.free_size,
+        (unsigned long)inv->mem.free_biggest_size,
+        (unsigned)inv->mem.used_pct, (unsigned)inv->mem.frag_pct,
+        (unsigned long)inv->mem.max_used);
+
+    for (int i = 0; i < inv->cls_cnt; i++) {
+        const lv_inv_class_t *c = &inv->cls[i];
+        const char *name = class_name(c->cls);
+        if (name) {
+            PUT("%s{\"class\":\"%s\"", i ? "," : "", name);
+        } else {
+            /* not in the table: identify it by its instance size */
+            PUT("%s{\"class\":\"size%u\"", i ? "," : "",
+                (unsigned)c->cls->instance_size);
+        }
+        PUT(",\"objs\":%lu,\"bytes\":%lu,\"avg\":%lu}",
+            (unsigned long)c->objs, (unsigned long)c->bytes,
+            (unsigned long)(c->bytes / c->objs));
+    }
+    PUT("],\"screens\":[");
+
+    for (int i = 0; i < inv->scr_cnt; i++) {
+        const lv_inv_screen_t *s = &inv->scr[i];
+        PUT("%s{\"name\":\"%s\",\"active\":%s,\"objs\":%lu,"
+            "\"local_styles\":%lu,\"bytes\":%lu}",
+            i ? "," : "", s->name, s->active ? "true" : "false",
+            (unsigned long)s->objs, (unsigned long)s->local_styles,
+            (unsigned long)s->bytes);
+    }
+    PUT("]}");
+#undef PUT
+    return (int)n;
+}
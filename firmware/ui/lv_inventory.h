@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "lvgl.h"
+
+#define LV_INV_CLASS_MAX    12
+#define LV_INV_SCREEN_MAX   8
+
+/** Objects of one widget class. */
+typedef struct {
+    const lv_obj_class_t *cls;
+    uint32_t objs;
+    uint32_t bytes;             /* instance + attributes + local styles   */
+} lv_inv_class_t;
+
+/** One object tree: a screen or a display layer. */
+typedef struct {
+    const char *name;           /* "scr<n>", "top", "sys"                  */
+    bool     active;
+    uint32_t objs;
+    uint32_t local_styles;
+    uint32_t bytes;
+} lv_inv_screen_t;
+
+typedef struct {
+    lv_inv_class_t   cls[LV_INV_CLASS_MAX];
+    int              cls_cnt;
+    lv_inv_screen_t  scr[LV_INV_SCREEN_MAX];
+    int              scr_cnt;
+    uint32_t         objs;
+    uint32_t         local_styles;
+    uint32_t         bytes;
+    lv_mem_monitor_t mem;       /* LVGL pool: use, fragmentation          */
+} lv_inventory_t;
+
+/**
+ * Walk every screen and layer of @p disp and fill @p out.  Byte counts
+ * are what the objects hold in the LVGL pool (allocator headers aside);
+ * canvas and image buffers live outside it.  Call from the LVGL task.
+ */
+void lv_inventory_collect(lv_disp_t *disp, lv_inventory_t *out);
+
+/**
+ * Format @p inv as one JSON object into @p buf.  Returns the length, or
+ * the length needed if @p size was too small (snprintf semantics).
+ */
+int lv_inventory_to_json(const lv_inventory_t *inv, char *buf, size_t size);
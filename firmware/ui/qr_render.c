@@ -0,0 +1,345 @@
+/*
+ * QR renderer – qrcodegen straight into a 1-bpp canvas, repainting only
+ * the modules that changed since the last update.
+ *
+ * A new dynamic VietQR usually differs from the previous one only in the
+ * amount and reference fields, so with the same version most modules
+ * stay put.  The previous module matrix is kept, the new one is diffed
+ * against it row by row, and only changed modules are painted and their
+ * rows invalidated.  A version change (or the first draw) redraws all.
+ *
+ * With APP_QR_PIN_MASK the mask pattern of the symbol on screen is reused
+ * while the version stays the same – otherwise qrcodegen's automatic mask
+ * choice flips large parts of the matrix for a one-digit change.  Every
+ * mask is valid; the automatic choice is still made on version changes.
+ *
+ * Any payload up to version 40 is accepted: ECC M first, ECC L when M
+ * cannot hold it (2953 bytes at 40-L).  The canvas is sized to the symbol
+ * at the largest integer scale that fits the layout box, or – when that
+ * would drop below the minimum scale – the full max_px square.
+ */
+
+#include "qr_render.h"
+#include "app_config.h"
+
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "extra/libs/qrcode/qrcodegen.h"
+
+static const char *TAG = "qr_render";
+
+/* Above this many separate row bands, invalidate their bounding box. */
+#define MAX_INV_AREAS   8
+
+/* Quiet zone kept when the symbol grows to the full square. */
+#define QUIET_MODULES   4
+
+typedef struct {
+    uint8_t *cur;       /* qrcodegen buffers, BUFFER_LEN_MAX each          */
+    uint8_t *prev;      /* matrix currently on the canvas                  */
+    uint8_t *tmp;
+    uint8_t *buf;       /* canvas: 2 palette entries + 1-bpp rows          */
+    int      max_px;    /* side the buffer was allocated for               */
+    int      box_px;    /* preferred side (layout box)                     */
+    int      min_scale; /* below this in the box, grow to max_px           */
+    int      px;        /* current canvas side = size × scale              */
+    int      size;      /* modules per side on the canvas, 0 = blank       */
+    int      scale;
+} qr_state_t;
+
+static inline uint8_t *row_ptr(const qr_state_t *st, int y)
+{
+    return st->buf + 2 * sizeof(lv_color32_t) + y * ((st->px + 7) / 8);
+}
+
+static void set_run(uint8_t *row, int x0, int n, bool light)
+{
+    for (int x = x0; x < x0 + n; x++) {
+        if (light) row[x >> 3] |=  (0x80 >> (x & 7));
+        else       row[x >> 3] &= ~(0x80 >> (x & 7));
+    }
+}
+
+/* Paint modules [mx0, mx1) of module row @p my from the current matrix. */
+static void paint_modules(qr_state_t *st, int mx0, int mx1, int my)
+{
+    int y0 = my * st->scale;
+
+    for (int mx = mx0; mx < mx1; mx++) {
+        bool light = !qrcodegen_getModule(st->cur, mx, my);
+        int  x0    = mx * st->scale;
+        for (int r = 0; r < st->scale; r++) {
+            set_run(row_ptr(st, y0 + r), x0, st->scale, light);
+        }
+    }
+}
+
+/* Mask number from the format bits next to the top-left finder. */
+static int read_mask(const uint8_t *qr)
+{
+    int raw = qrcodegen_getModule(qr, 4, 8)
+            | qrcodegen_getModule(qr, 3, 8) << 1
+            | qrcodegen_getModule(qr, 2, 8) << 2;
+    return raw ^ 5;
+}
+
+static bool encode_ecl(qr_state_t *st, const void *data, size_t len,
+                       enum qrcodegen_Ecc ecl, enum qrcodegen_Mask mask)
+{
+    memcpy(st->tmp, data, len);
+    return qrcodegen_encodeBinary(st->tmp, len, st->cur, ecl,
+                                  qrcodegen_VERSION_MIN, qrcodegen_VERSION_MAX,
+                                  mask, true);
+}
+
+static bool encode(qr_state_t *st, const void *data, size_t len,
+                   enum qrcodegen_Mask mask, bool *ecc_low)
+{
+    *ecc_low = false;
+    if (encode_ecl(st, data, len, qrcodegen_Ecc_MEDIUM, mask)) return true;
+    *ecc_low = true;
+    return encode_ecl(st, data, len, qrcodegen_Ecc_LOW, mask);
+}
+
+static void invalidate_px(lv_obj_t *obj, const qr_state_t *st,
+                          int mx0, int my0, int mx1, int my1)
+{
+    lv_area_t a;
+    lv_obj_get_coords(obj, &a);
+
+    lv_area_t r = {
+        .x1 = a.x1 + mx0 * st->scale,
+        .y1 = a.y1 + my0 * st->scale,
+        .x2 = a.x1 + mx1 * st->scale - 1,
+        .y2 = a.y1 + my1 * st->scale - 1,
+    };
+    lv_obj_invalidate_area(obj, &r);
+}
+
+static void full_redraw(lv_obj_t *obj, qr_state_t *st, qr_render_stats_t *s)
+{
+    int size  = qrcodegen_getSize(st->cur);
+    int scale = st->box_px / size;
+    if (scale < st->min_scale) {
+        /* Whole square – keep the 4-module quiet zone inside it. */
+        scale = st->max_px / (size + 2 * QUIET_MODULES);
+        if (scale < 1) scale = st->max_px / size;
+    }
+
+    /* Resize the canvas to the symbol; the caller re-aligns it. */
+    lv_obj_invalidate(obj);
+    st->size  = size;
+    st->scale = scale;
+    st->px    = size * scale;
+    lv_canvas_set_buffer(obj, st->buf, st->px, st->px, LV_IMG_CF_INDEXED_1BIT);
+
+    /* Light background, then the dark modules row by row. */
+    memset(row_ptr(st, 0), 0xFF, st->px * ((st->px + 7) / 8));
+    for (int my = 0; my < size; my++) {
+        for (int mx = 0; mx < size; mx++) {
+            if (qrcodegen_getModule(st->cur, mx, my)) {
+                int x0 = mx * st->scale;
+                int y0 = my * st->scale;
+                for (int r = 0; r < st->scale; r++) {
+                    set_run(row_ptr(st, y0 + r), x0, st->scale, false);
+                }
+            }
+        }
+    }
+
+    lv_obj_invalidate(obj);
+    s->full    = true;
+    s->changed = size * size;
+    s->areas   = 1;
+}
+
+static void diff_redraw(lv_obj_t *obj, qr_state_t *st, qr_render_stats_t *s)
+{
+    /* One invalidation band per run of rows with changes. */
+    int bands = 0, band_y0 = -1, band_x0 = 0, band_x1 = 0;
+    int all_x0 = st->size, all_x1 = 0, all_y0 = -1, all_y1 = 0;
+
+    struct { int x0, y0, x1, y1; } inv[MAX_INV_AREAS];
+
+    for (int my = 0; my <= st->size; my++) {
+        int row_x0 = st->size, row_x1 = 0;
+
+        for (int mx = 0; my < st->size && mx < st->size; ) {
+            if (qrcodegen_getModule(st->cur, mx, my)
+                == qrcodegen_getModule(st->prev, mx, my)) {
+                mx++;
+                continue;
+            }
+            int run = mx;
+            while (mx < st->size && qrcodegen_getModule(st->cur, mx, my)
+                                 != qrcodegen_getModule(st->prev, mx, my)) {
+                mx++;
+            }
+            paint_modules(st, run, mx, my);
+            s->changed += mx - run;
+            if (run < row_x0) row_x0 = run;
+            if (mx  > row_x1) row_x1 = mx;
+        }
+
+        if (row_x1 > row_x0) {                       /* row has changes */
+            if (band_y0 < 0) {
+                band_y0 = my;
+                band_x0 = row_x0;
+                band_x1 = row_x1;
+            } else {
+                if (row_x0 < band_x0) band_x0 = row_x0;
+                if (row_x1 > band_x1) band_x1 = row_x1;
+            }
+            if (all_y0 < 0)       all_y0 = my;
+            all_y1 = my + 1;
+            if (row_x0 < all_x0)  all_x0 = row_x0;
+            if (row_x1 > all_x1)  all_x1 = row_x1;
+        } else if (band_y0 >= 0) {                   /* band ends */
+            if (bands < MAX_INV_AREAS) {
+                inv[bands].x0 = band_x0;
+                inv[bands].y0 = band_y0;
+                inv[bands].x1 = band_x1;
+                inv[bands].y1 = my;
+            }
+            bands++;
+            band_y0 = -1;
+        }
+    }
+
+    if (bands > MAX_INV_AREAS) {
+        invalidate_px(obj, st, all_x0, all_y0, all_x1, all_y1);
+        s->areas = 1;
+    } else {
+        for (int i = 0; i < bands; i++) {
+            invalidate_px(obj, st, inv[i].x0, inv[i].y0, inv[i].x1, inv[i].y1);
+        }
+        s->areas = bands;
+    }
+}
+
+static void on_delete(lv_event_t *e)
+{
+    qr_state_t *st = lv_event_get_user_data(e);
+
+    heap_caps_free(st->cur);
+    heap_caps_free(st->prev);
+    heap_caps_free(st->tmp);
+    heap_caps_free(st->buf);
+    heap_caps_free(st);
+}
+
+/* ── Public API ──────────────────────────────────────────────────────── */
+
+lv_obj_t *qr_render_create(lv_obj_t *parent, lv_coord_t max_px,
+                           lv_color_t dark, lv_color_t light)
+{
+    qr_state_t *st = heap_caps_calloc(1, sizeof(*st), MALLOC_CAP_DEFAULT);
+    if (!st) return NULL;
+
+    st->max_px    = max_px;
+    st->box_px    = max_px;
+    st->min_scale = 1;
+    st->px        = max_px;
+    st->cur  = heap_caps_malloc(qrcodegen_BUFFER_LEN_MAX, MALLOC_CAP_SPIRAM);
+    st->prev = heap_caps_malloc(qrcodegen_BUFFER_LEN_MAX, MALLOC_CAP_SPIRAM);
+    st->tmp  = heap_caps_malloc(qrcodegen_BUFFER_LEN_MAX, MALLOC_CAP_SPIRAM);
+    st->buf  = heap_caps_malloc(LV_CANVAS_BUF_SIZE_INDEXED_1BIT(max_px, max_px),
+                                MALLOC_CAP_SPIRAM);
+    if (!st->cur || !st->prev || !st->tmp || !st->buf) {
+        ESP_LOGE(TAG, "alloc failed");
+        heap_caps_free(st->cur);
+        heap_caps_free(st->prev);
+        heap_caps_free(st->tmp);
+        heap_caps_free(st->buf);
+        heap_caps_free(st);
+        return NULL;
+    }
+
+    lv_obj_t *canvas = lv_canvas_create(parent);
+    lv_canvas_set_buffer(canvas, st->buf, max_px, max_px,
+                         LV_IMG_CF_INDEXED_1BIT);
+    lv_canvas_set_palette(canvas, 0, dark);
+    lv_canvas_set_palette(canvas, 1, light);
+    memset(row_ptr(st, 0), 0xFF, max_px * ((max_px + 7) / 8));
+
+    lv_obj_add_event_cb(canvas, on_delete, LV_EVENT_DELETE, st);
+    lv_obj_set_user_data(canvas, st);
+    return canvas;
+}
+
+void qr_render_set_fit(lv_obj_t *obj, lv_coord_t box_px, int min_scale)
+{
+    qr_state_t *st = lv_obj_get_user_data(obj);
+    if (!st) return;
+
+    st->box_px    = LV_MIN(box_px, st->max_px);
+    st->min_scale = min_scale > 0 ? min_scale : 1;
+    st->size      = 0;                      /* re-fit on the next update */
+}
+
+void qr_render_clear(lv_obj_t *obj)
+{
+    qr_state_t *st = lv_obj_get_user_data(obj);
+    if (!st) return;
+
+    memset(row_ptr(st, 0), 0xFF, st->px * ((st->px + 7) / 8));
+    st->size = 0;
+    lv_obj_invalidate(obj);
+}
+
+lv_res_t qr_render_update(lv_obj_t *obj, const void *data, size_t len,
+                          qr_render_stats_t *stats)
+{
+    qr_state_t       *st = obj ? lv_obj_get_user_data(obj) : NULL;
+    qr_render_stats_t s  = {0};
+
+    if (stats) *stats = s;
+    if (!st || len > qrcodegen_BUFFER_LEN_MAX) return LV_RES_INV;
+
+    /* Encode – same mask as the symbol on screen while the version
+       holds, automatic choice otherwise. */
+    int64_t t0 = esp_timer_get_time();
+    bool    ok;
+
+    if (APP_QR_PIN_MASK && st->size) {
+        ok = encode(st, data, len, (enum qrcodegen_Mask)read_mask(st->prev),
+                    &s.ecc_low);
+        if (ok && qrcodegen_getSize(st->cur) != st->size) {
+            ok = encode(st, data, len, qrcodegen_Mask_AUTO, &s.ecc_low);
+        }
+    } else {
+        ok = encode(st, data, len, qrcodegen_Mask_AUTO, &s.ecc_low);
+    }
+    s.encode_us = esp_timer_get_time() - t0;
+    if (!ok) {
+        if (stats) *stats = s;
+        return LV_RES_INV;
+    }
+
+    int size  = qrcodegen_getSize(st->cur);
+    s.version = (size - 17) / 4;
+    s.modules = size * size;
+    if (stats) *stats = s;
+    if (size > st->max_px) return LV_RES_INV;       /* < 1 px per module */
+
+    t0 = esp_timer_get_time();
+    if (size != st->size) {
+        full_redraw(obj, st, &s);
+    } else {
+        diff_redraw(obj, st, &s);
+    }
+    s.draw_us = esp_timer_get_time() - t0;
+    s.scale   = st->scale;
+    s.side    = st->px;
+
+    /* The new matrix is now what the canvas shows. */
+    uint8_t *t = st->prev;
+    st->prev   = st->cur;
+    st->cur    = t;
+
+    if (stats) *stats = s;
+    return LV_RES_OK;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lvgl.h"
+
+/** What the last qr_render_update() did. */
+typedef struct {
+    int      version;       /* QR version 1..40 (0 = encode failed)       */
+    int      modules;       /* modules on screen (size²)                  */
+    int      changed;       /* modules repainted                          */
+    int      areas;         /* areas invalidated                          */
+    bool     full;          /* full redraw (first draw / version change)  */
+    bool     ecc_low;       /* did not fit at ECC M, encoded at ECC L     */
+    int      scale;         /* pixels per module                          */
+    int      side;          /* canvas side in pixels (size × scale)       */
+    uint32_t encode_us;
+    uint32_t draw_us;
+} qr_render_stats_t;
+
+/**
+ * Create a QR canvas of up to @p max_px square (1-bpp indexed: palette
+ * 0 = @p dark, 1 = @p light, same layout as lv_qrcode).  Initially blank
+ * (light) and @p max_px wide; the buffer lives in PSRAM.
+ */
+lv_obj_t *qr_render_create(lv_obj_t *parent, lv_coord_t max_px,
+                           lv_color_t dark, lv_color_t light);
+
+/**
+ * Prefer fitting the symbol into @p box_px; if that leaves fewer than
+ * @p min_scale pixels per module, use the whole max_px square instead.
+ * Default: box = max_px, min_scale = 1.  Forces a full redraw next time.
+ */
+void qr_render_set_fit(lv_obj_t *obj, lv_coord_t box_px, int min_scale);
+
+/**
+ * Encode @p data (byte mode, ECC M, or ECC L when M cannot hold it) and
+ * update the canvas.  The canvas is resized to size × scale at the
+ * largest integer scale that fits – re-align it when stats->side changes.
+ *
+ * When the new symbol has the same version as the one on screen, only
+ * the modules that differ are repainted and only their rows invalidated;
+ * otherwise the canvas is redrawn.  Returns LV_RES_INV (canvas untouched)
+ * when the payload exceeds version 40.  @p stats may be NULL.
+ */
+lv_res_t qr_render_update(lv_obj_t *obj, const void *data, size_t len,
+                          qr_render_stats_t *stats);
+
+/**
+ * Blank the canvas (all light) and forget the symbol on it.
+ */
+void qr_render_clear(lv_obj_t *obj);
@@ -13,16 +13,28 @@
  *   │       [amount text]         │
  *   └─────────────────────────────┘
  *
+ * Large payloads (up to QR version 40) that would drop below QR_MIN_SCALE
+ * px/module in the 280 px box take the whole screen instead, labels
+ * hidden.  A payload that cannot be encoded blanks the QR and shows an
+ * explicit error – never a stale or truncated code.
+ *
  * All LVGL objects are created once in qr_screen_init() and reused.
  */
 
 #include "qr_screen.h"
+#include "qr_render.h"
+#include "journal_service.h"
+#include "app_config.h"
+#include <stdio.h>
 #include <string.h>
 #include "esp_log.h"
+#include "esp_attr.h"
 
 static const char *TAG = "qr_scr";
 
-#define QR_SIZE     280
+#define QR_SIZE         280             /* box between the labels     */
+#define QR_MAX_SIZE     APP_LCD_H_RES   /* full-screen fallback       */
+#define QR_MIN_SCALE    3               /* px/module to stay boxed    */
 
 /* ── Static widget handles (created once, reused) ────────────────────── */
 
@@ -31,10 +43,14 @@ static lv_obj_t *s_scr_qr;         /* QR display screen                 */
 static lv_obj_t *s_qr;             /* QR code widget                    */
 static lv_obj_t *s_lbl_amount;     /* amount label (below QR)           */
 static lv_obj_t *s_lbl_desc;       /* description label (above QR)      */
+static lv_obj_t *s_lbl_err;        /* encode error (replaces the QR)    */
 
 /* Snapshot of the last payload passed to show().
-   Used to skip redundant lv_qrcode_update() calls. */
-static qr_payload_t s_last;
+   Used to skip redundant qr_render_update() calls.  ~3 KB → PSRAM. */
+static EXT_RAM_BSS_ATTR qr_payload_t s_last;
+
+/* True while the last payload could not be encoded. */
+static bool s_qr_error;
 
 /* User-dismiss flag: true = user tapped to hide QR, suppress auto-show. */
 static bool s_qr_dismissed_by_user;
@@ -42,6 +58,9 @@ static bool s_qr_dismissed_by_user;
 /* True while a non-MQTT (static) QR is being displayed. */
 static bool s_showing_static;
 
+/* Bumped whenever the QR bitmap is redrawn (tile consumers re-copy). */
+static uint32_t s_tile_gen;
+
 static void on_qr_screen_tap(lv_event_t *e)
 {
     (void)e;
@@ -54,6 +73,7 @@ static void on_qr_screen_tap(lv_event_t *e)
         /* MQTT QR: set dismiss flag so the main loop won't re-show. */
         s_qr_dismissed_by_user = true;
         qr_screen_hide();
+        journal_log(JOURNAL_EV_DISMISS, 0, &s_last);
         ESP_LOGI(TAG, "QR dismissed by user");
     }
 }
@@ -73,9 +93,10 @@ void qr_screen_init(lv_disp_t *disp)
     lv_obj_set_style_bg_opa(s_scr_qr, LV_OPA_COVER, 0);
     lv_obj_add_event_cb(s_scr_qr, on_qr_screen_tap, LV_EVENT_CLICKED, NULL);
 
-    /* QR code widget – centred, no border */
-    s_qr = lv_qrcode_create(s_scr_qr, QR_SIZE,
-                             lv_color_black(), lv_color_white());
+    /* QR code canvas – centred, no border */
+    s_qr = qr_render_create(s_scr_qr, QR_MAX_SIZE,
+                            lv_color_black(), lv_color_white());
+    qr_render_set_fit(s_qr, QR_SIZE, QR_MIN_SCALE);
     lv_obj_center(s_qr);
     lv_obj_set_style_border_width(s_qr, 0, 0);
 
@@ -96,6 +117,14 @@ void qr_screen_init(lv_disp_t *disp)
     lv_label_set_text_static(s_lbl_desc, "");
     lv_obj_align_to(s_lbl_desc, s_qr, LV_ALIGN_OUT_TOP_MID, 0, -12);
 
+    /* Error label – centred, only while a payload cannot be encoded */
+    s_lbl_err = lv_label_create(s_scr_qr);
+    lv_obj_set_style_text_color(s_lbl_err, lv_color_make(0xC0, 0x00, 0x00), 0);
+    lv_obj_set_style_text_align(s_lbl_err, LV_TEXT_ALIGN_CENTER, 0);
+    lv_obj_set_width(s_lbl_err, 440);
+    lv_obj_center(s_lbl_err);
+    lv_obj_add_flag(s_lbl_err, LV_OBJ_FLAG_HIDDEN);
+
     ESP_LOGI(TAG, "QR screen ready");
 }
 
@@ -113,14 +142,48 @@ void qr_screen_show(const qr_payload_t *payload)
     }
     s_last = *payload;
 
-    /* Update QR code content */
-    lv_qrcode_update(s_qr, payload->data, strlen(payload->data));
+    /* Update QR code content – repaints only the changed modules */
+    size_t            len = strlen(payload->data);
+    qr_render_stats_t rs;
+    bool              boxed = true;
+
+    if (qr_render_update(s_qr, payload->data, len, &rs) != LV_RES_OK) {
+        /* Never leave the previous code on screen for a new payload. */
+        qr_render_clear(s_qr);
+        s_qr_error = true;
+        lv_label_set_text_fmt(s_lbl_err,
+                              "QR payload too large\n(%u bytes)",
+                              (unsigned)len);
+        lv_obj_clear_flag(s_lbl_err, LV_OBJ_FLAG_HIDDEN);
+        ESP_LOGE(TAG, "QR encode failed (%u bytes)", (unsigned)len);
+    } else {
+        s_qr_error = false;
+        boxed      = rs.side <= QR_SIZE;
+        lv_obj_add_flag(s_lbl_err, LV_OBJ_FLAG_HIDDEN);
+        ESP_LOGI(TAG, "QR v%d%s %d px/module: %d/%d modules repainted "
+                 "(%.1f%%)%s, encode %lu us, draw %lu us",
+                 rs.version, rs.ecc_low ? "-L" : "-M", rs.scale,
+                 rs.changed, rs.modules, 100.0f * rs.changed / rs.modules,
+                 rs.full ? " [full]" : "",
+                 (unsigned long)rs.encode_us, (unsigned long)rs.draw_us);
+    }
+    s_tile_gen++;
 
     /* Update text labels (empty string hides the label visually) */
     lv_label_set_text(s_lbl_amount, payload->amount);
     lv_label_set_text(s_lbl_desc,   payload->desc);
 
-    /* Re-align after text change */
+    /* Full-screen symbols leave no room for the labels. */
+    if (boxed && !s_qr_error) {
+        lv_obj_clear_flag(s_lbl_amount, LV_OBJ_FLAG_HIDDEN);
+        lv_obj_clear_flag(s_lbl_desc,   LV_OBJ_FLAG_HIDDEN);
+    } else {
+        lv_obj_add_flag(s_lbl_amount, LV_OBJ_FLAG_HIDDEN);
+        lv_obj_add_flag(s_lbl_desc,   LV_OBJ_FLAG_HIDDEN);
+    }
+
+    /* Re-align after text / size change */
+    lv_obj_center(s_qr);
     lv_obj_align_to(s_lbl_amount, s_qr, LV_ALIGN_OUT_BOTTOM_MID, 0, 16);
     lv_obj_align_to(s_lbl_desc,   s_qr, LV_ALIGN_OUT_TOP_MID,    0, -12);
 
@@ -133,7 +196,15 @@ void qr_screen_show(const qr_payload_t *payload)
 void qr_screen_show_static(const char *qr_data, const char *amount,
                             const char *desc)
 {
-    qr_payload_t payload = {0};
+    /* ~3 KB – too big for the LVGL task stack. */
+    static EXT_RAM_BSS_ATTR qr_payload_t payload;
+
+    if (strlen(qr_data) >= sizeof(payload.data)) {
+        ESP_LOGE(TAG, "Static QR too long (%u bytes) – not shown",
+                 (unsigned)strlen(qr_data));
+        return;
+    }
+    memset(&payload, 0, sizeof(payload));
     strncpy(payload.data,   qr_data, sizeof(payload.data)   - 1);
     strncpy(payload.amount, amount,  sizeof(payload.amount)  - 1);
     strncpy(payload.desc,   desc,    sizeof(payload.desc)    - 1);
@@ -151,6 +222,11 @@ void qr_screen_hide(void)
     ESP_LOGI(TAG, "QR hidden");
 }
 
+bool qr_screen_is_visible(void)
+{
+    return s_scr_qr && lv_scr_act() == s_scr_qr;
+}
+
 bool qr_screen_is_dismissed(void)
 {
     return s_qr_dismissed_by_user;
@@ -160,3 +236,27 @@ void qr_screen_clear_dismissed(void)
 {
     s_qr_dismissed_by_user = false;
 }
+
+bool qr_screen_get_tile(qr_tile_t *out)
+{
+    if (!qr_screen_is_visible() || s_qr_error) return false;
+
+    /* qr_render draws into an INDEXED_1BIT canvas: two palette entries
+       (0 = dark, 1 = light) followed by MSB-first rows. */
+    const lv_img_dsc_t *img = lv_canvas_get_img(s_qr);
+    lv_obj_update_layout(s_qr);
+
+    out->bits   = img->data + 2 * sizeof(lv_color32_t);
+    out->stride = (img->header.w + 7) / 8;
+    out->dark   = lv_color_black();
+    out->light  = lv_color_white();
+    out->gen    = s_tile_gen;
+    lv_obj_get_coords(s_qr, &out->area);
+    return true;
+}
+
+void qr_screen_set_composed(bool composed)
+{
+    if (composed) lv_obj_add_flag(s_qr, LV_OBJ_FLAG_HIDDEN);
+    else          lv_obj_clear_flag(s_qr, LV_OBJ_FLAG_HIDDEN);
+}
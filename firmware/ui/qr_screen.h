@@ -3,6 +3,15 @@
 #include "lvgl.h"
 #include "mqtt_service.h"
 
+/** The QR module bitmap as drawn by LVGL, for scan-out composition. */
+typedef struct {
+    const uint8_t *bits;        /* 1 bpp, MSB first, 0 = dark, 1 = light */
+    int            stride;      /* bytes per row                          */
+    lv_area_t      area;        /* screen coordinates                     */
+    lv_color_t     dark, light;
+    uint32_t       gen;         /* changes whenever the bitmap is redrawn */
+} qr_tile_t;
+
 /**
  * Create QR and idle screens.  Call once after LVGL display is registered.
  */
@@ -26,6 +35,11 @@ void qr_screen_show_static(const char *qr_data, const char *amount,
  */
 void qr_screen_hide(void);
 
+/**
+ * Returns true while the QR screen is the active screen.
+ */
+bool qr_screen_is_visible(void);
+
 /**
  * Returns true if the user explicitly dismissed the QR screen via touch.
  */
@@ -35,3 +49,16 @@ bool qr_screen_is_dismissed(void);
  * Reset the dismiss flag (e.g. when new MQTT QR data arrives).
  */
 void qr_screen_clear_dismissed(void);
+
+/**
+ * Describe the current QR bitmap.  Returns false unless the QR screen is
+ * active.  The bits are rewritten in place on the next qr_screen_show()
+ * with new data – consumers must copy them and watch @c gen.
+ */
+bool qr_screen_get_tile(qr_tile_t *out);
+
+/**
+ * While composed, the scan-out supplies the QR rows itself, so the QR
+ * widget is hidden and LVGL stops redrawing it into the framebuffer.
+ */
+void qr_screen_set_composed(bool composed);
@@ -8,6 +8,10 @@
  *   - Rotating Vietnamese quotes with cross-fade
  *   - Full-screen tap → static VietQR
  *
+ * Quotes, rotation period, the rain/plain background and the VietQR
+ * account come from the runtime configuration (services/config_service.h)
+ * and are rebuilt within 500 ms of a change.
+ *
  * Requires:
  *   bg_rain.c      – 480×480 LVGL C-array image (CF_TRUE_COLOR).
  *   font_vietnam_20 – custom Vietnamese font (20 px).
@@ -16,6 +20,7 @@
 
 #include "ui.h"
 #include "qr_screen.h"
+#include "config_service.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -39,7 +44,6 @@ LV_FONT_DECLARE(font_vietnam_20);
 #define NDIGITS     6           /* H1 H2 M1 M2 S1 S2                        */
 
 #define FLIP_MS         350     /* digit slide animation (ms)                */
-#define QUOTE_ROTATE_S  10      /* rotate quote every N seconds              */
 #define QUOTE_FADE_MS   500     /* cross-fade duration (ms)                  */
 
 /* ── Colours (glassmorphism palette) ─────────────────────────────────────── */
@@ -90,6 +94,7 @@ static const char *QUOTES[] = {
 /* ── Module state ────────────────────────────────────────────────────────── */
 
 static lv_obj_t   *s_scr;
+static lv_obj_t   *s_bg;               /* rain scene, hidden when "plain"    */
 static digit_t     s_dig[NDIGITS];
 static lv_obj_t   *s_colon[2];        /* HH:MM and MM:SS colons             */
 static lv_obj_t   *s_lbl_quote;
@@ -100,6 +105,12 @@ static int      s_last_min  = -1;
 static int      s_last_sec  = -1;
 static uint32_t s_tick_count;          /* 500 ms ticks since last quote      */
 static int      s_quote_idx;
+static uint32_t s_cfg_gen;
+
+static char s_vietqr[160];
+static char s_vietqr_name[48];
+
+static void apply_config(void);
 
 /* ── Animation helpers ───────────────────────────────────────────────────── */
 
@@ -151,6 +162,24 @@ static void flip_digit(digit_t *d, char new_ch)
 
 /* ── Quote cross-fade ────────────────────────────────────────────────────── */
 
+/* Configured quotes replace the built-in ones; labels copy them, since a
+   later change set may overwrite the buffer. */
+static void quote_set(int idx)
+{
+    const app_cfg_t *cfg = config_service_get();
+    if (cfg->quote_cnt) {
+        lv_label_set_text(s_lbl_quote, cfg->quotes[idx % cfg->quote_cnt]);
+    } else {
+        lv_label_set_text_static(s_lbl_quote, QUOTES[idx % NUM_QUOTES]);
+    }
+}
+
+static int quote_count(void)
+{
+    int n = config_service_get()->quote_cnt;
+    return n ? n : (int)NUM_QUOTES;
+}
+
 static void quote_fade_in(void)
 {
     lv_anim_t a;
@@ -165,8 +194,8 @@ static void quote_fade_in(void)
 static void quote_fade_out_done(lv_anim_t *a)
 {
     (void)a;
-    s_quote_idx = (s_quote_idx + 1) % NUM_QUOTES;
-    lv_label_set_text_static(s_lbl_quote, QUOTES[s_quote_idx]);
+    s_quote_idx = (s_quote_idx + 1) % quote_count();
+    quote_set(s_quote_idx);
     quote_fade_in();
 }
 
@@ -213,9 +242,12 @@ static void ui_timer_cb(lv_timer_t *tmr)
     lv_obj_set_style_text_opa(s_colon[0], opa, 0);
     lv_obj_set_style_text_opa(s_colon[1], opa, 0);
 
-    /* Rotate quote every QUOTE_ROTATE_S seconds */
+    /* Configuration changed → rebuild what depends on it */
+    if (config_service_get_gen() != s_cfg_gen) apply_config();
+
+    /* Rotate quote every quote_rotate_s seconds */
     s_tick_count++;
-    if (s_tick_count >= (QUOTE_ROTATE_S * 2)) {     /* ×2 because 500 ms */
+    if (s_tick_count >= config_service_get()->quote_rotate_s * 2U) {  /* 500 ms */
         s_tick_count = 0;
         quote_rotate();
     }
@@ -273,21 +305,11 @@ static lv_obj_t *make_colon_label(lv_obj_t *parent)
 
 /* ── Static VietQR (walk-in / tip payments) ──────────────────────────────── *
  *                                                                            *
- * EMVCo QR payload for MB Bank (BIN 970422), account 0973202625.            *
- * CRC-16/CCITT-FALSE is computed at runtime and appended to tag 63.         *
+ * EMVCo QR payload built from the configured bank BIN, account and note     *
+ * (default MB Bank 970422, account 0973202625).  CRC-16/CCITT-FALSE is      *
+ * computed at runtime and appended to tag 63.                               *
  * ────────────────────────────────────────────────────────────────────────── */
 
-static const char VIETQR_BASE[] =
-    "00020101021138540010A000000727"
-    "0124000697042201100973202625"
-    "0208QRIBFTTA"
-    "5303704"
-    "5802VN"
-    "62230819Thanh toan tai quay"
-    "6304";
-
-static char s_vietqr[128];
-
 static uint16_t crc16_ccitt(const char *data, size_t len)
 {
     uint16_t crc = 0xFFFF;
@@ -299,11 +321,59 @@ static uint16_t crc16_ccitt(const char *data, size_t len)
     return crc;
 }
 
+/* Append EMV TLV: two-digit id, two-digit length, value. */
+static int tlv(char *dst, size_t size, const char *id, const char *val)
+{
+    return snprintf(dst, size, "%s%02u%s", id, (unsigned)strlen(val), val);
+}
+
+static void build_vietqr(const app_cfg_t *cfg)
+{
+    char bene[48], acct[80], note[40];
+
+    /* 38: NAPAS GUID, beneficiary (BIN + account), service code */
+    int n = tlv(bene, sizeof(bene), "00", cfg->vietqr_bin);
+    tlv(bene + n, sizeof(bene) - n, "01", cfg->vietqr_account);
+    n  = tlv(acct, sizeof(acct), "00", "A000000727");
+    n += tlv(acct + n, sizeof(acct) - n, "01", bene);
+    tlv(acct + n, sizeof(acct) - n, "02", "QRIBFTTA");
+
+    size_t len = snprintf(s_vietqr, sizeof(s_vietqr), "000201010211");
+    len += tlv(s_vietqr + len, sizeof(s_vietqr) - len, "38", acct);
+    len += snprintf(s_vietqr + len, sizeof(s_vietqr) - len, "53037045802VN");
+    if (cfg->vietqr_note[0]) {
+        tlv(note, sizeof(note), "08", cfg->vietqr_note);
+        len += tlv(s_vietqr + len, sizeof(s_vietqr) - len, "62", note);
+    }
+    len += snprintf(s_vietqr + len, sizeof(s_vietqr) - len, "6304");
+
+    uint16_t crc = crc16_ccitt(s_vietqr, len);
+    snprintf(s_vietqr + len, sizeof(s_vietqr) - len, "%04X", crc);
+    snprintf(s_vietqr_name, sizeof(s_vietqr_name), "%s", cfg->vietqr_name);
+}
+
 static void on_idle_tap(lv_event_t *e)
 {
     (void)e;
-    qr_screen_show_static(s_vietqr, "",
-                           "NGUYEN THI NHI - MB Bank");
+    qr_screen_show_static(s_vietqr, "", s_vietqr_name);
+}
+
+static void apply_config(void)
+{
+    const app_cfg_t *cfg = config_service_get();
+    s_cfg_gen = config_service_get_gen();
+
+    build_vietqr(cfg);
+
+    if (cfg->screensaver == CFG_SCREENSAVER_PLAIN) {
+        lv_obj_add_flag(s_bg, LV_OBJ_FLAG_HIDDEN);
+    } else {
+        lv_obj_clear_flag(s_bg, LV_OBJ_FLAG_HIDDEN);
+    }
+
+    s_quote_idx  = 0;
+    s_tick_count = 0;
+    quote_set(0);
 }
 
 /* ── Public API ──────────────────────────────────────────────────────────── */
@@ -320,7 +390,7 @@ void ui_init(lv_disp_t *disp)
     lv_obj_clear_flag(s_scr, LV_OBJ_FLAG_SCROLLABLE);
 
     /* ── Rain background (programmatic — no image file needed) ────────── */
-    bg_rain_create(s_scr);
+    s_bg = bg_rain_create(s_scr);
 
     /* ── Header: "MK BEAUTY HOUSE" ───────────────────────────────────── */
     lv_obj_t *hdr = lv_label_create(s_scr);
@@ -367,8 +437,6 @@ void ui_init(lv_disp_t *disp)
     lv_obj_set_style_text_align(s_lbl_quote, LV_TEXT_ALIGN_CENTER, 0);
     lv_obj_set_width(s_lbl_quote, 420);
     lv_label_set_long_mode(s_lbl_quote, LV_LABEL_LONG_WRAP);
-    s_quote_idx = 0;
-    lv_label_set_text_static(s_lbl_quote, QUOTES[0]);
     lv_obj_align(s_lbl_quote, LV_ALIGN_BOTTOM_MID, 0, -55);
 
     /* ── Set initial time without animation ──────────────────────────── */
@@ -387,15 +455,12 @@ void ui_init(lv_disp_t *disp)
         s_dig[i].ch = buf[i];
     }
 
+    /* ── Configured parts: quote, background, static VietQR ───────────── */
+    apply_config();
+
     /* ── 500 ms timer (clock + colon blink + quote rotation) ─────────── */
-    s_tick_count = 0;
     s_timer = lv_timer_create(ui_timer_cb, 500, NULL);
 
-    /* ── Build static VietQR string (one-time) ───────────────────────── */
-    strcpy(s_vietqr, VIETQR_BASE);
-    uint16_t crc = crc16_ccitt(s_vietqr, strlen(s_vietqr));
-    snprintf(s_vietqr + strlen(s_vietqr), 5, "%04X", crc);
-
     /* ── Full-screen tap overlay (triggers static VietQR) ────────────── */
     lv_obj_t *overlay = lv_obj_create(s_scr);
     lv_obj_remove_style_all(overlay);
@@ -0,0 +1,228 @@
+#!/usr/bin/env python3
+"""
+Viewer for the display's screen mirror (firmware/services/screen_mirror.c).
+
+Sends {"on":true,"fps":N} to pos/display/mirror, shows the tiles arriving
+on pos/display/mirror/data in a window and sends {"on":false} on exit.
+Needs paho-mqtt; the window uses tkinter from the standard library.
+
+    mirror_view.py --host broker.local --fps 2
+    mirror_view.py --host broker.local --snapshot screen.ppm
+
+Message format (little-endian):
+
+    header   u8 magic 0xB2, u8 version 1, u8 flags, u8 tile size,
+             u16 frame seq, u16 width, u16 height, u16 tile count,
+             u32 ms since the session started
+    tiles    u8 tile x, u8 tile y, u16 length, RLE data
+
+    flags    0x01 tile of a full frame, 0x02 last message of a frame
+
+RLE over RGB565 pixels, row-major within the tile: a control byte
+c < 0x80 repeats the following pixel c + 1 times, c >= 0x80 is followed
+by c - 0x7F literal pixels.
+
+Library use:
+
+    m = Mirror()
+    m.apply(payload)          # per message; True once a frame is complete
+    open("s.ppm", "wb").write(m.to_ppm())
+
+The display ends the session by itself (QR shown, timeout, disconnect);
+the reason arrives on pos/display/mirror/state and is printed.
+"""
+
+import argparse
+import json
+import os
+import struct
+import sys
+import threading
+
+MAGIC = 0xB2
+VERSION = 1
+HDR = struct.Struct("<BBBBHHHHI")
+TILE_HDR = struct.Struct("<BBH")
+
+F_KEY = 0x01
+F_END = 0x02
+
+TOPIC_CMD = "pos/display/mirror"
+TOPIC_DATA = "pos/display/mirror/data"
+TOPIC_STATE = "pos/display/mirror/state"
+
+
+def decode_rle(data: bytes, n: int) -> list[int]:
+    """RGB565 pixels of one tile."""
+    px: list[int] = []
+    i = 0
+    while i < len(data):
+        c = data[i]
+        i += 1
+        if c < 0x80:
+            (v,) = struct.unpack_from("<H", data, i)
+            i += 2
+            px.extend([v] * (c + 1))
+        else:
+            cnt = c - 0x7F
+            px.extend(struct.unpack_from(f"<{cnt}H", data, i))
+            i += 2 * cnt
+    if len(px) != n:
+        raise ValueError(f"tile decodes to {len(px)} pixels, expected {n}")
+    return px
+
+
+def _rgb888(v: int) -> bytes:
+    r, g, b = v >> 11, (v >> 5) & 0x3F, v & 0x1F
+    return bytes(((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2)))
+
+
+class Mirror:
+    """The viewer's copy of the screen, RGB888."""
+
+    def __init__(self) -> None:
+        self.w = self.h = 0
+        self.rgb = bytearray()
+        self.seq = 0
+        self.ms = 0
+        self.have_key = False
+
+    def apply(self, msg: bytes) -> bool:
+        """Paint the tiles of one message; True if it ends a frame."""
+        magic, ver, flags, tile, seq, w, h, cnt, ms = HDR.unpack_from(msg)
+        if magic != MAGIC or ver != VERSION:
+            raise ValueError(f"not a mirror message ({magic:#x} v{ver})")
+        if (w, h) != (self.w, self.h):
+            self.w, self.h = w, h
+            self.rgb = bytearray(w * h * 3)
+            self.have_key = False
+        if flags & F_KEY:
+            self.have_key = True
+        self.seq, self.ms = seq, ms
+
+        off = HDR.size
+        for _ in range(cnt):
+            tx, ty, n = TILE_HDR.unpack_from(msg, off)
+            off += TILE_HDR.size
+            px = decode_rle(msg[off:off + n], tile * tile)
+            off += n
+            for y in range(tile):
+                row = b"".join(_rgb888(v) for v in px[y * tile:(y + 1) * tile])
+                p = ((ty * tile + y) * w + tx * tile) * 3
+                self.rgb[p:p + len(row)] = row
+        return bool(flags & F_END)
+
+    def to_ppm(self) -> bytes:
+        return b"P6 %d %d 255\n" % (self.w, self.h) + bytes(self.rgb)
+
+
+def _client(a):
+    import paho.mqtt.client as mqtt
+    try:
+        c = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2)
+    except AttributeError:                      # paho-mqtt 1.x
+        c = mqtt.Client()
+    if a.user:
+        c.username_pw_set(a.user, a.password)
+    if a.tls:
+        c.tls_set()
+    return c
+
+
+def _command(a, body: dict) -> bytes:
+    raw = json.dumps(body).encode()
+    if a.hmac_key:
+        sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+        from pos_bin import sign
+        raw = sign(raw, a.hmac_key.encode())
+    return raw
+
+
+def main() -> int:
+    ap = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    ap.add_argument("--host", required=True)
+    ap.add_argument("--port", type=int, default=1883)
+    ap.add_argument("--user")
+    ap.add_argument("--password")
+    ap.add_argument("--tls", action="store_true")
+    ap.add_argument("--hmac-key", help="sign commands with this key (UTF-8)")
+    ap.add_argument("--fps", type=int, default=2)
+    ap.add_argument("--snapshot", metavar="PPM",
+                    help="write the first full frame here and exit")
+    a = ap.parse_args()
+
+    m = Mirror()
+    lock = threading.Lock()
+    frame = threading.Event()
+    done = threading.Event()
+
+    def on_connect(c, *_):
+        c.subscribe([(TOPIC_DATA, 0), (TOPIC_STATE, 1)])
+        c.publish(TOPIC_CMD, _command(a, {"on": True, "fps": a.fps}), qos=1)
+
+    def on_message(c, userdata, msg):
+        if msg.topic == TOPIC_STATE:
+            st = json.loads(msg.payload)
+            print(f"mirror {'on' if st.get('on') else 'off'}: "
+                  f"{st.get('reason')}", file=sys.stderr)
+            if not st.get("on"):
+                done.set()
+            return
+        with lock:
+            try:
+                end = m.apply(msg.payload)
+            except (ValueError, struct.error) as e:
+                print(f"bad message: {e}", file=sys.stderr)
+                return
+        if end and m.have_key:
+            frame.set()
+
+    c = _client(a)
+    c.on_connect = on_connect
+    c.on_message = on_message
+    c.connect(a.host, a.port)
+    c.loop_start()
+
+    try:
+        if a.snapshot:
+            while not frame.wait(0.5):
+                if done.is_set():
+                    return 1
+            with lock, open(a.snapshot, "wb") as f:
+                f.write(m.to_ppm())
+            return 0
+        _window(m, lock, frame, done)
+        return 0
+    finally:
+        c.publish(TOPIC_CMD, _command(a, {"on": False}), qos=1).wait_for_publish(2)
+        c.loop_stop()
+        c.disconnect()
+
+
+def _window(m: Mirror, lock, frame, done) -> None:
+    import tkinter as tk
+
+    root = tk.Tk()
+    root.title("display mirror")
+    label = tk.Label(root, text="waiting for the first frame…")
+    label.pack()
+
+    def poll():
+        if frame.is_set():
+            frame.clear()
+            with lock:
+                img = tk.PhotoImage(data=m.to_ppm(), format="PPM")
+                title = f"display mirror – frame {m.seq}, {m.ms / 1000:.1f} s"
+            label.configure(image=img, text="")
+            label.image = img
+            root.title(title)
+        if done.is_set():
+            root.title("display mirror – stopped")
+        root.after(50, poll)
+
+    root.after(50, poll)
+    root.mainloop()
+
+
+if __name__ == "__main__":
+    sys.exit(main())
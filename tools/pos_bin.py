@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+"""
+Encoder for the binary POS command format (firmware/services/pos_bin.h).
+
+    byte 0   0xB1 magic
+    byte 1   format version (1)
+    then     TLV records: type (u8), length (u16 LE), value
+
+Library use:
+
+    from pos_bin import encode_show, encode_result
+    client.publish("pos/qr/show/bin", encode_show(qr, amount="150.000đ"),
+                   qos=1, properties=props)
+
+encode_show() stamps the command with the current unix time; the device
+drops a show older than APP_QR_SHOW_MAX_AGE_S (once its own clock is
+synced).  With MQTT 5, also set a message-expiry interval on the publish
+so the broker discards a queued show rather than delivering it after an
+outage, e.g. with paho-mqtt:
+
+    props = Properties(PacketTypes.PUBLISH)
+    props.MessageExpiryInterval = 120
+
+sign() adds the HMAC envelope (firmware/services/cmd_auth.h) to any body,
+JSON or binary, when the display has APP_CMD_HMAC_KEY set:
+
+    client.publish("pos/qr/show/bin", sign(encode_show(qr), key))
+
+Command line (raw bytes on stdout, e.g. for mosquitto_pub -s):
+
+    pos_bin.py show "<qr string>" --amount 150.000 --desc "Order #1" \\
+        | mosquitto_pub -t pos/qr/show/bin -s
+    pos_bin.py result success --message "Paid"
+"""
+
+import argparse
+import hashlib
+import hmac
+import struct
+import sys
+import time
+
+MAGIC = 0xB1
+VERSION = 1
+
+T_QR_DATA = 0x01
+T_AMOUNT = 0x02
+T_DESC = 0x03
+T_TS = 0x04
+T_STATUS = 0x10
+T_MESSAGE = 0x11
+
+STATUS_FAILED = 0
+STATUS_SUCCESS = 1
+
+# Field limits of the firmware's qr_payload_t (bytes, without NUL).
+MAX_QR_DATA = 2953
+MAX_AMOUNT = 31
+MAX_DESC = 63
+
+
+def _tlv(t: int, value: bytes) -> bytes:
+    if len(value) > 0xFFFF:
+        raise ValueError("TLV value too long")
+    return struct.pack("<BH", t, len(value)) + value
+
+
+def _str(t: int, s: str, limit: int, name: str) -> bytes:
+    b = s.encode("utf-8")
+    if len(b) > limit:
+        # The device rejects over-long fields rather than truncating them.
+        raise ValueError(f"{name} is {len(b)} bytes, max {limit}")
+    return _tlv(t, b) if b else b""
+
+
+def encode_show(qr_data: str, amount: str = "", desc: str = "",
+                ts: int | None = None) -> bytes:
+    """Body for pos/qr/show/bin.  ts defaults to now; 0 omits it."""
+    if not qr_data:
+        raise ValueError("qr_data is required")
+    if ts is None:
+        ts = int(time.time())
+    return (bytes([MAGIC, VERSION])
+            + _str(T_QR_DATA, qr_data, MAX_QR_DATA, "qr_data")
+            + _str(T_AMOUNT, amount, MAX_AMOUNT, "amount")
+            + _str(T_DESC, desc, MAX_DESC, "desc")
+            + (_tlv(T_TS, struct.pack("<I", ts)) if ts else b""))
+
+
+def encode_hide() -> bytes:
+    """Body for pos/qr/hide/bin (the device ignores it)."""
+    return bytes([MAGIC, VERSION])
+
+
+def encode_result(success: bool, message: str = "") -> bytes:
+    """Body for pos/qr/result/bin."""
+    status = STATUS_SUCCESS if success else STATUS_FAILED
+    out = bytes([MAGIC, VERSION]) + _tlv(T_STATUS, bytes([status]))
+    if message:
+        out += _tlv(T_MESSAGE, message.encode("utf-8"))
+    return out
+
+
+def sign(body: bytes, key: bytes, seq: int | None = None) -> bytes:
+    """Prefix "#<seq>.<hex HMAC-SHA256(key, '<seq>.' + body)>\\n".
+
+    seq must grow per display; unix milliseconds by default.
+    """
+    if seq is None:
+        seq = int(time.time() * 1000)
+    mac = hmac.new(key, f"{seq}.".encode() + body, hashlib.sha256)
+    return f"#{seq}.{mac.hexdigest()}\n".encode() + body
+
+
+def main() -> int:
+    ap = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    ap.add_argument("--hmac-key", help="sign with this key (UTF-8)")
+    ap.add_argument("--seq", type=int, help="envelope seq (default: unix ms)")
+    sub = ap.add_subparsers(dest="cmd", required=True)
+
+    show = sub.add_parser("show")
+    show.add_argument("qr_data")
+    show.add_argument("--amount", default="")
+    show.add_argument("--desc", default="")
+    show.add_argument("--ts", type=int, default=None,
+                      help="unix seconds (default: now, 0: omit)")
+
+    sub.add_parser("hide")
+
+    res = sub.add_parser("result")
+    res.add_argument("status", choices=["success", "failed"])
+    res.add_argument("--message", default="")
+
+    a = ap.parse_args()
+    if a.cmd == "show":
+        body = encode_show(a.qr_data, a.amount, a.desc, a.ts)
+    elif a.cmd == "hide":
+        body = encode_hide()
+    else:
+        body = encode_result(a.status == "success", a.message)
+
+    if a.hmac_key:
+        body = sign(body, a.hmac_key.encode(), a.seq)
+    sys.stdout.buffer.write(body)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
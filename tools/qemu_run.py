@@ -0,0 +1,267 @@
+#!/usr/bin/env python3
+"""
+Boot the real firmware under Espressif's QEMU and exercise it over MQTT.
+
+Build the QEMU variant (sdkconfig.qemu: panel, touch and WiFi stubbed,
+network through QEMU's open-eth NIC), start a broker on the host – the
+emulated display reaches it as 10.0.2.2:1883 – and run:
+
+    cd firmware
+    idf.py -B build_qemu -D SDKCONFIG=build_qemu/sdkconfig \\
+           -D SDKCONFIG_DEFAULTS="sdkconfig.defaults;sdkconfig.qemu" build
+    mosquitto -p 1883 &
+    ../tools/qemu_run.py --build build_qemu
+
+Checks, in order; the run fails at the first one that does not hold:
+
+    boot      "System running" and the boot report on the console, no
+              panic / abort / watchdog reset
+    online    "online" on pos/display/status from this boot
+    commands  --shows binary show + hide pairs (pos_bin.py), then
+              --configs config change sets timed to their ack; signed
+              with --hmac-key when the build has APP_CMD_HMAC_KEY
+    soak      --soak seconds more without a crash
+
+With --no-net QEMU gets no NIC at all: only "boot" and "soak" run, which
+covers the offline boot order (UI up, MQTT retrying) with no network.
+
+Prints one JSON summary on stdout, e.g.
+
+    {"boot_ms": {"config": 35, ...}, "app_main_ms": 412,
+     "heap": {"internal_k": 143, "internal_min_k": 97, "psram_k": 6120},
+     "online_s": 6.1, "config_rtt_ms": {"min": 21, "avg": 30, "max": 52},
+     "rx_us_max": 840, "ok": true}
+
+Timings are emulator time, good for comparing builds, not for absolute
+numbers on the board.  Needs esptool (in the ESP-IDF environment),
+qemu-system-xtensa from `idf_tools.py install qemu-xtensa`, and
+paho-mqtt unless --no-net.
+"""
+
+import argparse
+import json
+import os
+import queue
+import re
+import subprocess
+import sys
+import threading
+import time
+
+TOPIC_STATUS = "pos/display/status"
+TOPIC_HEARTBEAT = "pos/display/heartbeat"
+TOPIC_CONFIG = "pos/display/config"
+TOPIC_CONFIG_ACK = "pos/display/config/ack"
+TOPIC_SHOW_BIN = "pos/qr/show/bin"
+TOPIC_HIDE_BIN = "pos/qr/hide/bin"
+
+RE_BOOT = re.compile(r"Boot ms: (.*) – app_main (\d+), entered at (\d+)")
+RE_HEAP = re.compile(r"Boot heap: internal (\d+) K free \(min (\d+) K\), "
+                     r"PSRAM (\d+) K free")
+RE_CRASH = re.compile(r"Guru Meditation|abort\(\) was called|"
+                      r"Task watchdog got triggered|rst:0x[0-9a-f]+ \((?!POWERON)")
+
+
+class Fail(Exception):
+    pass
+
+
+def flash_image(build: str) -> str:
+    """Merge bootloader, partition table and app into one 16 MB image."""
+    out = os.path.join(build, "qemu_flash.bin")
+    subprocess.run(["esptool.py", "--chip", "esp32s3", "merge_bin",
+                    "--fill-flash-size", "16MB", "-o", "qemu_flash.bin",
+                    "@flash_args"], cwd=build, check=True,
+                   stdout=subprocess.DEVNULL)
+    return out
+
+
+class Console:
+    """QEMU with the UART on stdout; lines are echoed to stderr."""
+
+    def __init__(self, a, image: str) -> None:
+        cmd = [a.qemu, "-nographic", "-machine", "esp32s3",
+               "-drive", f"file={image},if=mtd,format=raw",
+               "-m", a.psram,
+               "-nic", "none" if a.no_net else "user,model=open_eth"]
+        cmd += a.qemu_arg
+        self.p = subprocess.Popen(cmd, stdout=subprocess.PIPE,
+                                  stderr=subprocess.STDOUT,
+                                  stdin=subprocess.DEVNULL)
+        self.lines: queue.Queue[str] = queue.Queue()
+        self.crash = ""
+        self.quiet = a.quiet
+        threading.Thread(target=self._read, daemon=True).start()
+
+    def _read(self) -> None:
+        for raw in self.p.stdout:
+            line = raw.decode("utf-8", "replace").rstrip()
+            if not self.quiet:
+                print(f"qemu| {line}", file=sys.stderr)
+            if RE_CRASH.search(line) and not self.crash:
+                self.crash = line
+            self.lines.put(line)
+
+    def expect(self, pattern: re.Pattern, timeout: float) -> re.Match:
+        end = time.monotonic() + timeout
+        while True:
+            if self.crash:
+                raise Fail(f"crash: {self.crash}")
+            left = end - time.monotonic()
+            if left <= 0:
+                raise Fail(f"timeout waiting for /{pattern.pattern}/")
+            try:
+                m = pattern.search(self.lines.get(timeout=min(left, 0.5)))
+            except queue.Empty:
+                continue
+            if m:
+                return m
+
+    def stop(self) -> None:
+        self.p.kill()
+        self.p.wait()
+
+
+def check_boot(con: Console, a, out: dict) -> None:
+    m = con.expect(RE_BOOT, a.timeout)
+    out["boot_ms"] = {k: int(v) for k, v in
+                      (s.rsplit(" ", 1) for s in m.group(1).split(", "))}
+    out["app_main_ms"] = int(m.group(2))
+    out["app_main_at_ms"] = int(m.group(3))
+    h = con.expect(RE_HEAP, 5)
+    out["heap"] = {"internal_k": int(h.group(1)),
+                   "internal_min_k": int(h.group(2)),
+                   "psram_k": int(h.group(3))}
+
+
+def check_mqtt(a, t_start: float, out: dict) -> None:
+    import paho.mqtt.client as mqtt
+
+    sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+    from pos_bin import encode_show, encode_hide, sign
+
+    last_seq = 0
+
+    def cmd(body: bytes) -> bytes:
+        """Sign body if a key was given; seq strictly increasing."""
+        nonlocal last_seq
+        if not a.hmac_key:
+            return body
+        last_seq = max(int(time.time() * 1000), last_seq + 1)
+        return sign(body, a.hmac_key.encode(), last_seq)
+
+    msgs: queue.Queue = queue.Queue()
+    try:
+        c = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2)
+    except AttributeError:                      # paho-mqtt 1.x
+        c = mqtt.Client()
+    c.on_connect = lambda c, *_: c.subscribe(
+        [(TOPIC_STATUS, 1), (TOPIC_HEARTBEAT, 0), (TOPIC_CONFIG_ACK, 1)])
+    c.on_message = lambda c, u, m: msgs.put((m.topic, m.payload,
+                                             m.retain, time.monotonic()))
+    c.connect(a.broker, a.port)
+    c.loop_start()
+
+    def wait(topic: str, pred, timeout: float):
+        """Next live (not retained) message on topic matching pred."""
+        end = time.monotonic() + timeout
+        while time.monotonic() < end:
+            try:
+                t, p, retained, at = msgs.get(timeout=end - time.monotonic())
+            except queue.Empty:
+                break
+            if t == topic and not retained and pred(p):
+                return p, at
+        raise Fail(f"timeout waiting on {topic}")
+
+    try:
+        # A retained "online" may be left from an earlier run: wait for
+        # the one this boot publishes
+        _, at = wait(TOPIC_STATUS, lambda p: p == b"online", a.timeout)
+        out["online_s"] = round(at - t_start, 1)
+
+        for i in range(a.shows):
+            c.publish(TOPIC_SHOW_BIN, cmd(encode_show(f"QEMU-TEST-{i}",
+                                                      amount=f"{i}.000")),
+                      qos=1)
+            time.sleep(0.1)
+            c.publish(TOPIC_HIDE_BIN, cmd(encode_hide()), qos=1)
+            time.sleep(0.1)
+
+        # Let flash_sched's quiet window after the last hide pass, so the
+        # round trips time the handling, not the deliberate write delay
+        time.sleep(2)
+        rtt = []
+        base = int(time.time()) % 1_000_000_000
+        for i in range(a.configs):
+            ver = base + i
+            t0 = time.monotonic()
+            c.publish(TOPIC_CONFIG,
+                      cmd(json.dumps({"version": ver}).encode()), qos=1)
+            p, at = wait(TOPIC_CONFIG_ACK,
+                         lambda p: f'"version":{ver}'.encode() in p, 15)
+            ack = json.loads(p)
+            if ack.get("status") != "applied":
+                raise Fail(f"config {ver}: {ack}")
+            rtt.append((at - t0) * 1000)
+        if rtt:
+            out["config_rtt_ms"] = {"min": round(min(rtt)),
+                                    "avg": round(sum(rtt) / len(rtt)),
+                                    "max": round(max(rtt))}
+
+        p, _ = wait(TOPIC_HEARTBEAT, lambda p: b'"rx_us"' in p, 15)
+        hb = json.loads(p)
+        out["rx_us_max"] = hb["rx_us"]
+        out["flash_us_max"] = hb["flash_us"]
+    finally:
+        c.loop_stop()
+        c.disconnect()
+
+
+def main() -> int:
+    ap = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    ap.add_argument("--build", default="build_qemu",
+                    help="ESP-IDF build directory of the QEMU variant")
+    ap.add_argument("--qemu", default="qemu-system-xtensa")
+    ap.add_argument("--qemu-arg", action="append", default=[],
+                    help="extra QEMU argument (repeatable)")
+    ap.add_argument("--psram", default="8M", help="emulated PSRAM size")
+    ap.add_argument("--no-net", action="store_true",
+                    help="no NIC: offline boot only")
+    ap.add_argument("--broker", default="localhost",
+                    help="the broker the emulator reaches as 10.0.2.2")
+    ap.add_argument("--port", type=int, default=1883)
+    ap.add_argument("--hmac-key", help="sign commands with this key (UTF-8)")
+    ap.add_argument("--timeout", type=float, default=90,
+                    help="seconds for boot and for the first connect")
+    ap.add_argument("--shows", type=int, default=20)
+    ap.add_argument("--configs", type=int, default=5)
+    ap.add_argument("--soak", type=float, default=10)
+    ap.add_argument("--quiet", action="store_true",
+                    help="do not echo the console")
+    a = ap.parse_args()
+
+    out: dict = {"ok": False}
+    con = Console(a, flash_image(a.build))
+    t_start = time.monotonic()
+    try:
+        check_boot(con, a, out)
+        if not a.no_net:
+            check_mqtt(a, t_start, out)
+        end = time.monotonic() + a.soak
+        while time.monotonic() < end:
+            if con.crash:
+                raise Fail(f"crash: {con.crash}")
+            time.sleep(0.5)
+        out["ok"] = True
+    except Fail as e:
+        out["error"] = str(e)
+    finally:
+        con.stop()
+
+    print(json.dumps(out))
+    return 0 if out["ok"] else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())